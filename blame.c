@@ -11,6 +11,9 @@
 #include "commit-slab.h"
 #include "bloom.h"
 #include "commit-graph.h"
+#include "lockfile.h"
+#include "quote.h"
+#include "userdiff.h"
 
 define_commit_slab(blame_suspects, struct blame_origin *);
 static struct blame_suspects blame_suspects;
@@ -1259,12 +1262,50 @@ struct blame_bloom_data {
 	struct bloom_key **keys;
 	int nr;
 	int alloc;
+
+	/*
+	 * Whether commits the filters rule out may be skipped without
+	 * ever being queued; see skip_unchanged_commits().
+	 */
+	int skip_unchanged;
+};
+
+/*
+ * The blame cache remembers the final result of blaming a path at a
+ * commit, keyed by the commit, the path and the options that affect
+ * attribution. A later blame of the same path at a descendant stops
+ * digging when it reaches the cached commit and takes the attribution
+ * of the lines that survived to it from the cache instead.
+ *
+ * Using a cached result touches its file, so that the least recently
+ * used results can be evicted once there are too many of them.
+ */
+#define BLAME_CACHE_MAX_DEPTH 1000
+
+struct blame_cache_entry {
+	int lno;
+	int num_lines;
+	int s_lno;
+	int boundary;
+	struct blame_origin *origin;
+};
+
+struct blame_cache {
+	/* the commit our entries are for, if any */
+	struct commit *commit;
+	struct object_id blob_oid;
+	/* the blob being blamed, for writing our own result */
+	struct object_id final_blob_oid;
+	struct blame_cache_entry *entries;
+	size_t nr, alloc;
+	char *options;
 };
 
 static int bloom_count_queries = 0;
 static int bloom_count_no = 0;
+static int bloom_count_skipped = 0;
 static int maybe_changed_path(struct repository *r,
-			      struct blame_origin *origin,
+			      struct commit *commit,
 			      struct blame_bloom_data *bd)
 {
 	int i;
@@ -1273,10 +1314,10 @@ static int maybe_changed_path(struct repository *r,
 	if (!bd)
 		return 1;
 
-	if (commit_graph_generation(origin->commit) == GENERATION_NUMBER_INFINITY)
+	if (commit_graph_generation(commit) == GENERATION_NUMBER_INFINITY)
 		return 1;
 
-	filter = get_bloom_filter(r, origin->commit);
+	filter = get_bloom_filter(r, commit);
 
 	if (!filter)
 		return 1;
@@ -1355,7 +1396,7 @@ static struct blame_origin *find_origin(struct repository *r,
 		if (origin->commit->parents &&
 		    oideq(&parent->object.oid,
 			  &origin->commit->parents->item->object.oid))
-			compute_diff = maybe_changed_path(r, origin, bd);
+			compute_diff = maybe_changed_path(r, origin->commit, bd);
 
 		if (compute_diff)
 			diff_tree_oid(get_commit_tree_oid(parent),
@@ -2410,6 +2451,40 @@ typedef struct blame_origin *(*blame_find_alg)(struct repository *,
 					       struct blame_origin *,
 					       struct blame_bloom_data *);
 
+/*
+ * Follow the first-parent chain from "commit" for as long as the
+ * changed-path Bloom filters say that none of the paths we track were
+ * touched, and return the first commit that may have touched one of
+ * them. Blame for an unchanged path passes whole to the first parent,
+ * so there is no need to queue, diff or even create an origin for
+ * each of the commits in between.
+ */
+static struct commit *skip_unchanged_commits(struct blame_scoreboard *sb,
+					     struct commit *commit)
+{
+	struct rev_info *revs = sb->revs;
+
+	while (first_scapegoat(revs, commit, 0)) {
+		struct commit *parent = commit->parents->item;
+
+		if (maybe_changed_path(sb->repo, commit, sb->bloom_data))
+			break;
+		if (repo_parse_commit(sb->repo, parent))
+			break;
+
+		bloom_count_skipped++;
+		commit = parent;
+
+		/* let assign_blame() deal with the boundary and the cache */
+		if (sb->cache && commit == sb->cache->commit)
+			break;
+		if (commit->object.flags & UNINTERESTING ||
+		    (revs->max_age != -1 && commit->date < revs->max_age))
+			break;
+	}
+	return commit;
+}
+
 static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin, int opt)
 {
 	struct rev_info *revs = sb->revs;
@@ -2421,6 +2496,20 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 	struct blame_entry *toosmall = NULL;
 	struct blame_entry *blames, **blametail = &blames;
 
+	if (sb->bloom_data && sb->bloom_data->skip_unchanged) {
+		struct commit *target = skip_unchanged_commits(sb, commit);
+
+		if (target != commit) {
+			porigin = get_origin(target, origin->path);
+			oidcpy(&porigin->blob_oid, &origin->blob_oid);
+			porigin->mode = origin->mode;
+			pass_whole_blame(sb, origin, porigin);
+			blame_origin_decref(porigin);
+			drop_origin_blob(origin);
+			return;
+		}
+	}
+
 	num_sg = num_scapegoats(revs, commit, sb->reverse);
 	if (!num_sg)
 		goto finish;
@@ -2578,6 +2667,452 @@ static void pass_blame(struct blame_scoreboard *sb, struct blame_origin *origin,
 		free(sg_origin);
 }
 
+static int blame_cache_usable(struct blame_scoreboard *sb, int opt)
+{
+	struct userdiff_driver *driver;
+	int i;
+
+	if (opt || sb->reverse || sb->contents_from ||
+	    !sb->final || is_null_oid(&sb->final->object.oid))
+		return 0;
+	/*
+	 * Shallow boundaries, grafts and replace refs change history
+	 * without changing the commits the cache is keyed by.
+	 */
+	if (!commit_graph_compatible(sb->repo))
+		return 0;
+	if (oidset_size(&sb->ignore_list) || sb->revs->max_age != -1)
+		return 0;
+	for (i = 0; i < sb->revs->cmdline.nr; i++)
+		if (sb->revs->cmdline.rev[i].flags & UNINTERESTING)
+			return 0;
+
+	if (sb->revs->diffopt.flags.allow_textconv) {
+		driver = userdiff_find_by_path(sb->repo->index, sb->path);
+		if (driver && driver->textconv)
+			return 0;
+	}
+	return 1;
+}
+
+static char *blame_cache_path(struct blame_scoreboard *sb,
+			      const struct object_id *commit_oid)
+{
+	git_hash_ctx ctx;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	const char *hex;
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, commit_oid->hash, the_hash_algo->rawsz);
+	the_hash_algo->update_fn(&ctx, sb->cache->options,
+				 strlen(sb->cache->options) + 1);
+	the_hash_algo->update_fn(&ctx, sb->path, strlen(sb->path));
+	the_hash_algo->final_fn(hash, &ctx);
+
+	hex = hash_to_hex(hash);
+	return repo_git_path(sb->repo, "blame-cache/%.2s/%s", hex, hex + 2);
+}
+
+static int read_quoted_path(const char *p, const char **end, struct strbuf *out)
+{
+	strbuf_reset(out);
+	if (*p == '"')
+		return unquote_c_style(out, p, end);
+	*end = strchrnul(p, '\t');
+	strbuf_add(out, p, *end - p);
+	return 0;
+}
+
+static int parse_blame_cache_entry(struct blame_scoreboard *sb,
+				   const char *line,
+				   struct blame_cache_entry *e)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct object_id oid, blob_oid, prev_oid;
+	struct commit *commit;
+	const char *p = line;
+	char *end;
+	int has_prev = 0, ret = -1;
+
+	e->lno = strtol(p, &end, 10);
+	if (*end != ' ')
+		goto out;
+	e->num_lines = strtol(end + 1, &end, 10);
+	if (*end != ' ')
+		goto out;
+	e->s_lno = strtol(end + 1, &end, 10);
+	if (*end != ' ')
+		goto out;
+	e->boundary = strtol(end + 1, &end, 10);
+	if (*end != ' ' || e->lno < 0 || e->num_lines <= 0 || e->s_lno < 0)
+		goto out;
+	p = end + 1;
+	if (parse_oid_hex(p, &oid, &p) || *p++ != ' ' ||
+	    parse_oid_hex(p, &blob_oid, &p) || *p++ != ' ')
+		goto out;
+	if (*p == '-')
+		p++;
+	else if (parse_oid_hex(p, &prev_oid, &p))
+		goto out;
+	else
+		has_prev = 1;
+	if (*p++ != '\t' || read_quoted_path(p, &p, &path))
+		goto out;
+
+	commit = lookup_commit(sb->repo, &oid);
+	if (!commit)
+		goto out;
+	e->origin = get_origin(commit, path.buf);
+	oidcpy(&e->origin->blob_oid, &blob_oid);
+
+	if (has_prev) {
+		struct commit *prev = lookup_commit(sb->repo, &prev_oid);
+
+		if (*p++ != '\t' || read_quoted_path(p, &p, &path) || !prev)
+			goto out;
+		if (!e->origin->previous)
+			e->origin->previous = get_origin(prev, path.buf);
+	}
+	ret = *p ? -1 : 0;
+
+out:
+	strbuf_release(&path);
+	return ret;
+}
+
+static void clear_blame_cache_entries(struct blame_cache *cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->nr; i++)
+		blame_origin_decref(cache->entries[i].origin);
+	FREE_AND_NULL(cache->entries);
+	cache->nr = cache->alloc = 0;
+	cache->commit = NULL;
+}
+
+static int read_blame_cache(struct blame_scoreboard *sb, struct commit *commit)
+{
+	struct blame_cache *cache = sb->cache;
+	struct strbuf line = STRBUF_INIT;
+	struct strbuf header = STRBUF_INIT;
+	char *path = blame_cache_path(sb, &commit->object.oid);
+	const char *p;
+	FILE *fp;
+	int next_lno = 0, ret = -1;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		free(path);
+		return -1;
+	}
+
+	strbuf_addf(&header, "blame-cache v1 %s %s\t",
+		    oid_to_hex(&commit->object.oid), cache->options);
+	quote_c_style(sb->path, &header, NULL, 0);
+	if (strbuf_getline(&line, fp) ||
+	    !skip_prefix(line.buf, header.buf, &p) ||
+	    *p++ != ' ' || parse_oid_hex(p, &cache->blob_oid, &p) || *p)
+		goto out;
+
+	while (!strbuf_getline(&line, fp)) {
+		struct blame_cache_entry *e;
+
+		ALLOC_GROW(cache->entries, cache->nr + 1, cache->alloc);
+		e = &cache->entries[cache->nr];
+		e->origin = NULL;
+		if (parse_blame_cache_entry(sb, line.buf, e)) {
+			blame_origin_decref(e->origin);
+			goto out;
+		}
+		cache->nr++;
+		/* the entries must tile the whole blob, in order */
+		if (e->lno != next_lno)
+			goto out;
+		next_lno += e->num_lines;
+	}
+	cache->commit = commit;
+	ret = 0;
+	/* mark it as recently used */
+	utime(path, NULL);
+
+out:
+	if (ret)
+		clear_blame_cache_entries(cache);
+	free(path);
+	fclose(fp);
+	strbuf_release(&line);
+	strbuf_release(&header);
+	return ret;
+}
+
+void blame_cache_prepare(struct blame_scoreboard *sb, int opt)
+{
+	struct commit *commit = sb->final;
+	struct blame_origin *o;
+	int depth;
+
+	if (!blame_cache_usable(sb, opt))
+		return;
+	for (o = get_blame_suspects(sb->final); o; o = o->next)
+		if (!strcmp(o->path, sb->path))
+			break;
+	if (!o)
+		return;
+
+	CALLOC_ARRAY(sb->cache, 1);
+	oidcpy(&sb->cache->final_blob_oid, &o->blob_oid);
+	sb->cache->options = xstrfmt("v1:%x:%d:%d:%d", sb->xdl_opts,
+				     sb->show_root, sb->no_whole_file_rename,
+				     sb->revs->first_parent_only);
+
+	/*
+	 * Look for the nearest first-parent ancestor whose blame of the
+	 * same path we have cached.
+	 */
+	for (depth = 0; commit && depth < BLAME_CACHE_MAX_DEPTH; depth++) {
+		if (!read_blame_cache(sb, commit))
+			break;
+		if (repo_parse_commit(sb->repo, commit) || !commit->parents)
+			break;
+		commit = commit->parents->item;
+	}
+
+	trace2_data_intmax("blame", sb->repo, "cache/depth",
+			   sb->cache->commit ? depth : -1);
+}
+
+static int blame_cache_covers(struct blame_scoreboard *sb,
+			      struct blame_origin *suspect)
+{
+	return sb->cache && suspect->commit == sb->cache->commit &&
+		!strcmp(suspect->path, sb->path) &&
+		oideq(&suspect->blob_oid, &sb->cache->blob_oid);
+}
+
+static struct blame_cache_entry *blame_cache_lookup(struct blame_cache *cache,
+						   int lno)
+{
+	size_t lo = 0, hi = cache->nr;
+
+	while (lo < hi) {
+		size_t mi = lo + (hi - lo) / 2;
+		struct blame_cache_entry *e = &cache->entries[mi];
+
+		if (lno < e->lno)
+			hi = mi;
+		else if (lno >= e->lno + e->num_lines)
+			lo = mi + 1;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+/*
+ * The suspect is the cached path at the cached commit; settle its
+ * entries with the final attribution we recorded for those lines.
+ */
+static void blame_from_cache(struct blame_scoreboard *sb,
+			     struct blame_origin *suspect)
+{
+	struct blame_entry *e, *next;
+
+	for (e = suspect->suspects; e; e = next) {
+		int start = e->s_lno, end = e->s_lno + e->num_lines;
+
+		next = e->next;
+		while (start < end) {
+			struct blame_cache_entry *c;
+			struct blame_entry *n;
+			int len;
+
+			c = blame_cache_lookup(sb->cache, start);
+			if (!c)
+				die(_("blame cache for '%s' at %s is corrupt"),
+				    sb->path, oid_to_hex(&suspect->commit->object.oid));
+			len = c->lno + c->num_lines - start;
+			if (len > end - start)
+				len = end - start;
+
+			CALLOC_ARRAY(n, 1);
+			n->lno = e->lno + (start - e->s_lno);
+			n->num_lines = len;
+			n->s_lno = c->s_lno + (start - c->lno);
+			n->suspect = blame_origin_incref(c->origin);
+			c->origin->guilty = 1;
+			if (c->boundary)
+				c->origin->commit->object.flags |= UNINTERESTING;
+			if (sb->found_guilty_entry)
+				sb->found_guilty_entry(n, sb->found_guilty_entry_data);
+			n->next = sb->ent;
+			sb->ent = n;
+
+			start += len;
+		}
+		blame_origin_decref(e->suspect);
+		free(e);
+	}
+	suspect->suspects = NULL;
+}
+
+struct blame_cache_file {
+	char *name;
+	timestamp_t mtime;
+};
+
+static int blame_cache_file_cmp(const void *a_, const void *b_)
+{
+	const struct blame_cache_file *a = a_, *b = b_;
+
+	if (a->mtime != b->mtime)
+		return a->mtime < b->mtime ? 1 : -1;
+	return strcmp(a->name, b->name);
+}
+
+/*
+ * Remove the cached results in the fan-out directory `dir` that have
+ * not been used since `expire`, and then the least recently used ones
+ * until at most `max` are left. Return the number of remaining files.
+ */
+static size_t trim_blame_cache_dir(const char *dir, size_t max,
+				   timestamp_t expire)
+{
+	struct blame_cache_file *files = NULL;
+	size_t nr = 0, alloc = 0, kept = 0, i;
+	struct strbuf path = STRBUF_INIT;
+	struct dirent *de;
+	size_t baselen;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return 0;
+	strbuf_addf(&path, "%s/", dir);
+	baselen = path.len;
+	while ((de = readdir_skip_dot_and_dotdot(d))) {
+		struct stat st;
+
+		strbuf_setlen(&path, baselen);
+		strbuf_addstr(&path, de->d_name);
+		if (lstat(path.buf, &st) || !S_ISREG(st.st_mode))
+			continue;
+		if (st.st_mtime < expire) {
+			unlink_or_warn(path.buf);
+			continue;
+		}
+		ALLOC_GROW(files, nr + 1, alloc);
+		files[nr].name = xstrdup(de->d_name);
+		files[nr].mtime = st.st_mtime;
+		nr++;
+	}
+	closedir(d);
+
+	QSORT(files, nr, blame_cache_file_cmp);
+	for (i = 0; i < nr; i++) {
+		/* lock files are in-flight writes, never evict those */
+		if (kept < max || ends_with(files[i].name, LOCK_SUFFIX)) {
+			kept++;
+		} else {
+			strbuf_setlen(&path, baselen);
+			strbuf_addstr(&path, files[i].name);
+			unlink_or_warn(path.buf);
+		}
+		free(files[i].name);
+	}
+	free(files);
+	strbuf_release(&path);
+	return kept;
+}
+
+static size_t blame_cache_dir_limit(unsigned long limit)
+{
+	/* spread the limit over the 256 fan-out directories */
+	return limit ? DIV_ROUND_UP(limit, 256) : SIZE_MAX;
+}
+
+void blame_cache_gc(struct repository *r, unsigned long limit,
+		    timestamp_t expire)
+{
+	char *base = repo_git_path(r, "blame-cache");
+	struct strbuf dir = STRBUF_INIT;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		strbuf_reset(&dir);
+		strbuf_addf(&dir, "%s/%02x", base, i);
+		if (!trim_blame_cache_dir(dir.buf, blame_cache_dir_limit(limit),
+					  expire))
+			rmdir(dir.buf);
+	}
+	rmdir(base);
+
+	strbuf_release(&dir);
+	free(base);
+}
+
+void blame_cache_write(struct blame_scoreboard *sb, unsigned long limit)
+{
+	struct lock_file lock = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct blame_entry *e;
+	char *path;
+	int next_lno = 0;
+
+	if (!sb->cache || sb->cache->commit == sb->final)
+		return;
+
+	/* only complete results are worth keeping, e.g. not for -L */
+	for (e = sb->ent; e; e = e->next) {
+		if (e->lno != next_lno || is_null_oid(&e->suspect->commit->object.oid))
+			return;
+		next_lno += e->num_lines;
+	}
+	if (next_lno != sb->num_lines)
+		return;
+
+	path = blame_cache_path(sb, &sb->final->object.oid);
+	if (safe_create_leading_directories(path) ||
+	    hold_lock_file_for_update(&lock, path, 0) < 0)
+		goto out;
+
+	strbuf_addf(&buf, "blame-cache v1 %s %s\t",
+		    oid_to_hex(&sb->final->object.oid), sb->cache->options);
+	quote_c_style(sb->path, &buf, NULL, 0);
+	strbuf_addf(&buf, " %s\n", oid_to_hex(&sb->cache->final_blob_oid));
+
+	for (e = sb->ent; e; e = e->next) {
+		struct blame_origin *o = e->suspect;
+
+		strbuf_addf(&buf, "%d %d %d %d %s ",
+			    e->lno, e->num_lines, e->s_lno,
+			    !!(o->commit->object.flags & UNINTERESTING),
+			    oid_to_hex(&o->commit->object.oid));
+		strbuf_addf(&buf, "%s %s\t", oid_to_hex(&o->blob_oid),
+			    o->previous ? oid_to_hex(&o->previous->commit->object.oid) : "-");
+		quote_c_style(o->path, &buf, NULL, 0);
+		if (o->previous) {
+			strbuf_addch(&buf, '\t');
+			quote_c_style(o->previous->path, &buf, NULL, 0);
+		}
+		strbuf_addch(&buf, '\n');
+	}
+
+	if (write_in_full(get_lock_file_fd(&lock), buf.buf, buf.len) < 0) {
+		rollback_lock_file(&lock);
+	} else if (!commit_lock_file(&lock)) {
+		/* keep the directory we have written to within the limit */
+		char *slash = strrchr(path, '/');
+
+		*slash = '\0';
+		trim_blame_cache_dir(path, blame_cache_dir_limit(limit), 0);
+	}
+
+out:
+	free(path);
+	strbuf_release(&buf);
+}
+
 /*
  * The main loop -- while we have blobs with lines whose true origin
  * is still unknown, pick one blob, and allow its lines to pass blames
@@ -2608,7 +3143,9 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 		 */
 		blame_origin_incref(suspect);
 		parse_commit(commit);
-		if (sb->reverse ||
+		if (blame_cache_covers(sb, suspect))
+			blame_from_cache(sb, suspect);
+		else if (sb->reverse ||
 		    (!(commit->object.flags & UNINTERESTING) &&
 		     !(revs->max_age != -1 && commit->date < revs->max_age)))
 			pass_blame(sb, suspect, opt);
@@ -2890,6 +3427,7 @@ void setup_blame_bloom_data(struct blame_scoreboard *sb)
 {
 	struct blame_bloom_data *bd;
 	struct bloom_filter_settings *bs;
+	int i;
 
 	if (!sb->repo->objects->commit_graph)
 		return;
@@ -2906,6 +3444,16 @@ void setup_blame_bloom_data(struct blame_scoreboard *sb)
 	bd->nr = 0;
 	ALLOC_ARRAY(bd->keys, bd->alloc);
 
+	/*
+	 * Skipping ahead is only safe when walking towards the parents
+	 * without a bottom commit: the ancestors of a bottom are marked
+	 * uninteresting lazily, as the walk reaches them in date order.
+	 */
+	bd->skip_unchanged = !sb->reverse;
+	for (i = 0; i < sb->revs->cmdline.nr; i++)
+		if (sb->revs->cmdline.rev[i].flags & UNINTERESTING)
+			bd->skip_unchanged = 0;
+
 	add_bloom_key(bd, sb->path);
 
 	sb->bloom_data = bd;
@@ -2913,6 +3461,11 @@ void setup_blame_bloom_data(struct blame_scoreboard *sb)
 
 void cleanup_scoreboard(struct blame_scoreboard *sb)
 {
+	if (sb->cache) {
+		clear_blame_cache_entries(sb->cache);
+		free(sb->cache->options);
+		FREE_AND_NULL(sb->cache);
+	}
 	if (sb->bloom_data) {
 		int i;
 		for (i = 0; i < sb->bloom_data->nr; i++) {
@@ -2926,5 +3479,7 @@ void cleanup_scoreboard(struct blame_scoreboard *sb)
 				   "bloom/queries", bloom_count_queries);
 		trace2_data_intmax("blame", sb->repo,
 				   "bloom/response-no", bloom_count_no);
+		trace2_data_intmax("blame", sb->repo,
+				   "bloom/skipped-commits", bloom_count_skipped);
 	}
 }
@@ -101,6 +101,7 @@ struct blame_entry {
 };
 
 struct blame_bloom_data;
+struct blame_cache;
 
 /*
  * The current state of the blame assignment.
@@ -159,6 +160,9 @@ struct blame_scoreboard {
 
 	void *found_guilty_entry_data;
 	struct blame_bloom_data *bloom_data;
+
+	/* the on-disk blame cache, when enabled and usable */
+	struct blame_cache *cache;
 };
 
 /*
@@ -183,6 +187,29 @@ void init_scoreboard(struct blame_scoreboard *sb);
 void setup_scoreboard(struct blame_scoreboard *sb,
 		      struct blame_origin **orig);
 void setup_blame_bloom_data(struct blame_scoreboard *sb);
+
+/*
+ * Look for a cached result for the blamed path at the final commit or
+ * one of its first-parent ancestors, so that assign_blame() only has
+ * to dig through the commits after it. Call after the scoreboard is
+ * fully set up. blame_cache_write() records the complete result of
+ * assign_blame() for the final commit, evicting the least recently
+ * used results once there are more than about `limit` of them (0 for
+ * no limit); both do nothing for options that the cache cannot
+ * represent.
+ */
+#define BLAME_CACHE_DEFAULT_LIMIT 10000
+
+void blame_cache_prepare(struct blame_scoreboard *sb, int opt);
+void blame_cache_write(struct blame_scoreboard *sb, unsigned long limit);
+
+/*
+ * Remove the cached blame results of repository `r` that have not been
+ * used since `expire`, and evict the least recently used ones until
+ * there are at most about `limit` left.
+ */
+void blame_cache_gc(struct repository *r, unsigned long limit,
+		    timestamp_t expire);
 void cleanup_scoreboard(struct blame_scoreboard *sb);
 
 struct blame_entry *blame_entry_prepend(struct blame_entry *head,
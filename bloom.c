@@ -144,6 +144,41 @@ void clear_bloom_key(struct bloom_key *key)
 	FREE_AND_NULL(key->hashes);
 }
 
+struct bloom_keyvec *bloom_keyvec_new(const char *path, size_t len,
+				      const struct bloom_filter_settings *settings)
+{
+	struct bloom_keyvec *vec;
+	size_t nr = 1, i;
+	const char *p;
+
+	for (i = 0; i < len; i++)
+		if (path[i] == '/')
+			nr++;
+
+	vec = xcalloc(1, st_add(sizeof(*vec),
+				st_mult(nr, sizeof(struct bloom_key))));
+	vec->count = nr;
+
+	fill_bloom_key(path, len, &vec->key[0], settings);
+	nr = 1;
+	for (p = path + len - 1; p > path; p--)
+		if (*p == '/')
+			fill_bloom_key(path, p - path, &vec->key[nr++], settings);
+
+	return vec;
+}
+
+void bloom_keyvec_free(struct bloom_keyvec *vec)
+{
+	size_t i;
+
+	if (!vec)
+		return;
+	for (i = 0; i < vec->count; i++)
+		clear_bloom_key(&vec->key[i]);
+	free(vec);
+}
+
 void add_key_to_filter(const struct bloom_key *key,
 		       struct bloom_filter *filter,
 		       const struct bloom_filter_settings *settings)
@@ -325,3 +360,15 @@ int bloom_filter_contains(const struct bloom_filter *filter,
 
 	return 1;
 }
+
+int bloom_filter_contains_vec(const struct bloom_filter *filter,
+			      const struct bloom_keyvec *vec,
+			      const struct bloom_filter_settings *settings)
+{
+	size_t i;
+
+	for (i = 0; i < vec->count; i++)
+		if (!bloom_filter_contains(filter, &vec->key[i], settings))
+			return 0;
+	return 1;
+}
@@ -83,6 +83,24 @@ void fill_bloom_key(const char *data,
 		    const struct bloom_filter_settings *settings);
 void clear_bloom_key(struct bloom_key *key);
 
+/*
+ * The keys for a path and for each of its leading directories. A
+ * filter can only contain the path if it contains all of them, and
+ * checking the directories too cuts down on false positives.
+ */
+struct bloom_keyvec {
+	size_t count;
+	struct bloom_key key[FLEX_ARRAY];
+};
+
+/*
+ * Build the keys for the first 'len' bytes of 'path', which must use
+ * '/' as the directory separator and must not end with one.
+ */
+struct bloom_keyvec *bloom_keyvec_new(const char *path, size_t len,
+				      const struct bloom_filter_settings *settings);
+void bloom_keyvec_free(struct bloom_keyvec *vec);
+
 void add_key_to_filter(const struct bloom_key *key,
 		       struct bloom_filter *filter,
 		       const struct bloom_filter_settings *settings);
@@ -109,4 +127,12 @@ int bloom_filter_contains(const struct bloom_filter *filter,
 			  const struct bloom_key *key,
 			  const struct bloom_filter_settings *settings);
 
+/*
+ * Return 0 if the filter definitely does not contain every key in
+ * 'vec', and non-zero if it might.
+ */
+int bloom_filter_contains_vec(const struct bloom_filter *filter,
+			      const struct bloom_keyvec *vec,
+			      const struct bloom_filter_settings *settings);
+
 #endif
@@ -46,6 +46,8 @@ static int max_score_digits;
 static int show_root;
 static int reverse;
 static int blank_boundary;
+static int use_blame_cache;
+static unsigned long blame_cache_limit = BLAME_CACHE_DEFAULT_LIMIT;
 static int incremental;
 static int xdl_opts;
 static int abbrev = -1;
@@ -683,6 +685,14 @@ static int git_blame_config(const char *var, const char *value, void *cb)
 		show_root = git_config_bool(var, value);
 		return 0;
 	}
+	if (!strcmp(var, "blame.cache")) {
+		use_blame_cache = git_config_bool(var, value);
+		return 0;
+	}
+	if (!strcmp(var, "blame.cachelimit")) {
+		blame_cache_limit = git_config_ulong(var, value);
+		return 0;
+	}
 	if (!strcmp(var, "blame.blankboundary")) {
 		blank_boundary = git_config_bool(var, value);
 		return 0;
@@ -1158,6 +1168,9 @@ int cmd_blame(int argc, const char **argv, const char *prefix)
 	if (show_progress)
 		pi.progress = start_delayed_progress(_("Blaming lines"), sb.num_lines);
 
+	if (use_blame_cache)
+		blame_cache_prepare(&sb, opt);
+
 	assign_blame(&sb, opt);
 
 	stop_progress(&pi.progress);
@@ -1171,6 +1184,8 @@ int cmd_blame(int argc, const char **argv, const char *prefix)
 
 	blame_coalesce(&sb);
 
+	blame_cache_write(&sb, blame_cache_limit);
+
 	if (!(output_option & (OUTPUT_COLOR_LINE | OUTPUT_SHOW_AGE_WITH_COLOR)))
 		output_option |= coloring_mode;
 
@@ -456,7 +456,9 @@ static void print_ref_list(struct ref_filter *filter, struct ref_sorting *sortin
 	if (verify_ref_format(format))
 		die(_("unable to parse format string"));
 
+	filter_ahead_behind(the_repository, &array);
 	ref_array_sort(sorting, &array);
+	ref_array_populate(&array, array.nr);
 
 	for (i = 0; i < array.nr; i++) {
 		strbuf_reset(&err);
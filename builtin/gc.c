@@ -33,6 +33,7 @@
 #include "object-store.h"
 #include "exec-cmd.h"
 #include "hook.h"
+#include "blame.h"
 
 #define FAILED_RUN "failed to run %s"
 
@@ -52,6 +53,8 @@ static timestamp_t gc_log_expire_time;
 static const char *gc_log_expire = "1.day.ago";
 static const char *prune_expire = "2.weeks.ago";
 static const char *prune_worktrees_expire = "3.months.ago";
+static const char *blame_cache_expire = "1.month.ago";
+static unsigned long blame_cache_limit = BLAME_CACHE_DEFAULT_LIMIT;
 static unsigned long big_pack_threshold;
 static unsigned long max_delta_cache_size = DEFAULT_DELTA_CACHE_SIZE;
 
@@ -156,6 +159,8 @@ static void gc_config(void)
 	git_config_get_expiry("gc.pruneexpire", &prune_expire);
 	git_config_get_expiry("gc.worktreepruneexpire", &prune_worktrees_expire);
 	git_config_get_expiry("gc.logexpiry", &gc_log_expire);
+	git_config_get_expiry("gc.blamecacheexpire", &blame_cache_expire);
+	git_config_get_ulong("blame.cachelimit", &blame_cache_limit);
 
 	git_config_get_ulong("gc.bigpackthreshold", &big_pack_threshold);
 	git_config_get_ulong("pack.deltacachesize", &max_delta_cache_size);
@@ -691,6 +696,15 @@ int cmd_gc(int argc, const char **argv, const char *prefix)
 	if (run_command_v_opt(rerere.v, RUN_GIT_CMD))
 		die(FAILED_RUN, rerere.v[0]);
 
+	if (blame_cache_expire) {
+		timestamp_t expire;
+
+		if (parse_expiry_date(blame_cache_expire, &expire))
+			die(_("failed to parse gc.blameCacheExpire value %s"),
+			    blame_cache_expire);
+		blame_cache_gc(the_repository, blame_cache_limit, expire);
+	}
+
 	report_garbage = report_pack_garbage;
 	reprepare_packed_git(the_repository);
 	if (pack_garbage.nr > 0) {
@@ -9,6 +9,7 @@
 #include "prio-queue.h"
 #include "hash-lookup.h"
 #include "commit-slab.h"
+#include "commit-graph.h"
 
 /*
  * One day.  See the 'name a rev shortly after epoch' test in t6120 when
@@ -27,6 +28,8 @@ struct rev_name {
 define_commit_slab(commit_rev_name, struct rev_name);
 
 static timestamp_t cutoff = TIME_MAX;
+static timestamp_t generation_cutoff = GENERATION_NUMBER_INFINITY;
+static int use_generation_cutoff;
 static struct commit_rev_name rev_names;
 
 /* How many generations are maximally preferred over _one_ merge traversal? */
@@ -37,6 +40,21 @@ static int is_valid_rev_name(const struct rev_name *name)
 	return name && (name->generation || name->tip_name);
 }
 
+/*
+ * A commit can only be named through commits whose generation is at
+ * least its own, so when every commit we were asked about has a
+ * generation number, "generation_cutoff" is an exact bound that does
+ * not need any slop and is immune to clock skew.  Otherwise fall back
+ * to the commit date heuristic.
+ */
+static int commit_is_before_cutoff(struct commit *commit)
+{
+	if (use_generation_cutoff)
+		return commit_graph_generation(commit) < generation_cutoff;
+
+	return commit->date < cutoff;
+}
+
 static struct rev_name *get_commit_rev_name(const struct commit *commit)
 {
 	struct rev_name *name = commit_rev_name_peek(&rev_names, commit);
@@ -151,7 +169,7 @@ static void name_rev(struct commit *start_commit,
 	struct rev_name *start_name;
 
 	parse_commit(start_commit);
-	if (start_commit->date < cutoff)
+	if (commit_is_before_cutoff(start_commit))
 		return;
 
 	start_name = create_or_update_name(start_commit, taggerdate, 0, 0,
@@ -181,7 +199,7 @@ static void name_rev(struct commit *start_commit,
 			int generation, distance;
 
 			parse_commit(parent);
-			if (parent->date < cutoff)
+			if (commit_is_before_cutoff(parent))
 				continue;
 
 			if (parent_number > 1) {
@@ -569,6 +587,8 @@ int cmd_name_rev(int argc, const char **argv, const char *prefix)
 	}
 	if (all || annotate_stdin)
 		cutoff = 0;
+	else
+		use_generation_cutoff = generation_numbers_enabled(the_repository);
 
 	for (; argc; argc--, argv++) {
 		struct object_id oid;
@@ -599,6 +619,18 @@ int cmd_name_rev(int argc, const char **argv, const char *prefix)
 		if (commit) {
 			if (cutoff > commit->date)
 				cutoff = commit->date;
+			if (use_generation_cutoff) {
+				timestamp_t generation = commit_graph_generation(commit);
+
+				/*
+				 * A commit outside the commit-graph
+				 * gives us no bound for its ancestors.
+				 */
+				if (generation == GENERATION_NUMBER_INFINITY)
+					use_generation_cutoff = 0;
+				else if (generation_cutoff > generation)
+					generation_cutoff = generation;
+			}
 		}
 
 		if (peel_tag) {
@@ -9,6 +9,12 @@
 #include "strbuf.h"
 #include "packfile.h"
 #include "object-store.h"
+#include "tmp-objdir.h"
+#include "tempfile.h"
+#include "oidset.h"
+
+static int needs_batch_fsync;
+static struct tmp_objdir *bulk_fsync_objdir;
 
 static struct bulk_checkin_state {
 	unsigned plugged:1;
@@ -21,6 +27,9 @@ static struct bulk_checkin_state {
 	struct pack_idx_entry **written;
 	uint32_t alloc_written;
 	uint32_t nr_written;
+
+	/* the oids of "written", for quickly skipping duplicates */
+	struct oidset written_oids;
 } state;
 
 static void finish_tmp_packfile(struct strbuf *basename,
@@ -53,9 +62,10 @@ static void finish_bulk_checkin(struct bulk_checkin_state *state)
 		unlink(state->pack_tmp_name);
 		goto clear_exit;
 	} else if (state->nr_written == 1) {
-		finalize_hashfile(state->f, hash, CSUM_HASH_IN_STREAM | CSUM_FSYNC | CSUM_CLOSE);
+		finalize_hashfile(state->f, hash, FSYNC_COMPONENT_PACK,
+				  CSUM_HASH_IN_STREAM | CSUM_FSYNC | CSUM_CLOSE);
 	} else {
-		int fd = finalize_hashfile(state->f, hash, 0);
+		int fd = finalize_hashfile(state->f, hash, FSYNC_COMPONENT_PACK, 0);
 		fixup_pack_header_footer(fd, hash, state->pack_tmp_name,
 					 state->nr_written, hash,
 					 state->offset);
@@ -72,6 +82,7 @@ static void finish_bulk_checkin(struct bulk_checkin_state *state)
 
 clear_exit:
 	free(state->written);
+	oidset_clear(&state->written_oids);
 	memset(state, 0, sizeof(*state));
 
 	strbuf_release(&packname);
@@ -79,19 +90,54 @@ static void finish_bulk_checkin(struct bulk_checkin_state *state)
 	reprepare_packed_git(the_repository);
 }
 
+/*
+ * Cleanup after batch-mode fsync_object_files.
+ */
+static void do_batch_fsync(void)
+{
+	struct strbuf temp_path = STRBUF_INIT;
+	struct tempfile *temp;
+
+	if (!needs_batch_fsync)
+		goto migrate;
+
+	/*
+	 * Issue a full hardware flush against a temporary file to ensure
+	 * that all objects are durable before any renames occur. The code
+	 * in fsync_loose_object_bulk_checkin has already issued a writeout
+	 * request, but it has not flushed any writeback cache in the storage
+	 * hardware or any filesystem logs. This fsync call acts as a barrier
+	 * to ensure that the data in each new object file is durable before
+	 * the final name is visible.
+	 */
+	strbuf_addf(&temp_path, "%s/bulk_fsync_XXXXXX", get_object_directory());
+	temp = xmks_tempfile(temp_path.buf);
+	fsync_or_die(get_tempfile_fd(temp), get_tempfile_path(temp));
+	delete_tempfile(&temp);
+	strbuf_release(&temp_path);
+	needs_batch_fsync = 0;
+
+migrate:
+	/*
+	 * Make the object files visible in the primary ODB after their data
+	 * is fully durable.
+	 */
+	if (bulk_fsync_objdir) {
+		tmp_objdir_migrate(bulk_fsync_objdir);
+		bulk_fsync_objdir = NULL;
+	}
+}
+
 static int already_written(struct bulk_checkin_state *state, struct object_id *oid)
 {
-	int i;
+	/* We may have written it to this pack already */
+	if (oidset_contains(&state->written_oids, oid))
+		return 1;
 
 	/* The object may already exist in the repository */
 	if (has_object_file(oid))
 		return 1;
 
-	/* Might want to keep the list sorted */
-	for (i = 0; i < state->nr_written; i++)
-		if (oideq(&state->written[i]->oid, oid))
-			return 1;
-
 	/* This is a new object we need to keep */
 	return 0;
 }
@@ -269,7 +315,73 @@ static int deflate_to_pack(struct bulk_checkin_state *state,
 			   state->nr_written + 1,
 			   state->alloc_written);
 		state->written[state->nr_written++] = idx;
+		oidset_insert(&state->written_oids, &idx->oid);
+	}
+	return 0;
+}
+
+/*
+ * Like deflate_to_pack(), but for an object that is already in core.
+ * We can hash it before deciding whether to write it at all, so unlike
+ * the streaming case there is nothing to truncate for objects that we
+ * already have.
+ */
+static int deflate_buf_to_pack(struct bulk_checkin_state *state,
+			       struct object_id *result_oid,
+			       const void *buf, size_t size,
+			       enum object_type type, unsigned flags)
+{
+	git_zstream s;
+	unsigned char hdr[MAX_PACK_OBJECT_HEADER];
+	unsigned hdrlen;
+	unsigned long maxsize;
+	void *out;
+	size_t outlen;
+	struct pack_idx_entry *idx;
+
+	hash_object_file(the_hash_algo, buf, size, type_name(type), result_oid);
+	if (!(flags & HASH_WRITE_OBJECT) || already_written(state, result_oid))
+		return 0;
+
+	hdrlen = encode_in_pack_object_header(hdr, sizeof(hdr), type, size);
+
+	git_deflate_init(&s, pack_compression_level);
+	maxsize = git_deflate_bound(&s, size);
+	out = xmalloc(maxsize);
+	s.next_in = (void *)buf;
+	s.avail_in = size;
+	s.next_out = out;
+	s.avail_out = maxsize;
+	while (git_deflate(&s, Z_FINISH) == Z_OK)
+		; /* nothing */
+	if (s.avail_in)
+		die("unexpected deflate failure");
+	outlen = s.total_out;
+	git_deflate_end(&s);
+
+	prepare_to_stream(state, flags);
+	/* would we bust the size limit? */
+	if (state->nr_written && pack_size_limit_cfg &&
+	    pack_size_limit_cfg < state->offset + hdrlen + outlen) {
+		finish_bulk_checkin(state);
+		prepare_to_stream(state, flags);
 	}
+
+	CALLOC_ARRAY(idx, 1);
+	idx->offset = state->offset;
+	crc32_begin(state->f);
+	hashwrite(state->f, hdr, hdrlen);
+	hashwrite(state->f, out, outlen);
+	state->offset += hdrlen + outlen;
+	idx->crc32 = crc32_end(state->f);
+	free(out);
+
+	oidcpy(&idx->oid, result_oid);
+	ALLOC_GROW(state->written,
+		   state->nr_written + 1,
+		   state->alloc_written);
+	state->written[state->nr_written++] = idx;
+	oidset_insert(&state->written_oids, &idx->oid);
 	return 0;
 }
 
@@ -284,6 +396,56 @@ int index_bulk_checkin(struct object_id *oid,
 	return status;
 }
 
+int bulk_checkin_takes_small_objects(void)
+{
+	return state.plugged && core_bulk_checkin;
+}
+
+int index_bulk_checkin_buf(struct object_id *oid,
+			   const void *buf, size_t size,
+			   enum object_type type, unsigned flags)
+{
+	int status = deflate_buf_to_pack(&state, oid, buf, size, type,
+					 flags);
+	if (!state.plugged)
+		finish_bulk_checkin(&state);
+	return status;
+}
+
+void prepare_loose_object_bulk_checkin(void)
+{
+	/*
+	 * We lazily create the temporary object directory
+	 * the first time an object might be added, since
+	 * callers may not know whether any objects will be
+	 * added at the time they call plug_bulk_checkin.
+	 */
+	if (!state.plugged || bulk_fsync_objdir)
+		return;
+
+	bulk_fsync_objdir = tmp_objdir_create("bulk-fsync");
+	if (bulk_fsync_objdir)
+		tmp_objdir_replace_primary_odb(bulk_fsync_objdir, 0);
+}
+
+void fsync_loose_object_bulk_checkin(int fd, const char *filename)
+{
+	/*
+	 * If we have an active bulk-checkin temporary object directory,
+	 * only ask the OS to write the data out without a hardware
+	 * flush; unplug_bulk_checkin() issues a single flush for all of
+	 * them before making the objects visible. Otherwise (nothing is
+	 * plugged, or the writeout-only request is not supported) fall
+	 * back to a normal fsync.
+	 */
+	if (!bulk_fsync_objdir ||
+	    git_fsync(fd, FSYNC_WRITEOUT_ONLY) < 0) {
+		fsync_or_die(fd, filename);
+	} else {
+		needs_batch_fsync = 1;
+	}
+}
+
 void plug_bulk_checkin(void)
 {
 	state.plugged = 1;
@@ -294,4 +456,6 @@ void unplug_bulk_checkin(void)
 	state.plugged = 0;
 	if (state.f)
 		finish_bulk_checkin(&state);
+
+	do_batch_fsync();
 }
@@ -10,6 +10,27 @@ int index_bulk_checkin(struct object_id *oid,
 		       int fd, size_t size, enum object_type type,
 		       const char *path, unsigned flags);
 
+/*
+ * Write an object we already have in core to the bulk-checkin pack.
+ * Callers should check bulk_checkin_takes_small_objects() first; it
+ * tells whether the bulk-checkin machinery is plugged and configured
+ * (core.bulkCheckin) to take objects smaller than core.bigFileThreshold,
+ * which otherwise become loose objects.
+ */
+int bulk_checkin_takes_small_objects(void);
+int index_bulk_checkin_buf(struct object_id *oid,
+			   const void *buf, size_t size,
+			   enum object_type type, unsigned flags);
+
+/*
+ * With core.fsyncMethod=batch, loose objects written while bulk-checkin
+ * is plugged go to a temporary object directory and are only written
+ * out (not flushed to stable storage) one by one. unplug_bulk_checkin()
+ * then issues a single hardware flush and moves them into place.
+ */
+void prepare_loose_object_bulk_checkin(void);
+void fsync_loose_object_bulk_checkin(int fd, const char *filename);
+
 void plug_bulk_checkin(void);
 void unplug_bulk_checkin(void);
 
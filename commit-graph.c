@@ -45,6 +45,7 @@ void git_test_write_commit_graph_or_die(void)
 #define GRAPH_CHUNKID_BLOOMINDEXES 0x42494458 /* "BIDX" */
 #define GRAPH_CHUNKID_BLOOMDATA 0x42444154 /* "BDAT" */
 #define GRAPH_CHUNKID_BASE 0x42415345 /* "BASE" */
+#define GRAPH_CHUNKID_REACHABILITY 0x52454143 /* "REAC" */
 
 #define GRAPH_DATA_WIDTH (the_hash_algo->rawsz + 16)
 
@@ -214,7 +215,7 @@ static struct commit_graph *alloc_commit_graph(void)
 
 extern int read_replace_refs;
 
-static int commit_graph_compatible(struct repository *r)
+int commit_graph_compatible(struct repository *r)
 {
 	if (!r->gitdir)
 		return 0;
@@ -333,6 +334,29 @@ static int graph_read_bloom_data(const unsigned char *chunk_start,
 	return 0;
 }
 
+static int graph_read_reachability(const unsigned char *chunk_start,
+				   size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+	uint32_t nr;
+
+	if (chunk_size < 4)
+		goto bad;
+	nr = get_be32(chunk_start);
+	if (st_add(4, st_mult(nr, st_add(g->hash_len,
+					 (g->num_commits + 7) / 8))) != chunk_size)
+		goto bad;
+
+	g->num_reachability_tips = nr;
+	g->chunk_reachability_tips = chunk_start + 4;
+	g->chunk_reachability_bits = chunk_start + 4 + st_mult(nr, g->hash_len);
+	return 0;
+
+bad:
+	warning(_("commit-graph reachability chunk is the wrong size"));
+	return 0;
+}
+
 struct commit_graph *parse_commit_graph(struct repository *r,
 					void *graph_map, size_t graph_size)
 {
@@ -401,6 +425,7 @@ struct commit_graph *parse_commit_graph(struct repository *r,
 	pair_chunk(cf, GRAPH_CHUNKID_DATA, &graph->chunk_commit_data);
 	pair_chunk(cf, GRAPH_CHUNKID_EXTRAEDGES, &graph->chunk_extra_edges);
 	pair_chunk(cf, GRAPH_CHUNKID_BASE, &graph->chunk_base_graphs);
+	read_chunk(cf, GRAPH_CHUNKID_REACHABILITY, graph_read_reachability, graph);
 
 	if (get_configured_generation_version(r) >= 2) {
 		pair_chunk(cf, GRAPH_CHUNKID_GENERATION_DATA,
@@ -895,6 +920,40 @@ static int find_commit_pos_in_graph(struct commit *item, struct commit_graph *g,
 	}
 }
 
+int commit_graph_reachable_from(struct repository *r,
+				struct commit *tip, struct commit *commit)
+{
+	struct commit_graph *g;
+	const unsigned char *bits;
+	uint32_t i, pos;
+
+	if (!prepare_commit_graph(r))
+		return -1;
+	g = r->objects->commit_graph;
+
+	/*
+	 * The chunk is only written for a single, self-contained
+	 * commit-graph file.
+	 */
+	if (!g->chunk_reachability_tips || g->base_graph)
+		return -1;
+
+	for (i = 0; i < g->num_reachability_tips; i++) {
+		if (hasheq(g->chunk_reachability_tips + st_mult(i, g->hash_len),
+			   tip->object.oid.hash))
+			break;
+	}
+	if (i == g->num_reachability_tips)
+		return -1;
+
+	/* Everything reachable from the tip is in the graph. */
+	if (!find_commit_pos_in_graph(commit, g, &pos))
+		return 0;
+
+	bits = g->chunk_reachability_bits + st_mult(i, (g->num_commits + 7) / 8);
+	return !!(bits[pos / 8] & (1 << (pos % 8)));
+}
+
 struct commit *lookup_commit_in_graph(struct repository *repo, const struct object_id *id)
 {
 	struct commit *commit;
@@ -1040,6 +1099,9 @@ struct write_commit_graph_context {
 	int count_bloom_filter_not_computed;
 	int count_bloom_filter_trunc_empty;
 	int count_bloom_filter_trunc_large;
+
+	struct oid_array reachability_tips;
+	unsigned char *reachability_bits;
 };
 
 static int write_graph_chunk_fanout(struct hashfile *f,
@@ -1631,6 +1693,78 @@ static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 	stop_progress(&progress);
 }
 
+static int reachability_has_tip(struct write_commit_graph_context *ctx,
+				 const struct object_id *oid)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->reachability_tips.nr; i++)
+		if (oideq(&ctx->reachability_tips.oid[i], oid))
+			return 1;
+	return 0;
+}
+
+static void compute_reachability(struct write_commit_graph_context *ctx)
+{
+	const struct string_list *refs;
+	const struct string_list_item *item;
+	size_t bitmap_len = (ctx->commits.nr + 7) / 8;
+	uint32_t *stack = NULL;
+	size_t stack_nr = 0, stack_alloc = 0;
+
+	refs = repo_config_get_value_multi(ctx->r, "commitgraph.reachabilityref");
+	if (!refs)
+		return;
+
+	for_each_string_list_item(item, refs) {
+		struct object_id oid;
+		struct commit *tip;
+		unsigned char *bits;
+		int pos;
+
+		if (!item->string)
+			continue;
+		if (repo_get_oid_committish(ctx->r, item->string, &oid) ||
+		    !(tip = lookup_commit_reference_gently(ctx->r, &oid, 1))) {
+			warning(_("commitGraph.reachabilityRef '%s' does not name a commit"),
+				item->string);
+			continue;
+		}
+		pos = oid_pos(&tip->object.oid, ctx->commits.list,
+			      ctx->commits.nr, commit_to_oid);
+		if (pos < 0 || reachability_has_tip(ctx, &tip->object.oid))
+			continue;
+
+		oid_array_append(&ctx->reachability_tips, &tip->object.oid);
+		REALLOC_ARRAY(ctx->reachability_bits,
+			      st_mult(ctx->reachability_tips.nr, bitmap_len));
+		bits = ctx->reachability_bits +
+			st_mult(ctx->reachability_tips.nr - 1, bitmap_len);
+		memset(bits, 0, bitmap_len);
+
+		bits[pos / 8] |= 1 << (pos % 8);
+		ALLOC_GROW(stack, stack_nr + 1, stack_alloc);
+		stack[stack_nr++] = pos;
+		while (stack_nr) {
+			struct commit *c = ctx->commits.list[stack[--stack_nr]];
+			struct commit_list *parent;
+
+			for (parent = c->parents; parent; parent = parent->next) {
+				pos = oid_pos(&parent->item->object.oid,
+					      ctx->commits.list, ctx->commits.nr,
+					      commit_to_oid);
+				if (pos < 0 || (bits[pos / 8] & (1 << (pos % 8))))
+					continue;
+				bits[pos / 8] |= 1 << (pos % 8);
+				ALLOC_GROW(stack, stack_nr + 1, stack_alloc);
+				stack[stack_nr++] = pos;
+			}
+		}
+	}
+
+	free(stack);
+}
+
 struct refs_cb_data {
 	struct oidset *commits;
 	struct progress *progress;
@@ -1818,6 +1952,21 @@ static int write_graph_chunk_base(struct hashfile *f,
 	return 0;
 }
 
+static int write_graph_chunk_reachability(struct hashfile *f,
+					  void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	size_t i;
+
+	hashwrite_be32(f, ctx->reachability_tips.nr);
+	for (i = 0; i < ctx->reachability_tips.nr; i++)
+		hashwrite(f, ctx->reachability_tips.oid[i].hash,
+			  the_hash_algo->rawsz);
+	hashwrite(f, ctx->reachability_bits,
+		  st_mult(ctx->reachability_tips.nr, (ctx->commits.nr + 7) / 8));
+	return 0;
+}
+
 static int write_commit_graph_file(struct write_commit_graph_context *ctx)
 {
 	uint32_t i;
@@ -1903,6 +2052,11 @@ static int write_commit_graph_file(struct write_commit_graph_context *ctx)
 				+ ctx->total_bloom_filter_data_size,
 			  write_graph_chunk_bloom_data);
 	}
+	if (ctx->reachability_tips.nr)
+		add_chunk(cf, GRAPH_CHUNKID_REACHABILITY,
+			  st_add(4, st_mult(ctx->reachability_tips.nr,
+					    st_add(hashsz, (ctx->commits.nr + 7) / 8))),
+			  write_graph_chunk_reachability);
 	if (ctx->num_commit_graphs_after > 1)
 		add_chunk(cf, GRAPH_CHUNKID_BASE,
 			  hashsz * (ctx->num_commit_graphs_after - 1),
@@ -1942,7 +2096,8 @@ static int write_commit_graph_file(struct write_commit_graph_context *ctx)
 	}
 
 	close_commit_graph(ctx->r->objects);
-	finalize_hashfile(f, file_hash, CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+	finalize_hashfile(f, file_hash, FSYNC_COMPONENT_COMMIT_GRAPH,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
 	free_chunkfile(cf);
 
 	if (ctx->split) {
@@ -2406,6 +2561,9 @@ int write_commit_graph(struct object_directory *odb,
 	if (ctx->changed_paths)
 		compute_bloom_filters(ctx);
 
+	if (ctx->num_commit_graphs_after == 1)
+		compute_reachability(ctx);
+
 	res = write_commit_graph_file(ctx);
 
 	if (ctx->split)
@@ -2417,6 +2575,8 @@ int write_commit_graph(struct object_directory *odb,
 	free(ctx->graph_name);
 	free(ctx->commits.list);
 	oid_array_clear(&ctx->oids);
+	oid_array_clear(&ctx->reachability_tips);
+	free(ctx->reachability_bits);
 	clear_topo_level_slab(&topo_levels);
 
 	if (ctx->commit_graph_filenames_after) {
@@ -83,6 +83,9 @@ struct commit_graph {
 	const unsigned char *chunk_base_graphs;
 	const unsigned char *chunk_bloom_indexes;
 	const unsigned char *chunk_bloom_data;
+	const unsigned char *chunk_reachability_tips;
+	const unsigned char *chunk_reachability_bits;
+	uint32_t num_reachability_tips;
 
 	struct topo_level_slab *topo_levels;
 	struct bloom_filter_settings *bloom_filter_settings;
@@ -102,6 +105,14 @@ struct commit_graph *parse_commit_graph(struct repository *r,
  */
 int generation_numbers_enabled(struct repository *r);
 
+/*
+ * Return 1 if the history stored in the object database is the history
+ * seen by a revision walk, i.e. there are no replace refs, grafts or
+ * shallow boundaries. Otherwise precomputed reachability data (the
+ * commit-graph, reachability bitmaps) must not be trusted.
+ */
+int commit_graph_compatible(struct repository *r);
+
 /*
  * Return 1 if and only if the repository has a commit-graph
  * file and generation data chunk has been written for the file.
@@ -110,6 +121,14 @@ int corrected_commit_dates_enabled(struct repository *r);
 
 struct bloom_filter_settings *get_bloom_filter_settings(struct repository *r);
 
+/*
+ * Return 1 if "commit" is reachable from "tip", 0 if it is not, or -1
+ * if the commit-graph does not record the commits reachable from "tip"
+ * (see commitGraph.reachabilityRef).
+ */
+int commit_graph_reachable_from(struct repository *r,
+				struct commit *tip, struct commit *commit);
+
 enum commit_graph_write_flags {
 	COMMIT_GRAPH_WRITE_APPEND     = (1 << 0),
 	COMMIT_GRAPH_WRITE_PROGRESS   = (1 << 1),
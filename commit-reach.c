@@ -8,6 +8,8 @@
 #include "revision.h"
 #include "tag.h"
 #include "commit-reach.h"
+#include "ewah/ewok.h"
+#include "pack-bitmap.h"
 
 /* Remember to update object flag allocation in object.h */
 #define PARENT1		(1u<<16)
@@ -17,6 +19,51 @@
 
 static const unsigned all_flags = (PARENT1 | PARENT2 | STALE | RESULT);
 
+/*
+ * Reachability bitmaps, if the repository has them, answer "is X an
+ * ancestor of Y" directly whenever Y has a bitmap. Loading them reads
+ * every bitmap entry, and possibly the whole pack to build its reverse
+ * index, which only pays off for callers that ask many such questions
+ * (e.g. "tag --contains"); load them once per process for those.
+ */
+static struct bitmap_index *reach_bitmap_index(struct repository *r)
+{
+	static struct bitmap_index *bitmap_git;
+	static int initialized;
+
+	if (r != the_repository)
+		return NULL;
+	if (!initialized) {
+		initialized = 1;
+		if (commit_graph_compatible(r)) {
+			trace2_region_enter("commit-reach", "load-bitmaps", r);
+			bitmap_git = prepare_bitmap_git(r);
+			trace2_region_leave("commit-reach", "load-bitmaps", r);
+		}
+	}
+	return bitmap_git;
+}
+
+/*
+ * Answer "is commit reachable from tip" from precomputed data alone:
+ * the reachability bitmaps if "use_bitmaps" is set, or the reachability
+ * chunk of the commit-graph. Returns -1 if neither knows about "tip".
+ */
+static int precomputed_reach(struct repository *r,
+			     struct commit *tip, struct commit *commit,
+			     int use_bitmaps)
+{
+	struct bitmap_index *bitmap_git;
+	int ret;
+
+	if (use_bitmaps && (bitmap_git = reach_bitmap_index(r))) {
+		ret = bitmap_commit_contains(bitmap_git, tip, commit);
+		if (ret >= 0)
+			return ret;
+	}
+	return commit_graph_reachable_from(r, tip, commit);
+}
+
 static int compare_commits_by_gen(const void *_a, const void *_b)
 {
 	const struct commit *a = *(const struct commit * const *)_a;
@@ -148,84 +195,169 @@ static struct commit_list *merge_bases_many(struct repository *r,
 	return result;
 }
 
-struct commit_list *get_octopus_merge_bases(struct commit_list *in)
+define_commit_slab(bit_arrays, struct bitmap *);
+static struct bit_arrays bit_arrays;
+
+static void insert_no_dup(struct prio_queue *queue, struct commit *c)
 {
-	struct commit_list *i, *j, *k, *ret = NULL;
+	if (c->object.flags & PARENT2)
+		return;
+	prio_queue_put(queue, c);
+	c->object.flags |= PARENT2;
+}
 
-	if (!in)
-		return ret;
-
-	commit_list_insert(in->item, &ret);
-
-	for (i = in->next; i; i = i->next) {
-		struct commit_list *new_commits = NULL, *end = NULL;
-
-		for (j = ret; j; j = j->next) {
-			struct commit_list *bases;
-			bases = get_merge_bases(i->item, j->item);
-			if (!new_commits)
-				new_commits = bases;
-			else
-				end->next = bases;
-			for (k = bases; k; k = k->next)
-				end = k;
+static struct bitmap *get_bit_array(struct commit *c, size_t width)
+{
+	struct bitmap **bitmap = bit_arrays_at(&bit_arrays, c);
+	if (!*bitmap)
+		*bitmap = bitmap_word_alloc(width);
+	return *bitmap;
+}
+
+static void free_bit_array(struct commit *c)
+{
+	struct bitmap **bitmap = bit_arrays_peek(&bit_arrays, c);
+	if (!bitmap || !*bitmap)
+		return;
+	bitmap_free(*bitmap);
+	*bitmap = NULL;
+}
+
+struct bit_array_walk {
+	size_t width;
+
+	/* every commit given a bit array, for clear_bit_array_walk() */
+	struct commit **walked;
+	size_t walked_nr, walked_alloc;
+
+	/* common ancestors of all inputs that are not below another one */
+	struct commit **bases;
+	size_t bases_nr, bases_alloc;
+};
+
+static struct bitmap *walk_bit_array(struct bit_array_walk *walk,
+				     struct commit *c)
+{
+	struct bitmap **bitmap = bit_arrays_at(&bit_arrays, c);
+
+	if (!*bitmap) {
+		*bitmap = bitmap_word_alloc(walk->width);
+		ALLOC_GROW(walk->walked, walk->walked_nr + 1, walk->walked_alloc);
+		walk->walked[walk->walked_nr++] = c;
+	}
+	return *bitmap;
+}
+
+/*
+ * Walk down from all the "commits" at once. Every commit we reach gets
+ * a bit array in which bit i is set when commits[i] can reach it. A
+ * commit with all bits set is a common ancestor of every input and is
+ * collected in walk->bases; its ancestors are marked STALE, and the
+ * walk stops once only STALE commits are left in the queue.
+ *
+ * Like paint_down_to_common(), a commit is queued again whenever it
+ * learns something new after it was popped, which happens when commit
+ * dates are skewed or equal and there are no generation numbers.
+ *
+ * The caller looks at the bit arrays it needs, then releases them with
+ * clear_bit_array_walk(). walk->bases is left for the caller to free.
+ */
+static void paint_bit_arrays(struct repository *r,
+			     struct commit **commits, size_t commits_nr,
+			     struct bit_array_walk *walk)
+{
+	struct prio_queue queue = { compare_commits_by_gen_then_commit_date };
+	size_t i;
+
+	init_bit_arrays(&bit_arrays);
+	walk->width = DIV_ROUND_UP(commits_nr, BITS_IN_EWORD);
+
+	for (i = 0; i < commits_nr; i++) {
+		struct commit *c = commits[i];
+
+		repo_parse_commit(r, c);
+		bitmap_set(walk_bit_array(walk, c), i);
+		insert_no_dup(&queue, c);
+	}
+
+	while (queue_has_nonstale(&queue)) {
+		struct commit *c = prio_queue_get(&queue);
+		struct bitmap *bitmap_c = walk_bit_array(walk, c);
+		struct commit_list *p;
+
+		c->object.flags &= ~PARENT2;
+
+		if (!(c->object.flags & (STALE | RESULT)) &&
+		    bitmap_popcount(bitmap_c) == commits_nr) {
+			ALLOC_GROW(walk->bases, walk->bases_nr + 1,
+				   walk->bases_alloc);
+			walk->bases[walk->bases_nr++] = c;
+			c->object.flags |= RESULT | STALE;
+		}
+
+		for (p = c->parents; p; p = p->next) {
+			struct bitmap *bitmap_p;
+			size_t before;
+			int changed = 0;
+
+			repo_parse_commit(r, p->item);
+
+			bitmap_p = walk_bit_array(walk, p->item);
+			before = bitmap_popcount(bitmap_p);
+			bitmap_or(bitmap_p, bitmap_c);
+			if (bitmap_popcount(bitmap_p) != before)
+				changed = 1;
+			if ((c->object.flags & STALE) &&
+			    !(p->item->object.flags & STALE)) {
+				p->item->object.flags |= STALE;
+				changed = 1;
+			}
+
+			if (changed)
+				insert_no_dup(&queue, p->item);
 		}
-		ret = new_commits;
 	}
-	return ret;
+
+	clear_prio_queue(&queue);
+}
+
+static void clear_bit_array_walk(struct bit_array_walk *walk)
+{
+	size_t i;
+
+	/* STALE and RESULT are used here, PARENT2 by insert_no_dup(). */
+	for (i = 0; i < walk->walked_nr; i++) {
+		walk->walked[i]->object.flags &= ~(PARENT2 | STALE | RESULT);
+		free_bit_array(walk->walked[i]);
+	}
+	clear_bit_arrays(&bit_arrays);
+	FREE_AND_NULL(walk->walked);
+	walk->walked_nr = walk->walked_alloc = 0;
 }
 
+/*
+ * An input is redundant when another input can reach it, so a single
+ * paint_bit_arrays() walk answers the question for all of them: the
+ * independent ones are those that only carry their own bit.
+ */
 static int remove_redundant_no_gen(struct repository *r,
 				   struct commit **array, int cnt)
 {
-	struct commit **work;
-	unsigned char *redundant;
-	int *filled_index;
-	int i, j, filled;
+	struct bit_array_walk walk = { 0 };
+	int i, filled;
 
-	CALLOC_ARRAY(work, cnt);
-	redundant = xcalloc(cnt, 1);
-	ALLOC_ARRAY(filled_index, cnt - 1);
+	if (cnt < 2)
+		return cnt;
 
-	for (i = 0; i < cnt; i++)
-		repo_parse_commit(r, array[i]);
-	for (i = 0; i < cnt; i++) {
-		struct commit_list *common;
-		timestamp_t min_generation = commit_graph_generation(array[i]);
+	paint_bit_arrays(r, array, cnt, &walk);
+	for (i = filled = 0; i < cnt; i++) {
+		struct bitmap *bitmap = *bit_arrays_at(&bit_arrays, array[i]);
 
-		if (redundant[i])
-			continue;
-		for (j = filled = 0; j < cnt; j++) {
-			timestamp_t curr_generation;
-			if (i == j || redundant[j])
-				continue;
-			filled_index[filled] = j;
-			work[filled++] = array[j];
-
-			curr_generation = commit_graph_generation(array[j]);
-			if (curr_generation < min_generation)
-				min_generation = curr_generation;
-		}
-		common = paint_down_to_common(r, array[i], filled,
-					      work, min_generation);
-		if (array[i]->object.flags & PARENT2)
-			redundant[i] = 1;
-		for (j = 0; j < filled; j++)
-			if (work[j]->object.flags & PARENT1)
-				redundant[filled_index[j]] = 1;
-		clear_commit_marks(array[i], all_flags);
-		clear_commit_marks_many(filled, work, all_flags);
-		free_commit_list(common);
-	}
-
-	/* Now collect the result */
-	COPY_ARRAY(work, array, cnt);
-	for (i = filled = 0; i < cnt; i++)
-		if (!redundant[i])
-			array[filled++] = work[i];
-	free(work);
-	free(redundant);
-	free(filled_index);
+		if (bitmap_popcount(bitmap) == 1)
+			array[filled++] = array[i];
+	}
+	clear_bit_array_walk(&walk);
+	free(walk.bases);
 	return filled;
 }
 
@@ -373,6 +505,52 @@ static int remove_redundant(struct repository *r, struct commit **array, int cnt
 	return remove_redundant_no_gen(r, array, cnt);
 }
 
+/*
+ * Find the best common ancestors of all the "commits" in a single
+ * paint_bit_arrays() walk instead of folding them in pairwise.
+ */
+static struct commit_list *octopus_merge_bases(struct repository *r,
+					       struct commit **commits,
+					       size_t commits_nr)
+{
+	struct bit_array_walk walk = { 0 };
+	struct commit_list *result = NULL;
+	size_t i;
+	int cnt;
+
+	paint_bit_arrays(r, commits, commits_nr, &walk);
+	clear_bit_array_walk(&walk);
+
+	/*
+	 * Clock skew without generation numbers can still make us find
+	 * a common ancestor before one of its descendants.
+	 */
+	cnt = walk.bases_nr;
+	if (cnt > 1)
+		cnt = remove_redundant(r, walk.bases, cnt);
+	for (i = 0; i < cnt; i++)
+		commit_list_insert_by_date(walk.bases[i], &result);
+	free(walk.bases);
+	return result;
+}
+
+struct commit_list *get_octopus_merge_bases(struct commit_list *in)
+{
+	struct commit **commits;
+	struct commit_list *ret;
+	size_t nr = commit_list_count(in), i;
+
+	if (!in)
+		return NULL;
+
+	ALLOC_ARRAY(commits, nr);
+	for (i = 0; i < nr; i++, in = in->next)
+		commits[i] = in->item;
+	ret = octopus_merge_bases(the_repository, commits, nr);
+	free(commits);
+	return ret;
+}
+
 static struct commit_list *get_merge_bases_many_0(struct repository *r,
 						  struct commit *one,
 						  int n,
@@ -441,13 +619,30 @@ struct commit_list *repo_get_merge_bases(struct repository *r,
 /*
  * Is "commit" a descendant of one of the elements on the "with_commit" list?
  */
-int repo_is_descendant_of(struct repository *r,
-			  struct commit *commit,
-			  struct commit_list *with_commit)
+static int is_descendant_of(struct repository *r,
+			    struct commit *commit,
+			    struct commit_list *with_commit,
+			    int use_bitmaps)
 {
 	if (!with_commit)
 		return 1;
 
+	/*
+	 * Whether the precomputed data knows about "commit" does not
+	 * depend on what we ask about, so the first answer tells us
+	 * whether we can skip the walk altogether.
+	 */
+	switch (precomputed_reach(r, commit, with_commit->item, use_bitmaps)) {
+	case 1:
+		return 1;
+	case 0:
+		while ((with_commit = with_commit->next))
+			if (precomputed_reach(r, commit, with_commit->item,
+					      use_bitmaps) > 0)
+				return 1;
+		return 0;
+	}
+
 	if (generation_numbers_enabled(the_repository)) {
 		struct commit_list *from_list = NULL;
 		int result;
@@ -468,6 +663,13 @@ int repo_is_descendant_of(struct repository *r,
 	}
 }
 
+int repo_is_descendant_of(struct repository *r,
+			  struct commit *commit,
+			  struct commit_list *with_commit)
+{
+	return is_descendant_of(r, commit, with_commit, 0);
+}
+
 /*
  * Is "commit" an ancestor of one of the "references"?
  */
@@ -475,14 +677,43 @@ int repo_in_merge_bases_many(struct repository *r, struct commit *commit,
 			     int nr_reference, struct commit **reference)
 {
 	struct commit_list *bases;
-	int ret = 0, i;
+	struct commit **unknown = NULL;
+	int ret = 0, i, nr = 0;
 	timestamp_t generation, max_generation = GENERATION_NUMBER_ZERO;
 
+	/*
+	 * Answer from the precomputed data for whichever references it
+	 * covers, and only walk from the rest.
+	 */
+	for (i = 0; i < nr_reference; i++) {
+		switch (precomputed_reach(r, reference[i], commit, 0)) {
+		case 1:
+			free(unknown);
+			return 1;
+		case 0:
+			if (!unknown) {
+				ALLOC_ARRAY(unknown, nr_reference);
+				COPY_ARRAY(unknown, reference, i);
+				nr = i;
+			}
+			break;
+		default:
+			if (unknown)
+				unknown[nr++] = reference[i];
+		}
+	}
+	if (unknown) {
+		if (!nr)
+			goto cleanup;
+		nr_reference = nr;
+		reference = unknown;
+	}
+
 	if (repo_parse_commit(r, commit))
-		return ret;
+		goto cleanup;
 	for (i = 0; i < nr_reference; i++) {
 		if (repo_parse_commit(r, reference[i]))
-			return ret;
+			goto cleanup;
 
 		generation = commit_graph_generation(reference[i]);
 		if (generation > max_generation)
@@ -491,7 +722,7 @@ int repo_in_merge_bases_many(struct repository *r, struct commit *commit,
 
 	generation = commit_graph_generation(commit);
 	if (generation > max_generation)
-		return ret;
+		goto cleanup;
 
 	bases = paint_down_to_common(r, commit,
 				     nr_reference, reference,
@@ -501,6 +732,8 @@ int repo_in_merge_bases_many(struct repository *r, struct commit *commit,
 	clear_commit_marks(commit, all_flags);
 	clear_commit_marks_many(nr_reference, reference, all_flags);
 	free_commit_list(bases);
+cleanup:
+	free(unknown);
 	return ret;
 }
 
@@ -639,6 +872,24 @@ static enum contains_result contains_test(struct commit *candidate,
 		return CONTAINS_YES;
 	}
 
+	/* or does a bitmap or the commit-graph know? */
+	if (want)
+		switch (precomputed_reach(the_repository, candidate,
+					  want->item, 1)) {
+		case 1:
+			*cached = CONTAINS_YES;
+			return CONTAINS_YES;
+		case 0:
+			while ((want = want->next))
+				if (precomputed_reach(the_repository, candidate,
+						      want->item, 1) > 0) {
+					*cached = CONTAINS_YES;
+					return CONTAINS_YES;
+				}
+			*cached = CONTAINS_NO;
+			return CONTAINS_NO;
+		}
+
 	/* Otherwise, we don't know; prepare to recurse */
 	parse_commit_or_die(candidate);
 
@@ -713,7 +964,7 @@ int commit_contains(struct ref_filter *filter, struct commit *commit,
 {
 	if (filter->with_commit_tag_algo)
 		return contains_tag_algo(commit, list, cache) == CONTAINS_YES;
-	return repo_is_descendant_of(the_repository, commit, list);
+	return is_descendant_of(the_repository, commit, list, 1);
 }
 
 int can_all_from_reach_with_flag(struct object_array *from,
@@ -942,3 +1193,79 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 
 	return found_commits;
 }
+
+void ahead_behind(struct repository *r,
+		  struct commit **commits, size_t commits_nr,
+		  struct ahead_behind_count *counts, size_t counts_nr)
+{
+	struct prio_queue queue = { compare_commits_by_gen_then_commit_date };
+	size_t width = DIV_ROUND_UP(commits_nr, BITS_IN_EWORD);
+	size_t i;
+
+	if (!commits_nr || !counts_nr)
+		return;
+
+	for (i = 0; i < counts_nr; i++) {
+		counts[i].ahead = 0;
+		counts[i].behind = 0;
+	}
+
+	init_bit_arrays(&bit_arrays);
+
+	for (i = 0; i < commits_nr; i++) {
+		struct commit *c = commits[i];
+		struct bitmap *bitmap = get_bit_array(c, width);
+
+		bitmap_set(bitmap, i);
+		insert_no_dup(&queue, c);
+	}
+
+	while (queue_has_nonstale(&queue)) {
+		struct commit *c = prio_queue_get(&queue);
+		struct commit_list *p;
+		struct bitmap *bitmap_c = get_bit_array(c, width);
+
+		if (!(c->object.flags & STALE)) {
+			for (i = 0; i < counts_nr; i++) {
+				int reach_from_tip = !!bitmap_get(bitmap_c, counts[i].tip_index);
+				int reach_from_base = !!bitmap_get(bitmap_c, counts[i].base_index);
+
+				if (reach_from_tip == reach_from_base)
+					continue;
+				if (reach_from_base)
+					counts[i].behind++;
+				else
+					counts[i].ahead++;
+			}
+		}
+
+		for (p = c->parents; p; p = p->next) {
+			struct bitmap *bitmap_p;
+
+			repo_parse_commit(r, p->item);
+
+			bitmap_p = get_bit_array(p->item, width);
+			bitmap_or(bitmap_p, bitmap_c);
+
+			/*
+			 * A parent reachable from every input cannot
+			 * contribute to any count, nor can its ancestors.
+			 * Mark it STALE so the walk can stop once only
+			 * such commits are left in the queue.
+			 */
+			if (bitmap_popcount(bitmap_p) == commits_nr)
+				p->item->object.flags |= STALE;
+
+			insert_no_dup(&queue, p->item);
+		}
+
+		free_bit_array(c);
+	}
+
+	/* STALE is used here, PARENT2 is used by insert_no_dup(). */
+	repo_clear_commit_marks(r, PARENT2 | STALE);
+	while (queue.nr)
+		free_bit_array(prio_queue_get(&queue));
+	clear_bit_arrays(&bit_arrays);
+	clear_prio_queue(&queue);
+}
@@ -104,4 +104,46 @@ struct commit_list *get_reachable_subset(struct commit **from, int nr_from,
 					 struct commit **to, int nr_to,
 					 unsigned int reachable_flag);
 
+struct ahead_behind_count {
+	/*
+	 * As input, the *_index members indicate which positions in
+	 * the 'commits' array correspond to the tip and base of this
+	 * comparison.
+	 */
+	size_t tip_index;
+	size_t base_index;
+
+	/*
+	 * These values store the computed counts for each side of the
+	 * symmetric difference:
+	 *
+	 * 'ahead' stores the number of commits reachable from the tip
+	 * and not reachable from the base.
+	 *
+	 * 'behind' stores the number of commits reachable from the base
+	 * and not reachable from the tip.
+	 */
+	unsigned int ahead;
+	unsigned int behind;
+};
+
+/*
+ * Given an array of commits and an array of ahead_behind_count pairs,
+ * compute the ahead/behind counts for each pair in a single walk.
+ * Every commit visited carries a bit per input commit recording which
+ * of the inputs can reach it, and the walk stops as soon as every
+ * commit left in the queue is reachable from all of the inputs.
+ *
+ * The walk visits commits in generation-number order, so the counts
+ * are exact when a commit-graph is available; otherwise it falls back
+ * to commit dates and, like the merge-base walk, may miscount across
+ * clock skew.
+ *
+ * This method uses the PARENT2 and STALE flags during its operation,
+ * so be sure these flags are not set before calling the method.
+ */
+void ahead_behind(struct repository *r,
+		  struct commit **commits, size_t commits_nr,
+		  struct ahead_behind_count *counts, size_t counts_nr);
+
 #endif
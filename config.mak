@@ -0,0 +1,4 @@
+NO_GETTEXT=1
+NO_TCLTK=1
+DEVELOPER=1
+DEVOPTS=no-error
@@ -1448,7 +1448,7 @@ _git_bisect ()
 	esac
 }
 
-__git_ref_fieldlist="refname objecttype objectsize objectname upstream push HEAD symref"
+__git_ref_fieldlist="refname objecttype objectsize objectname upstream push HEAD symref ahead-behind"
 
 _git_branch ()
 {
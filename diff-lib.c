@@ -527,11 +527,25 @@ static int diff_cache(struct rev_info *revs,
 	struct tree *tree;
 	struct tree_desc t;
 	struct unpack_trees_options opts;
+	struct index_state *istate = revs->diffopt.repo->index;
 
 	tree = parse_tree_indirect(tree_oid);
 	if (!tree)
 		return error("bad tree object %s",
 			     tree_name ? tree_name : oid_to_hex(tree_oid));
+
+	/*
+	 * A valid cache-tree at the top level that records this very
+	 * tree means the index matches it entry for entry: unmerged and
+	 * i-t-a entries invalidate the cache-tree all the way up to the
+	 * root.  "diff-index --cached" has nothing to report then, so do
+	 * not bother walking the index at all.
+	 */
+	if (cached && !revs->diffopt.flags.find_copies_harder &&
+	    istate->cache_tree && istate->cache_tree->entry_count >= 0 &&
+	    oideq(&istate->cache_tree->oid, &tree->object.oid))
+		return 0;
+
 	memset(&opts, 0, sizeof(opts));
 	opts.head_idx = 1;
 	opts.index_only = cached;
@@ -540,7 +554,7 @@ static int diff_cache(struct rev_info *revs,
 	opts.merge = 1;
 	opts.fn = oneway_diff;
 	opts.unpack_data = revs;
-	opts.src_index = revs->diffopt.repo->index;
+	opts.src_index = istate;
 	opts.dst_index = NULL;
 	opts.pathspec = &revs->diffopt.pathspec;
 	opts.pathspec->recursive = 1;
@@ -437,6 +437,11 @@ int git_diff_basic_config(const char *var, const char *value, void *cb)
 		return 0;
 	}
 
+	if (!strcmp(var, "diff.renamelsh")) {
+		default_diff_options.rename_lsh = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (userdiff_config(var, value) < 0)
 		return -1;
 
@@ -311,6 +311,12 @@ struct diff_options {
 	int rename_score;
 	int rename_limit;
 
+	/*
+	 * Only score the rename candidates suggested by locality-sensitive
+	 * hashing of the file contents, instead of all of them.
+	 */
+	int rename_lsh;
+
 	int needed_rename_limit;
 	int degraded_cc_to_c;
 	int show_rename_progress;
@@ -163,6 +163,43 @@ static struct spanhash_top *hash_chars(struct repository *r,
 	return hash;
 }
 
+/*
+ * The i-th hash function of the MinHash family: the finalizer of
+ * splitmix64, seeded differently for each i.
+ */
+static uint32_t minhash_mix(uint32_t hashval, int i)
+{
+	uint64_t h = hashval + (uint64_t)(i + 1) * 0x9e3779b97f4a7c15ULL;
+
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+	return (uint32_t)(h ^ (h >> 31));
+}
+
+void diffcore_minhash(struct repository *r,
+		      struct diff_filespec *one,
+		      void **count_p,
+		      uint32_t *sig, int nr)
+{
+	struct spanhash_top *count = *count_p;
+	struct spanhash *s;
+	int i;
+
+	if (!count)
+		*count_p = count = hash_chars(r, one);
+
+	for (i = 0; i < nr; i++)
+		sig[i] = UINT32_MAX;
+	/* hash_chars() sorts the zero-count slots at the end */
+	for (s = count->data; s->cnt; s++) {
+		for (i = 0; i < nr; i++) {
+			uint32_t h = minhash_mix(s->hashval, i);
+			if (h < sig[i])
+				sig[i] = h;
+		}
+	}
+}
+
 int diffcore_count_changes(struct repository *r,
 			   struct diff_filespec *src,
 			   struct diff_filespec *dst,
@@ -206,6 +206,163 @@ static int estimate_similarity(struct repository *r,
 	return score;
 }
 
+/*
+ * With diff.renameLSH, a source is only scored against a destination
+ * if the MinHash signatures of their contents agree on all LSH_ROWS
+ * values of at least one of LSH_BANDS bands.  With two rows per band,
+ * files whose span sets have a Jaccard similarity of 1/3 (about what
+ * a 50% similarity score corresponds to) are paired with a probability
+ * of ~98%, while two files sharing only a few lines rarely are.
+ */
+#define LSH_BANDS 32
+#define LSH_ROWS 2
+#define LSH_SIG_LEN (LSH_BANDS * LSH_ROWS)
+
+struct lsh_entry {
+	uint32_t key;
+	int src; /* index in rename_src */
+};
+
+struct rename_lsh {
+	struct lsh_entry *band[LSH_BANDS];
+	int band_nr[LSH_BANDS];
+
+	/* the last destination each source was made a candidate for */
+	int *seen;
+	int *candidates;
+	uint64_t nr_scored;
+};
+
+static uint32_t lsh_band_key(const uint32_t *sig, int band)
+{
+	const uint32_t *row = sig + band * LSH_ROWS;
+	uint32_t key = 2166136261u;
+	int i;
+
+	for (i = 0; i < LSH_ROWS; i++)
+		key = (key ^ row[i]) * 16777619u;
+	return key;
+}
+
+static int lsh_entry_cmp(const void *a_, const void *b_)
+{
+	const struct lsh_entry *a = a_, *b = b_;
+
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+	return a->src - b->src;
+}
+
+static int int_cmp(const void *a_, const void *b_)
+{
+	const int *a = a_, *b = b_;
+
+	return *a - *b;
+}
+
+static int lsh_signature(struct repository *r,
+			 struct diff_filespec *one,
+			 struct diff_populate_filespec_options *dpf_opt,
+			 uint32_t *sig)
+{
+	/* estimate_similarity() gives up on these anyway */
+	if (!S_ISREG(one->mode))
+		return -1;
+
+	dpf_opt->check_size_only = 0;
+	if (!one->cnt_data && diff_populate_filespec(r, one, dpf_opt))
+		return -1;
+	diffcore_minhash(r, one, &one->cnt_data, sig, LSH_SIG_LEN);
+	diff_free_filespec_blob(one);
+	return 0;
+}
+
+static void prepare_rename_lsh(struct rename_lsh *lsh,
+			       struct repository *r,
+			       struct diff_populate_filespec_options *dpf_opt,
+			       int skip_unmodified)
+{
+	uint32_t sig[LSH_SIG_LEN];
+	int i, b;
+
+	memset(lsh, 0, sizeof(*lsh));
+	for (b = 0; b < LSH_BANDS; b++)
+		ALLOC_ARRAY(lsh->band[b], rename_src_nr);
+
+	for (i = 0; i < rename_src_nr; i++) {
+		if (skip_unmodified && diff_unmodified_pair(rename_src[i].p))
+			continue;
+		if (lsh_signature(r, rename_src[i].p->one, dpf_opt, sig))
+			continue;
+		for (b = 0; b < LSH_BANDS; b++) {
+			struct lsh_entry *e = &lsh->band[b][lsh->band_nr[b]++];
+			e->key = lsh_band_key(sig, b);
+			e->src = i;
+		}
+	}
+
+	for (b = 0; b < LSH_BANDS; b++)
+		QSORT(lsh->band[b], lsh->band_nr[b], lsh_entry_cmp);
+
+	ALLOC_ARRAY(lsh->seen, rename_src_nr);
+	for (i = 0; i < rename_src_nr; i++)
+		lsh->seen[i] = -1;
+	ALLOC_ARRAY(lsh->candidates, rename_src_nr);
+}
+
+/*
+ * Fill lsh->candidates with the sources that share a band with the
+ * destination at rename_dst[dst], in the order of rename_src so that
+ * ties are broken just like when all sources are scored.
+ */
+static int find_lsh_candidates(struct rename_lsh *lsh,
+			       struct repository *r,
+			       struct diff_populate_filespec_options *dpf_opt,
+			       int dst)
+{
+	uint32_t sig[LSH_SIG_LEN];
+	int b, nr = 0;
+
+	if (lsh_signature(r, rename_dst[dst].p->two, dpf_opt, sig))
+		return 0;
+
+	for (b = 0; b < LSH_BANDS; b++) {
+		struct lsh_entry *band = lsh->band[b];
+		uint32_t key = lsh_band_key(sig, b);
+		int lo = 0, hi = lsh->band_nr[b];
+
+		while (lo < hi) {
+			int mi = lo + (hi - lo) / 2;
+			if (band[mi].key < key)
+				lo = mi + 1;
+			else
+				hi = mi;
+		}
+		for (; lo < lsh->band_nr[b] && band[lo].key == key; lo++) {
+			int src = band[lo].src;
+
+			if (lsh->seen[src] == dst)
+				continue;
+			lsh->seen[src] = dst;
+			lsh->candidates[nr++] = src;
+		}
+	}
+
+	QSORT(lsh->candidates, nr, int_cmp);
+	lsh->nr_scored += nr;
+	return nr;
+}
+
+static void clear_rename_lsh(struct rename_lsh *lsh)
+{
+	int b;
+
+	for (b = 0; b < LSH_BANDS; b++)
+		free(lsh->band[b]);
+	free(lsh->seen);
+	free(lsh->candidates);
+}
+
 static void record_rename_pair(int dst_index, int src_index, int score)
 {
 	struct diff_filepair *src = rename_src[src_index].p;
@@ -1385,6 +1542,7 @@ void diffcore_rename_extended(struct diff_options *options,
 	struct diff_score *mx;
 	int i, j, rename_count, skip_unmodified = 0;
 	int num_destinations, dst_cnt;
+	struct rename_lsh lsh;
 	int num_sources, want_copies;
 	struct progress *progress = NULL;
 	struct mem_pool local_pool;
@@ -1546,16 +1704,22 @@ void diffcore_rename_extended(struct diff_options *options,
 	if (!num_destinations || !num_sources)
 		goto cleanup;
 
-	switch (too_many_rename_candidates(num_destinations, num_sources,
-					   options)) {
-	case 1:
-		goto cleanup;
-	case 2:
-		options->degraded_cc_to_c = 1;
-		skip_unmodified = 1;
-		break;
-	default:
-		break;
+	/*
+	 * With LSH we do not score all num_destinations * num_sources
+	 * pairs, so there is no need to limit them.
+	 */
+	if (!options->rename_lsh) {
+		switch (too_many_rename_candidates(num_destinations,
+						   num_sources, options)) {
+		case 1:
+			goto cleanup;
+		case 2:
+			options->degraded_cc_to_c = 1;
+			skip_unmodified = 1;
+			break;
+		default:
+			break;
+		}
 	}
 
 	trace2_region_enter("diff", "inexact renames", options->repo);
@@ -1572,10 +1736,18 @@ void diffcore_rename_extended(struct diff_options *options,
 		dpf_options.missing_object_data = &prefetch_options;
 	}
 
+	if (options->rename_lsh) {
+		trace2_region_enter("diff", "rename lsh", options->repo);
+		prepare_rename_lsh(&lsh, options->repo, &dpf_options,
+				   skip_unmodified);
+		trace2_region_leave("diff", "rename lsh", options->repo);
+	}
+
 	CALLOC_ARRAY(mx, st_mult(NUM_CANDIDATE_PER_DST, num_destinations));
 	for (dst_cnt = i = 0; i < rename_dst_nr; i++) {
 		struct diff_filespec *two = rename_dst[i].p->two;
 		struct diff_score *m;
+		int c, nr_candidates = rename_src_nr;
 
 		if (rename_dst[i].is_rename)
 			continue; /* exact or basename match already handled */
@@ -1584,10 +1756,17 @@ void diffcore_rename_extended(struct diff_options *options,
 		for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
 			m[j].dst = -1;
 
-		for (j = 0; j < rename_src_nr; j++) {
-			struct diff_filespec *one = rename_src[j].p->one;
+		if (options->rename_lsh)
+			nr_candidates = find_lsh_candidates(&lsh, options->repo,
+							    &dpf_options, i);
+
+		for (c = 0; c < nr_candidates; c++) {
+			struct diff_filespec *one;
 			struct diff_score this_src;
 
+			j = options->rename_lsh ? lsh.candidates[c] : c;
+			one = rename_src[j].p->one;
+
 			assert(!one->rename_used || want_copies || break_idx);
 
 			if (skip_unmodified &&
@@ -1615,6 +1794,12 @@ void diffcore_rename_extended(struct diff_options *options,
 	}
 	stop_progress(&progress);
 
+	if (options->rename_lsh) {
+		trace2_data_intmax("diff", options->repo,
+				   "rename lsh/scored pairs", lsh.nr_scored);
+		clear_rename_lsh(&lsh);
+	}
+
 	/* cost matrix sorted by most to least similar pair */
 	STABLE_QSORT(mx, dst_cnt * NUM_CANDIDATE_PER_DST, score_compare);
 
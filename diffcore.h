@@ -224,6 +224,18 @@ int diffcore_count_changes(struct repository *r,
 			   unsigned long *src_copied,
 			   unsigned long *literal_added);
 
+/*
+ * Fill sig[0..nr-1] with a MinHash signature of the set of spans that
+ * diffcore_count_changes() would compare for "one"; the fraction of
+ * positions at which the signatures of two files agree estimates the
+ * Jaccard similarity of their span sets.  The span counts are cached
+ * in *count_p, just like diffcore_count_changes() does.
+ */
+void diffcore_minhash(struct repository *r,
+		      struct diff_filespec *one,
+		      void **count_p,
+		      uint32_t *sig, int nr);
+
 /*
  * If filespec contains an OID and if that object is missing from the given
  * repository, add that OID to to_fetch.
@@ -236,6 +236,34 @@ void ewah_set(struct ewah_bitmap *self, size_t i)
 	}
 }
 
+int ewah_get(struct ewah_bitmap *self, size_t i)
+{
+	size_t word = i / BITS_IN_EWORD;
+	size_t pointer = 0;
+
+	if (i >= self->bit_size)
+		return 0;
+
+	while (pointer < self->buffer_size) {
+		eword_t *rlw = self->buffer + pointer;
+		size_t running_len = rlw_get_running_len(rlw);
+		size_t literals = rlw_get_literal_words(rlw);
+
+		if (word < running_len)
+			return rlw_get_run_bit(rlw);
+		word -= running_len;
+
+		if (word < literals)
+			return !!(self->buffer[pointer + 1 + word] &
+				  ((eword_t)1 << (i % BITS_IN_EWORD)));
+		word -= literals;
+
+		pointer += 1 + literals;
+	}
+
+	return 0;
+}
+
 void ewah_each_bit(struct ewah_bitmap *self, void (*callback)(size_t, void*), void *payload)
 {
 	size_t pos = 0;
@@ -114,6 +114,12 @@ void ewah_each_bit(struct ewah_bitmap *self, ewah_callback callback, void *paylo
  */
 void ewah_set(struct ewah_bitmap *self, size_t i);
 
+/**
+ * Return the value of the bit at position `i`, skipping over runs
+ * without decompressing them.
+ */
+int ewah_get(struct ewah_bitmap *self, size_t i);
+
 struct ewah_iterator {
 	const eword_t *buffer;
 	size_t buffer_size;
@@ -958,6 +958,20 @@ char *xgetcwd(void);
 FILE *fopen_for_writing(const char *path);
 FILE *fopen_or_warn(const char *path, const char *mode);
 
+/*
+ * FSYNC_WRITEOUT_ONLY only asks the operating system to write the
+ * file's dirty pages back to the storage device, without asking the
+ * device to flush its own cache.  It is not available everywhere;
+ * git_fsync() returns -1 with errno set to ENOSYS in that case.
+ * FSYNC_HARDWARE_FLUSH is a full fsync().
+ */
+enum fsync_action {
+	FSYNC_WRITEOUT_ONLY,
+	FSYNC_HARDWARE_FLUSH
+};
+
+int git_fsync(int fd, enum fsync_action action);
+
 /*
  * Like strncmp, but only return zero if s is NUL-terminated and exactly len
  * characters long.  If it is not, consider it greater than t.
@@ -529,22 +529,23 @@ static int graph_find_new_column_by_commit(struct git_graph *graph,
 	return -1;
 }
 
-static void graph_insert_into_new_columns(struct git_graph *graph,
-					  struct commit *commit,
-					  int idx)
+static int graph_is_interesting_parent(struct git_graph *graph,
+				       struct commit *commit)
 {
-	int i = graph_find_new_column_by_commit(graph, commit);
-	int mapping_idx;
+	struct commit_list *parent;
 
-	/*
-	 * If the commit is not already in the new_columns array, then add it
-	 * and record it as being in the final column.
-	 */
-	if (i < 0) {
-		i = graph->num_new_columns++;
-		graph->new_columns[i].commit = commit;
-		graph->new_columns[i].color = graph_find_commit_color(graph, commit);
+	for (parent = first_interesting_parent(graph);
+	     parent;
+	     parent = next_interesting_parent(graph, parent)) {
+		if (parent->item == commit)
+			return 1;
 	}
+	return 0;
+}
+
+static void graph_map_new_column(struct git_graph *graph, int i, int idx)
+{
+	int mapping_idx;
 
 	if (graph->num_parents > 1 && idx > -1 && graph->merge_layout == -1) {
 		/*
@@ -584,6 +585,50 @@ static void graph_insert_into_new_columns(struct git_graph *graph,
 	graph->mapping[mapping_idx] = i;
 }
 
+static void graph_insert_into_new_columns(struct git_graph *graph,
+					  struct commit *commit,
+					  int idx)
+{
+	int i = graph_find_new_column_by_commit(graph, commit);
+
+	/*
+	 * If the commit is not already in the new_columns array, then add it
+	 * and record it as being in the final column.
+	 */
+	if (i < 0) {
+		i = graph->num_new_columns++;
+		graph->new_columns[i].commit = commit;
+		graph->new_columns[i].color = graph_find_commit_color(graph, commit);
+	}
+
+	graph_map_new_column(graph, i, idx);
+}
+
+static void graph_carry_over_column(struct git_graph *graph,
+				    const struct column *column,
+				    int seen_this)
+{
+	int i = -1;
+
+	/*
+	 * graph->columns never holds the same commit twice, so a column
+	 * carried over from the previous row can only be in new_columns
+	 * already if it was added there as a parent of this commit.
+	 * Checking the (few) parents first avoids searching all the
+	 * columns for every column, which made each row quadratic in
+	 * the width of the graph.
+	 */
+	if (seen_this && graph_is_interesting_parent(graph, column->commit))
+		i = graph_find_new_column_by_commit(graph, column->commit);
+
+	if (i < 0) {
+		i = graph->num_new_columns++;
+		graph->new_columns[i] = *column;
+	}
+
+	graph_map_new_column(graph, i, -1);
+}
+
 static void graph_update_columns(struct git_graph *graph)
 {
 	struct commit_list *parent;
@@ -673,7 +718,8 @@ static void graph_update_columns(struct git_graph *graph)
 			if (graph->num_parents == 0)
 				graph->width += 2;
 		} else {
-			graph_insert_into_new_columns(graph, col_commit, -1);
+			graph_carry_over_column(graph, &graph->columns[i],
+						seen_this);
 		}
 	}
 
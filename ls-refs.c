@@ -6,10 +6,13 @@
 #include "ls-refs.h"
 #include "pkt-line.h"
 #include "config.h"
+#include "lockfile.h"
+#include "trace2.h"
 
 static int config_read;
 static int advertise_unborn;
 static int allow_unborn;
+static int use_cache;
 
 static void ensure_config_read(void)
 {
@@ -37,6 +40,7 @@ static void ensure_config_read(void)
 			die(_("invalid value '%s' for lsrefs.unborn"), str);
 		}
 	}
+	repo_config_get_bool(the_repository, "lsrefs.cache", &use_cache);
 	config_read = 1;
 }
 
@@ -73,8 +77,28 @@ struct ls_refs_data {
 	struct strvec prefixes;
 	struct strbuf buf;
 	unsigned unborn : 1;
+
+	/* The configuration that affects the response; see ls_refs_config(). */
+	struct strbuf config;
+
+	/* If non-NULL, the response is written to this cache file, too. */
+	FILE *cache;
 };
 
+/*
+ * Write `pkt` as a pkt-line to the cache file. Unlike packet_fwrite(),
+ * neither trace it, as it has been sent already, nor die on errors;
+ * cache_finish() drops the file if there were any.
+ */
+static void cache_write_packet(FILE *cache, const struct strbuf *pkt)
+{
+	char header[4];
+
+	set_packet_header(header, pkt->len + 4);
+	fwrite(header, 1, sizeof(header), cache);
+	fwrite(pkt->buf, 1, pkt->len, cache);
+}
+
 static int send_ref(const char *refname, const struct object_id *oid,
 		    int flag, void *cb_data)
 {
@@ -114,6 +138,8 @@ static int send_ref(const char *refname, const struct object_id *oid,
 
 	strbuf_addch(&data->buf, '\n');
 	packet_fwrite(stdout, data->buf.buf, data->buf.len);
+	if (data->cache)
+		cache_write_packet(data->cache, &data->buf);
 
 	return 0;
 }
@@ -135,8 +161,15 @@ static void send_possibly_unborn_head(struct ls_refs_data *data)
 	strbuf_release(&namespaced);
 }
 
-static int ls_refs_config(const char *var, const char *value, void *data)
+static int ls_refs_config(const char *var, const char *value, void *cb_data)
 {
+	struct ls_refs_data *data = cb_data;
+
+	/* Responses depend on which refs are hidden; see the cache below. */
+	if (!strcmp(var, "transfer.hiderefs") ||
+	    !strcmp(var, "uploadpack.hiderefs"))
+		strbuf_addf(&data->config, "%s=%s\n", var, value ? value : "");
+
 	/*
 	 * We only serve fetches over v2 for now, so respect only "uploadpack"
 	 * config. This may need to eventually be expanded to "receive", but we
@@ -145,16 +178,172 @@ static int ls_refs_config(const char *var, const char *value, void *data)
 	return parse_hide_refs_config(var, value, "uploadpack");
 }
 
+/*
+ * With lsrefs.cache, responses are kept in files in "ls-refs-cache/",
+ * one for each set of arguments, named after a hash of the arguments
+ * and of the configuration that affects the response. A file starts
+ * with a line holding a hash of the generation token of the refs that
+ * the response was computed from, followed by the response itself. We
+ * keep at most this many files, and drop stale ones to make room:
+ */
+#define LS_REFS_CACHE_MAX 16
+
+static void hash_to_cache_hex(struct strbuf *out, const struct strbuf *in)
+{
+	unsigned char hash[GIT_MAX_RAWSZ];
+	git_hash_ctx ctx;
+
+	the_hash_algo->init_fn(&ctx);
+	the_hash_algo->update_fn(&ctx, in->buf, in->len);
+	the_hash_algo->final_fn(hash, &ctx);
+	strbuf_addstr(out, hash_to_hex(hash));
+}
+
+/*
+ * Fill in the path of the cache file for the request in `data`, and
+ * the header line that the file has while it is up to date. Return -1
+ * if the refs cannot tell us when they change.
+ */
+static int cache_prepare(struct repository *r, struct ls_refs_data *data,
+			 struct strbuf *path, struct strbuf *header)
+{
+	struct strbuf key = STRBUF_INIT;
+	int i;
+
+	if (refs_generation_token(get_main_ref_store(r), &key)) {
+		strbuf_release(&key);
+		return -1;
+	}
+	hash_to_cache_hex(header, &key);
+	strbuf_addch(header, '\n');
+
+	strbuf_reset(&key);
+	strbuf_addf(&key, "namespace %s\n", get_git_namespace());
+	strbuf_addf(&key, "peel %u symrefs %u unborn %u\n",
+		    data->peel, data->symrefs, data->unborn);
+	strbuf_addbuf(&key, &data->config);
+	for (i = 0; i < data->prefixes.nr; i++)
+		strbuf_addf(&key, "ref-prefix %s\n", data->prefixes.v[i]);
+
+	strbuf_git_common_path(path, r, "ls-refs-cache/");
+	hash_to_cache_hex(path, &key);
+	strbuf_release(&key);
+	return 0;
+}
+
+/* Does the file open as `fd` start with `header`? */
+static int cache_is_current(int fd, const struct strbuf *header)
+{
+	char buf[GIT_MAX_HEXSZ + 1];
+
+	return header->len <= sizeof(buf) &&
+		read_in_full(fd, buf, header->len) == header->len &&
+		!memcmp(buf, header->buf, header->len);
+}
+
+/* Send the cached response in `path`, if it is up to date. */
+static int send_cached_refs(const char *path, const struct strbuf *header)
+{
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return 0;
+	if (!cache_is_current(fd, header)) {
+		close(fd);
+		return 0;
+	}
+
+	if (fflush(stdout) || copy_fd(fd, 1) < 0)
+		die_errno(_("unable to send cached refs"));
+	close(fd);
+	return 1;
+}
+
+/*
+ * Remove the stale files in the cache directory `dir`, and return
+ * whether there is room for another one.
+ */
+static int cache_make_room(const char *dir, const struct strbuf *header)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct dirent *de;
+	int nr = 0;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return 1;
+	strbuf_addf(&path, "%s/", dir);
+	while ((de = readdir(d)) != NULL) {
+		size_t len = path.len;
+		int fd;
+
+		if (de->d_name[0] == '.' || ends_with(de->d_name, ".lock"))
+			continue;
+		strbuf_addstr(&path, de->d_name);
+		fd = open(path.buf, O_RDONLY);
+		if (fd >= 0 && !cache_is_current(fd, header))
+			unlink(path.buf);
+		else
+			nr++;
+		if (fd >= 0)
+			close(fd);
+		strbuf_setlen(&path, len);
+	}
+	closedir(d);
+	strbuf_release(&path);
+	return nr < LS_REFS_CACHE_MAX;
+}
+
+/*
+ * Start writing the response to the cache file `path`. Caching is
+ * best-effort; if we cannot write the file, for example because the
+ * repository is read-only for us, the response is just not cached.
+ */
+static void cache_begin(struct ls_refs_data *data, struct lock_file *lock,
+			const char *path, const struct strbuf *header)
+{
+	char *dir = xstrdup(path);
+
+	*strrchr(dir, '/') = '\0';
+	if (!mkdir(dir, 0777))
+		adjust_shared_perm(dir);
+	if (cache_make_room(dir, header) &&
+	    hold_lock_file_for_update(lock, path, 0) >= 0) {
+		data->cache = fdopen_lock_file(lock, "w");
+		if (!data->cache)
+			rollback_lock_file(lock);
+		else
+			fwrite(header->buf, 1, header->len, data->cache);
+	}
+	free(dir);
+}
+
+static void cache_finish(struct ls_refs_data *data, struct lock_file *lock)
+{
+	if (!data->cache)
+		return;
+	if (ferror(data->cache) ||
+	    adjust_shared_perm(get_lock_file_path(lock)) ||
+	    commit_lock_file(lock))
+		rollback_lock_file(lock);
+	data->cache = NULL;
+}
+
 int ls_refs(struct repository *r, struct packet_reader *request)
 {
 	struct ls_refs_data data;
+	struct strbuf cache_path = STRBUF_INIT;
+	struct strbuf cache_header = STRBUF_INIT;
+	struct lock_file cache_lock = LOCK_INIT;
 
 	memset(&data, 0, sizeof(data));
 	strvec_init(&data.prefixes);
 	strbuf_init(&data.buf, 0);
+	strbuf_init(&data.config, 0);
 
 	ensure_config_read();
-	git_config(ls_refs_config, NULL);
+	git_config(ls_refs_config, &data);
 
 	while (packet_reader_read(request) == PACKET_READ_NORMAL) {
 		const char *arg = request->line;
@@ -185,14 +374,30 @@ int ls_refs(struct repository *r, struct packet_reader *request)
 	if (data.prefixes.nr >= TOO_MANY_PREFIXES)
 		strvec_clear(&data.prefixes);
 
+	if (use_cache &&
+	    !cache_prepare(r, &data, &cache_path, &cache_header)) {
+		if (send_cached_refs(cache_path.buf, &cache_header)) {
+			trace2_data_string("ls-refs", r, "cache", "hit");
+			goto out;
+		}
+		trace2_data_string("ls-refs", r, "cache", "miss");
+		cache_begin(&data, &cache_lock, cache_path.buf, &cache_header);
+	}
+
 	send_possibly_unborn_head(&data);
 	if (!data.prefixes.nr)
 		strvec_push(&data.prefixes, "");
 	for_each_fullref_in_prefixes(get_git_namespace(), data.prefixes.v,
 				     send_ref, &data);
+	cache_finish(&data, &cache_lock);
+
+out:
 	packet_fflush(stdout);
 	strvec_clear(&data.prefixes);
 	strbuf_release(&data.buf);
+	strbuf_release(&data.config);
+	strbuf_release(&cache_path);
+	strbuf_release(&cache_header);
 	return 0;
 }
 
@@ -1846,14 +1846,24 @@ int hash_object_file(const struct git_hash_algo *algo, const void *buf,
 	return 0;
 }
 
+static int fsync_loose_objects(void)
+{
+	return fsync_object_files > 0 ||
+	       (fsync_components & FSYNC_COMPONENT_LOOSE_OBJECT);
+}
+
 /* Finalize a file on disk, and close it. */
-static void close_loose_object(int fd)
+static void close_loose_object(int fd, const char *filename)
 {
-	if (!the_repository->objects->odb->will_destroy) {
-		if (fsync_object_files)
-			fsync_or_die(fd, "loose object file");
-	}
+	if (the_repository->objects->odb->will_destroy)
+		goto out;
 
+	if (fsync_loose_objects() && fsync_method == FSYNC_METHOD_BATCH)
+		fsync_loose_object_bulk_checkin(fd, filename);
+	else if (fsync_loose_objects())
+		fsync_or_die(fd, filename);
+
+out:
 	if (close(fd) != 0)
 		die_errno(_("error when closing loose object file"));
 }
@@ -1915,6 +1925,9 @@ static int write_loose_object(const struct object_id *oid, char *hdr,
 	static struct strbuf tmp_file = STRBUF_INIT;
 	static struct strbuf filename = STRBUF_INIT;
 
+	if (fsync_loose_objects() && fsync_method == FSYNC_METHOD_BATCH)
+		prepare_loose_object_bulk_checkin();
+
 	loose_object_path(the_repository, &filename, oid);
 
 	fd = create_tmpfile(&tmp_file, filename.buf);
@@ -1965,7 +1978,7 @@ static int write_loose_object(const struct object_id *oid, char *hdr,
 		die(_("confused by unstable object source data for %s"),
 		    oid_to_hex(oid));
 
-	close_loose_object(fd);
+	close_loose_object(fd, tmp_file.buf);
 
 	if (mtime) {
 		struct utimbuf utb;
@@ -2144,7 +2157,10 @@ static int index_mem(struct index_state *istate,
 			check_tag(buf, size);
 	}
 
-	if (write_object)
+	if (write_object && type == OBJ_BLOB &&
+	    bulk_checkin_takes_small_objects())
+		ret = index_bulk_checkin_buf(oid, buf, size, type, flags);
+	else if (write_object)
 		ret = write_object_file(buf, size, type_name(type), oid);
 	else
 		ret = hash_object_file(the_hash_algo, buf, size,
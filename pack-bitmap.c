@@ -1899,6 +1899,31 @@ int bitmap_has_oid_in_uninteresting(struct bitmap_index *bitmap_git,
 		bitmap_walk_contains(bitmap_git, bitmap_git->haves, oid);
 }
 
+int bitmap_commit_contains(struct bitmap_index *bitmap_git,
+			   struct commit *tip, struct commit *commit)
+{
+	struct ewah_bitmap *bitmap;
+	int pos;
+
+	if (oideq(&tip->object.oid, &commit->object.oid))
+		return 1;
+
+	bitmap = bitmap_for_commit(bitmap_git, tip);
+	if (!bitmap)
+		return -1;
+
+	/*
+	 * A bitmapped pack is closed under reachability, so anything
+	 * reachable from "tip" has a position in it. An object that is
+	 * missing from the pack cannot be reachable from "tip".
+	 */
+	pos = bitmap_position(bitmap_git, &commit->object.oid);
+	if (pos < 0 || pos >= bitmap_num_objects(bitmap_git))
+		return 0;
+
+	return ewah_get(bitmap, pos);
+}
+
 static off_t get_disk_usage_for_type(struct bitmap_index *bitmap_git,
 				     enum object_type object_type)
 {
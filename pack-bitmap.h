@@ -74,6 +74,14 @@ int bitmap_walk_contains(struct bitmap_index *,
  */
 int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_id *oid);
 
+/*
+ * Use the reachability bitmap stored for "tip", if any, to tell whether
+ * "commit" is reachable from it. Returns 1 if it is, 0 if it is not,
+ * and -1 if "tip" has no bitmap and the caller has to walk instead.
+ */
+int bitmap_commit_contains(struct bitmap_index *, struct commit *tip,
+			   struct commit *commit);
+
 off_t get_disk_usage_from_bitmap(struct bitmap_index *, struct rev_info *);
 
 void bitmap_writer_show_progress(int show);
@@ -1,9 +1,11 @@
 #include "builtin.h"
 #include "cache.h"
+#include "config.h"
 #include "parse-options.h"
 #include "refs.h"
 #include "wildmatch.h"
 #include "object-store.h"
+#include "packfile.h"
 #include "repository.h"
 #include "commit.h"
 #include "remote.h"
@@ -23,6 +25,8 @@
 #include "worktree.h"
 #include "hashmap.h"
 #include "strvec.h"
+#include "thread-utils.h"
+#include "prio-queue.h"
 
 static struct ref_msg {
 	const char *gone;
@@ -158,6 +162,7 @@ enum atom_type {
 	ATOM_THEN,
 	ATOM_ELSE,
 	ATOM_REST,
+	ATOM_AHEADBEHIND,
 };
 
 /*
@@ -210,10 +215,25 @@ static struct used_atom {
 		} email_option;
 		struct refname_atom refname;
 		char *head;
+		struct {
+			const char *base;
+			size_t index;
+		} ahead_behind;
 	} u;
 } *used_atom;
 static int used_atom_cnt, need_tagged, need_symref;
 
+/*
+ * An item whose values populate_values() is computing, along with the
+ * contents of its object if they have been read already.
+ */
+static struct populate_entry {
+	struct ref_array_item *item;
+	struct packed_git *pack;
+	off_t offset;
+	void *content;
+} *prefetched;
+
 /*
  * Expand string, append it to strbuf *sb, then return error code ret.
  * Allow to save few lines of code.
@@ -570,6 +590,15 @@ static int rest_atom_parser(struct ref_format *format, struct used_atom *atom,
 	return 0;
 }
 
+static int ahead_behind_atom_parser(struct ref_format *format, struct used_atom *atom,
+				   const char *arg, struct strbuf *err)
+{
+	if (!arg)
+		return strbuf_addf_ret(err, -1, _("expected format: %%(ahead-behind:<committish>)"));
+	atom->u.ahead_behind.base = xstrdup(arg);
+	return 0;
+}
+
 static int head_atom_parser(struct ref_format *format, struct used_atom *atom,
 			    const char *arg, struct strbuf *unused_err)
 {
@@ -627,6 +656,7 @@ static struct {
 	[ATOM_THEN] = { "then", SOURCE_NONE },
 	[ATOM_ELSE] = { "else", SOURCE_NONE },
 	[ATOM_REST] = { "rest", SOURCE_NONE, FIELD_STR, rest_atom_parser },
+	[ATOM_AHEADBEHIND] = { "ahead-behind", SOURCE_NONE, FIELD_STR, ahead_behind_atom_parser },
 	/*
 	 * Please update $__git_ref_fieldlist in git-completion.bash
 	 * when you add new atoms
@@ -1744,15 +1774,31 @@ static int get_object(struct ref_array_item *ref, int deref, struct object **obj
 {
 	/* parse_object_buffer() will set eaten to 0 if free() will be needed */
 	int eaten = 1;
+	int have_content = 0;
+
 	if (oi->info.contentp) {
 		/* We need to know that to use parse_object_buffer properly */
 		oi->info.sizep = &oi->size;
 		oi->info.typep = &oi->type;
+
+		/* If populate_values() has read the contents, skip that. */
+		if (!deref && prefetched && prefetched->content) {
+			oi->info.contentp = NULL;
+			have_content = 1;
+		}
 	}
 	if (oid_object_info_extended(the_repository, &oi->oid, &oi->info,
-				     OBJECT_INFO_LOOKUP_REPLACE))
+				     OBJECT_INFO_LOOKUP_REPLACE)) {
+		if (have_content)
+			oi->info.contentp = &oi->content;
 		return strbuf_addf_ret(err, -1, _("missing object %s for %s"),
 				       oid_to_hex(&oi->oid), ref->refname);
+	}
+	if (have_content) {
+		oi->info.contentp = &oi->content;
+		oi->content = prefetched->content;
+		prefetched->content = NULL;
+	}
 	if (oi->info.disk_sizep && oi->disk_size < 0)
 		BUG("Object size is less than zero.");
 
@@ -1956,6 +2002,16 @@ static int populate_value(struct ref_array_item *ref, struct strbuf *err)
 			else
 				v->s = xstrdup("");
 			continue;
+		} else if (atom_type == ATOM_AHEADBEHIND) {
+			struct ahead_behind_count *count = NULL;
+
+			if (ref->counts)
+				count = ref->counts[atom->u.ahead_behind.index];
+			if (count)
+				v->s = xstrfmt("%u %u", count->ahead, count->behind);
+			else
+				v->s = xstrdup("");
+			continue;
 		} else
 			continue;
 
@@ -2022,6 +2078,190 @@ static int get_ref_atom_value(struct ref_array_item *ref, int atom,
 	return 0;
 }
 
+static void free_array_item_values(struct ref_array_item *item)
+{
+	if (item->value) {
+		int i;
+		for (i = 0; i < used_atom_cnt; i++)
+			free((char *)item->value[i].s);
+		FREE_AND_NULL(item->value);
+	}
+}
+
+static int populate_entry_cmp(const void *a_, const void *b_)
+{
+	const struct populate_entry *a = a_, *b = b_;
+
+	/* Loose objects go last, packed ones in the order of their packs. */
+	if (a->pack != b->pack) {
+		if (!a->pack || !b->pack)
+			return a->pack ? -1 : 1;
+		return (uintptr_t)a->pack < (uintptr_t)b->pack ? -1 : 1;
+	}
+	if (a->offset != b->offset)
+		return a->offset < b->offset ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Mostly randomly chosen: read objects with up to 16 threads, with at
+ * least 100 objects per thread for it to be worth starting one, and
+ * hold the contents of at most 4096 objects in memory at a time.
+ */
+#define POPULATE_MAX_THREADS 16
+#define POPULATE_THREAD_COST 100
+#define POPULATE_BATCH 4096
+
+struct populate_thread_data {
+	pthread_t pthread;
+	struct populate_entry *entries;
+	size_t nr;
+};
+
+static void *populate_thread(void *_data)
+{
+	struct populate_thread_data *p = _data;
+	size_t i;
+
+	for (i = 0; i < p->nr; i++) {
+		struct populate_entry *entry = &p->entries[i];
+		struct object_info info = OBJECT_INFO_INIT;
+		enum object_type type;
+
+		info.typep = &type;
+		info.contentp = &entry->content;
+		/*
+		 * Leave reporting errors and fetching missing objects
+		 * to get_object().
+		 */
+		if (oid_object_info_extended(the_repository,
+					     &entry->item->objectname, &info,
+					     OBJECT_INFO_LOOKUP_REPLACE |
+					     OBJECT_INFO_SKIP_FETCH_OBJECT))
+			entry->content = NULL;
+	}
+	return NULL;
+}
+
+/*
+ * Read the contents of the objects of `entries` with `threads` threads.
+ */
+static void read_contents(struct populate_entry *entries, size_t nr,
+			  int threads)
+{
+	struct populate_thread_data data[POPULATE_MAX_THREADS];
+	size_t offset = 0, work = DIV_ROUND_UP(nr, threads);
+	int i;
+
+	enable_obj_read_lock();
+	for (i = 0; i < threads; i++) {
+		struct populate_thread_data *p = &data[i];
+		int err;
+
+		p->entries = entries + offset;
+		p->nr = offset < nr ? nr - offset : 0;
+		if (p->nr > work)
+			p->nr = work;
+		offset += p->nr;
+		err = pthread_create(&p->pthread, NULL, populate_thread, p);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	for (i = 0; i < threads; i++)
+		if (pthread_join(data[i].pthread, NULL))
+			die("unable to join thread");
+	disable_obj_read_lock();
+}
+
+/*
+ * Fill in the atom values of `items` that have not been computed yet.
+ *
+ * If the format needs to look at the objects, they are read in the
+ * order they are stored in their packs rather than in the order of
+ * `items`, so that the packs are read sequentially and delta bases
+ * that are shared between objects stay in the delta base cache. If
+ * the contents of the objects are needed and there are enough of
+ * them, worker threads read and inflate them batch by batch; parsing
+ * them and filling in the values is left to this thread, as neither
+ * the object hash nor the formatting code is thread-safe.
+ *
+ * Errors are not reported here; the values of the affected items are
+ * left out, so that get_ref_atom_value() reports the error when the
+ * item is formatted or sorted.
+ */
+static void populate_values(struct ref_array_item **items, size_t nr)
+{
+	struct object_info empty = OBJECT_INFO_INIT;
+	struct populate_entry *entries;
+	struct strbuf err = STRBUF_INIT;
+	size_t i, j, entries_nr = 0;
+	int max_threads = 1;
+	int force_threads = git_env_bool("GIT_TEST_REF_FILTER_THREADS", 0);
+
+	if (!need_tagged &&
+	    !memcmp(&oi.info, &empty, sizeof(empty)) &&
+	    !memcmp(&oi_deref.info, &empty, sizeof(empty)))
+		return;
+
+	CALLOC_ARRAY(entries, nr);
+	for (i = 0; i < nr; i++) {
+		struct populate_entry *entry = &entries[entries_nr];
+		struct pack_entry e;
+
+		if (items[i]->value)
+			continue;
+		entry->item = items[i];
+		if (find_pack_entry(the_repository, &items[i]->objectname, &e)) {
+			entry->pack = e.p;
+			entry->offset = e.offset;
+		}
+		entries_nr++;
+	}
+
+	QSORT(entries, entries_nr, populate_entry_cmp);
+
+	if (HAVE_THREADS && (need_tagged || oi.info.contentp)) {
+		max_threads = online_cpus();
+		if (max_threads < 2 && force_threads)
+			max_threads = 2;
+		if (max_threads > POPULATE_MAX_THREADS)
+			max_threads = POPULATE_MAX_THREADS;
+	}
+
+	for (i = 0; i < entries_nr; i += POPULATE_BATCH) {
+		size_t batch_nr = entries_nr - i;
+		int threads = max_threads;
+
+		if (batch_nr > POPULATE_BATCH)
+			batch_nr = POPULATE_BATCH;
+		if (threads > batch_nr / POPULATE_THREAD_COST && !force_threads)
+			threads = batch_nr / POPULATE_THREAD_COST;
+		if (threads > 1)
+			read_contents(entries + i, batch_nr, threads);
+
+		for (j = i; j < i + batch_nr; j++) {
+			struct ref_array_item *item = entries[j].item;
+
+			strbuf_reset(&err);
+			prefetched = &entries[j];
+			if (populate_value(item, &err))
+				free_array_item_values(item);
+			else
+				fill_missing_values(item->value);
+			prefetched = NULL;
+			free(entries[j].content);
+		}
+	}
+
+	strbuf_release(&err);
+	free(entries);
+}
+
+void ref_array_populate(struct ref_array *array, int nr)
+{
+	populate_values(array->items, nr < array->nr ? nr : array->nr);
+}
+
 /*
  * Return 1 if the refname matches one of the patterns, otherwise 0.
  * A pattern can be a literal prefix (e.g. a refname "refs/heads/master"
@@ -2227,8 +2467,21 @@ struct ref_filter_cbdata {
 	struct ref_filter *filter;
 	struct contains_cache contains_cache;
 	struct contains_cache no_contains_cache;
+
+	/*
+	 * If non-zero, only the first `max_count` refs in the order
+	 * given by `sorting` are wanted; see filter_and_sort_refs().
+	 */
+	int max_count;
+	struct ref_sorting *sorting;
+	unsigned int in_order : 1,
+		done : 1;
+	/* The refs kept so far, with the one that sorts last on top. */
+	struct prio_queue top;
 };
 
+static void keep_top_refs(struct ref_filter_cbdata *ref_cbdata);
+
 /*
  * A call-back given to for_each_ref().  Filter refs and keep them for
  * later object processing.
@@ -2292,6 +2545,21 @@ static int ref_filter_handler(const char *refname, const struct object_id *oid,
 	ref->flag = flag;
 	ref->kind = kind;
 
+	if (ref_cbdata->max_count) {
+		if (ref_cbdata->in_order) {
+			/*
+			 * We iterate in refname order, so all the refs
+			 * that are still to come would sort later.
+			 */
+			if (ref_cbdata->array->nr >= ref_cbdata->max_count) {
+				ref_cbdata->done = 1;
+				return 1;
+			}
+		} else if (ref_cbdata->array->nr >= POPULATE_BATCH) {
+			keep_top_refs(ref_cbdata);
+		}
+	}
+
 	return 0;
 }
 
@@ -2299,12 +2567,8 @@ static int ref_filter_handler(const char *refname, const struct object_id *oid,
 static void free_array_item(struct ref_array_item *item)
 {
 	free((char *)item->symref);
-	if (item->value) {
-		int i;
-		for (i = 0; i < used_atom_cnt; i++)
-			free((char *)item->value[i].s);
-		free(item->value);
-	}
+	free(item->counts);
+	free_array_item_values(item);
 	free(item);
 }
 
@@ -2317,11 +2581,15 @@ void ref_array_clear(struct ref_array *array)
 		free_array_item(array->items[i]);
 	FREE_AND_NULL(array->items);
 	array->nr = array->alloc = 0;
+	FREE_AND_NULL(array->counts);
+	array->counts_nr = 0;
 
 	for (i = 0; i < used_atom_cnt; i++) {
 		struct used_atom *atom = &used_atom[i];
 		if (atom->atom_type == ATOM_HEAD)
 			free(atom->u.head);
+		else if (atom->atom_type == ATOM_AHEADBEHIND)
+			free((char *)atom->u.ahead_behind.base);
 		free((char *)atom->name);
 	}
 	FREE_AND_NULL(used_atom);
@@ -2394,24 +2662,17 @@ static void reach_filter(struct ref_array *array,
 	free(to_clear);
 }
 
-/*
- * API for filtering a set of refs. Based on the type of refs the user
- * has requested, we iterate through those refs and apply filters
- * as per the given ref_filter structure and finally store the
- * filtered refs in the ref_array structure.
- */
-int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int type)
+static int do_filter_refs(struct ref_filter_cbdata *ref_cbdata,
+			  unsigned int type)
 {
-	struct ref_filter_cbdata ref_cbdata;
+	struct ref_array *array = ref_cbdata->array;
+	struct ref_filter *filter = ref_cbdata->filter;
 	int ret = 0;
 
-	ref_cbdata.array = array;
-	ref_cbdata.filter = filter;
-
 	filter->kind = type & FILTER_REFS_KIND_MASK;
 
-	init_contains_cache(&ref_cbdata.contains_cache);
-	init_contains_cache(&ref_cbdata.no_contains_cache);
+	init_contains_cache(&ref_cbdata->contains_cache);
+	init_contains_cache(&ref_cbdata->no_contains_cache);
 
 	/*  Simple per-ref filtering */
 	if (!filter->kind)
@@ -2424,19 +2685,21 @@ int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int
 		 * of filter_ref_kind().
 		 */
 		if (filter->kind == FILTER_REFS_BRANCHES)
-			ret = for_each_fullref_in("refs/heads/", ref_filter_handler, &ref_cbdata);
+			ret = for_each_fullref_in("refs/heads/", ref_filter_handler, ref_cbdata);
 		else if (filter->kind == FILTER_REFS_REMOTES)
-			ret = for_each_fullref_in("refs/remotes/", ref_filter_handler, &ref_cbdata);
+			ret = for_each_fullref_in("refs/remotes/", ref_filter_handler, ref_cbdata);
 		else if (filter->kind == FILTER_REFS_TAGS)
-			ret = for_each_fullref_in("refs/tags/", ref_filter_handler, &ref_cbdata);
+			ret = for_each_fullref_in("refs/tags/", ref_filter_handler, ref_cbdata);
 		else if (filter->kind & FILTER_REFS_ALL)
-			ret = for_each_fullref_in_pattern(filter, ref_filter_handler, &ref_cbdata);
+			ret = for_each_fullref_in_pattern(filter, ref_filter_handler, ref_cbdata);
+		if (ref_cbdata->done)
+			ret = 0; /* ref_filter_handler() has seen enough refs */
 		if (!ret && (filter->kind & FILTER_REFS_DETACHED_HEAD))
-			head_ref(ref_filter_handler, &ref_cbdata);
+			head_ref(ref_filter_handler, ref_cbdata);
 	}
 
-	clear_contains_cache(&ref_cbdata.contains_cache);
-	clear_contains_cache(&ref_cbdata.no_contains_cache);
+	clear_contains_cache(&ref_cbdata->contains_cache);
+	clear_contains_cache(&ref_cbdata->no_contains_cache);
 
 	/*  Filters that need revision walking */
 	reach_filter(array, filter->reachable_from, INCLUDE_REACHED);
@@ -2445,6 +2708,78 @@ int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int
 	return ret;
 }
 
+/*
+ * API for filtering a set of refs. Based on the type of refs the user
+ * has requested, we iterate through those refs and apply filters
+ * as per the given ref_filter structure and finally store the
+ * filtered refs in the ref_array structure.
+ */
+int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int type)
+{
+	struct ref_filter_cbdata ref_cbdata;
+
+	memset(&ref_cbdata, 0, sizeof(ref_cbdata));
+	ref_cbdata.array = array;
+	ref_cbdata.filter = filter;
+
+	return do_filter_refs(&ref_cbdata, type);
+}
+
+void filter_ahead_behind(struct repository *r,
+			 struct ref_array *array)
+{
+	struct commit **commits;
+	size_t commits_nr = 0, bases_nr = 0, i, j;
+	size_t counts_nr = 0;
+
+	for (i = 0; i < used_atom_cnt; i++)
+		if (used_atom[i].atom_type == ATOM_AHEADBEHIND)
+			used_atom[i].u.ahead_behind.index = bases_nr++;
+	if (!bases_nr || !array->nr)
+		return;
+
+	ALLOC_ARRAY(commits, bases_nr + array->nr);
+	for (i = 0; i < used_atom_cnt; i++) {
+		struct used_atom *atom = &used_atom[i];
+		struct commit *base;
+
+		if (atom->atom_type != ATOM_AHEADBEHIND)
+			continue;
+		base = lookup_commit_reference_by_name(atom->u.ahead_behind.base);
+		if (!base)
+			die(_("failed to find '%s'"), atom->u.ahead_behind.base);
+		commits[commits_nr++] = base;
+	}
+
+	CALLOC_ARRAY(array->counts, st_mult(bases_nr, array->nr));
+	for (i = 0; i < array->nr; i++) {
+		struct ref_array_item *item = array->items[i];
+		struct commit *tip;
+
+		CALLOC_ARRAY(item->counts, bases_nr);
+		tip = lookup_commit_reference_gently(r, &item->objectname, 1);
+		if (!tip)
+			continue;
+
+		commits[commits_nr] = tip;
+		for (j = 0; j < bases_nr; j++) {
+			struct ahead_behind_count *count = &array->counts[counts_nr++];
+
+			count->tip_index = commits_nr;
+			count->base_index = j;
+			item->counts[j] = count;
+		}
+		commits_nr++;
+	}
+	array->counts_nr = counts_nr;
+
+	trace2_region_enter("ref-filter", "ahead_behind", r);
+	ahead_behind(r, commits, commits_nr, array->counts, counts_nr);
+	trace2_region_leave("ref-filter", "ahead_behind", r);
+
+	free(commits);
+}
+
 static int compare_detached_head(struct ref_array_item *a, struct ref_array_item *b)
 {
 	if (!(a->kind ^ b->kind))
@@ -2560,11 +2895,157 @@ void ref_sorting_set_sort_flags_all(struct ref_sorting *sorting,
 	}
 }
 
+/*
+ * Does sorting by `sorting` order the refs the same way as comparing
+ * their full names with strcmp(), which is the order in which the ref
+ * iteration produces them?
+ */
+static int sorting_is_refname_order(struct ref_sorting *sorting)
+{
+	struct used_atom *atom;
+
+	if (!sorting)
+		return 1;
+	if (sorting->next ||
+	    sorting->sort_flags & ~REF_SORTING_DETACHED_HEAD_FIRST)
+		return 0;
+	atom = &used_atom[sorting->atom];
+	return atom->atom_type == ATOM_REFNAME &&
+		atom->u.refname.option == R_NORMAL;
+}
+
+static int sorting_needs_objects(struct ref_sorting *sorting)
+{
+	for (; sorting; sorting = sorting->next)
+		if (used_atom[sorting->atom].source != SOURCE_NONE)
+			return 1;
+	return 0;
+}
+
+static int ref_array_in_refname_order(struct ref_array *array)
+{
+	int i;
+
+	for (i = 1; i < array->nr; i++)
+		if (strcmp(array->items[i - 1]->refname,
+			   array->items[i]->refname) > 0)
+			return 0;
+	return 1;
+}
+
 void ref_array_sort(struct ref_sorting *sorting, struct ref_array *array)
 {
+	/*
+	 * The refs usually come straight from the ref iteration, which
+	 * is already in refname order.
+	 */
+	if (sorting_is_refname_order(sorting) &&
+	    ref_array_in_refname_order(array))
+		return;
+
+	/*
+	 * Comparing would look at the objects in whatever order the
+	 * sort happens to visit them; read them all up front instead.
+	 */
+	if (sorting_needs_objects(sorting))
+		populate_values(array->items, array->nr);
+
 	QSORT_S(array->items, array->nr, compare_refs, sorting);
 }
 
+static int compare_refs_reversed(const void *a, const void *b,
+				 void *ref_sorting)
+{
+	return compare_refs(&b, &a, ref_sorting);
+}
+
+/*
+ * Move the refs collected in the array to the heap of refs kept so
+ * far, and drop all but the first `max_count` of them in sort order.
+ */
+static void keep_top_refs(struct ref_filter_cbdata *ref_cbdata)
+{
+	struct ref_array *array = ref_cbdata->array;
+	struct prio_queue *top = &ref_cbdata->top;
+	int i;
+
+	if (sorting_needs_objects(ref_cbdata->sorting))
+		populate_values(array->items, array->nr);
+
+	for (i = 0; i < array->nr; i++) {
+		struct ref_array_item *item = array->items[i];
+
+		if (top->nr >= ref_cbdata->max_count) {
+			struct ref_array_item *last = prio_queue_peek(top);
+
+			if (compare_refs(&item, &last, ref_cbdata->sorting) > 0) {
+				free_array_item(item);
+				continue;
+			}
+			free_array_item(prio_queue_get(top));
+		}
+		prio_queue_put(top, item);
+	}
+	array->nr = 0;
+}
+
+static int has_ahead_behind_atoms(void)
+{
+	int i;
+
+	for (i = 0; i < used_atom_cnt; i++)
+		if (used_atom[i].atom_type == ATOM_AHEADBEHIND)
+			return 1;
+	return 0;
+}
+
+int filter_and_sort_refs(struct ref_array *array, struct ref_filter *filter,
+			 unsigned int type, struct ref_sorting *sorting,
+			 int max_count)
+{
+	struct ref_filter_cbdata ref_cbdata;
+	int i, ret;
+
+	memset(&ref_cbdata, 0, sizeof(ref_cbdata));
+	ref_cbdata.array = array;
+	ref_cbdata.filter = filter;
+
+	/*
+	 * Refs can only be dropped while iterating if no filter or
+	 * atom needs to look at all of them together.
+	 */
+	if (max_count > 0 &&
+	    !filter->reachable_from && !filter->unreachable_from &&
+	    !has_ahead_behind_atoms()) {
+		ref_cbdata.max_count = max_count;
+		ref_cbdata.sorting = sorting;
+		ref_cbdata.in_order = sorting_is_refname_order(sorting);
+		ref_cbdata.top.compare = compare_refs_reversed;
+		ref_cbdata.top.cb_data = sorting;
+	}
+
+	ret = do_filter_refs(&ref_cbdata, type);
+
+	if (ref_cbdata.max_count && !ref_cbdata.in_order) {
+		keep_top_refs(&ref_cbdata);
+		for (i = 0; i < ref_cbdata.top.nr; i++) {
+			ALLOC_GROW(array->items, array->nr + 1, array->alloc);
+			array->items[array->nr++] = ref_cbdata.top.array[i].data;
+		}
+		clear_prio_queue(&ref_cbdata.top);
+	}
+
+	filter_ahead_behind(the_repository, array);
+	ref_array_sort(sorting, array);
+
+	if (max_count > 0 && array->nr > max_count) {
+		for (i = max_count; i < array->nr; i++)
+			free_array_item(array->items[i]);
+		array->nr = max_count;
+	}
+	return ret;
+}
+
 static void append_literal(const char *cp, const char *ep, struct ref_formatting_state *state)
 {
 	struct strbuf *s = &state->stack->output;
@@ -24,6 +24,7 @@
 
 struct atom_value;
 struct ref_sorting;
+struct ahead_behind_count;
 
 enum ref_sorting_order {
 	REF_SORTING_REVERSE = 1<<0,
@@ -40,6 +41,7 @@ struct ref_array_item {
 	const char *symref;
 	struct commit *commit;
 	struct atom_value *value;
+	struct ahead_behind_count **counts;
 	char refname[FLEX_ARRAY];
 };
 
@@ -47,6 +49,9 @@ struct ref_array {
 	int nr, alloc;
 	struct ref_array_item **items;
 	struct rev_info *revs;
+
+	struct ahead_behind_count *counts;
+	size_t counts_nr;
 };
 
 struct ref_filter {
@@ -104,12 +109,38 @@ struct ref_format {
  * filtered refs in the ref_array structure.
  */
 int filter_refs(struct ref_array *array, struct ref_filter *filter, unsigned int type);
+/*
+ * Compute the values of any %(ahead-behind:<base>) atoms in the
+ * current format for every ref in the array, using a single walk
+ * for all of them. Must be called after verify_ref_format() and the
+ * sort options are parsed, and before the array is sorted or printed.
+ */
+void filter_ahead_behind(struct repository *r, struct ref_array *array);
 /*  Clear all memory allocated to ref_array */
 void ref_array_clear(struct ref_array *array);
 /*  Used to verify if the given format is correct and to parse out the used atoms */
 int verify_ref_format(struct ref_format *format);
 /*  Sort the given ref_array as per the ref_sorting provided */
 void ref_array_sort(struct ref_sorting *sort, struct ref_array *array);
+/*
+ * Like filter_refs(), filter_ahead_behind() and ref_array_sort()
+ * together, but keep only the first `max_count` refs in sort order, or
+ * all of them if `max_count` is 0. Unless a --merged or --no-merged
+ * filter or an %(ahead-behind) atom needs to see all matching refs,
+ * the others are dropped while iterating, so that memory use scales
+ * with `max_count`; when sorting by refname, the iteration stops
+ * after `max_count` refs.
+ */
+int filter_and_sort_refs(struct ref_array *array, struct ref_filter *filter,
+			 unsigned int type, struct ref_sorting *sorting,
+			 int max_count);
+/*
+ * Compute the values of the format's atoms for the first `nr` refs in
+ * the array, reading their objects in the order they are stored on
+ * disk. Optional; call it before formatting many refs with a format
+ * that looks at their objects.
+ */
+void ref_array_populate(struct ref_array *array, int nr);
 /*  Set REF_SORTING_* sort_flags for all elements of a sorting list */
 void ref_sorting_set_sort_flags_all(struct ref_sorting *sorting, unsigned int mask, int on);
 /*  Based on the given format and quote_style, fill the strbuf */
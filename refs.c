@@ -23,17 +23,35 @@
 /*
  * List of all available backends
  */
-static struct ref_storage_be *refs_backends = &refs_be_files;
+static struct ref_storage_be *refs_backends[] = {
+	[REF_STORAGE_FORMAT_FILES] = &refs_be_files,
+	[REF_STORAGE_FORMAT_REFTABLE] = &refs_be_reftable,
+};
 
-static struct ref_storage_be *find_ref_storage_backend(const char *name)
+static struct ref_storage_be *find_ref_storage_backend(enum ref_storage_format format)
 {
-	struct ref_storage_be *be;
-	for (be = refs_backends; be; be = be->next)
-		if (!strcmp(be->name, name))
-			return be;
+	if (format < ARRAY_SIZE(refs_backends))
+		return refs_backends[format];
 	return NULL;
 }
 
+enum ref_storage_format ref_storage_format_by_name(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(refs_backends); i++)
+		if (refs_backends[i] && !strcmp(refs_backends[i]->name, name))
+			return i;
+	return REF_STORAGE_FORMAT_UNKNOWN;
+}
+
+const char *ref_storage_format_to_name(enum ref_storage_format format)
+{
+	const struct ref_storage_be *be = find_ref_storage_backend(format);
+
+	return be ? be->name : "unknown";
+}
+
 /*
  * How to handle various characters in refnames:
  * 0: An acceptable character for refs
@@ -1863,12 +1881,12 @@ static struct ref_store *ref_store_init(struct repository *repo,
 					const char *gitdir,
 					unsigned int flags)
 {
-	const char *be_name = "files";
-	struct ref_storage_be *be = find_ref_storage_backend(be_name);
+	struct ref_storage_be *be;
 	struct ref_store *refs;
 
+	be = find_ref_storage_backend(repo->ref_storage_format);
 	if (!be)
-		BUG("reference backend %s is unknown", be_name);
+		BUG("reference backend is unknown");
 
 	refs = be->init(repo, gitdir, flags);
 	return refs;
@@ -2396,6 +2414,37 @@ int refs_reflog_expire(struct ref_store *refs,
 				       cleanup_fn, policy_cb_data);
 }
 
+int stat_generation_token(struct strbuf *token, const char *path)
+{
+	struct stat st;
+
+	if (lstat(path, &st) < 0) {
+		if (errno != ENOENT)
+			return -1;
+		strbuf_addf(token, "%s missing\n", path);
+		return 0;
+	}
+
+	/*
+	 * Timestamps may come from a clock that is coarser than the
+	 * one we read, so give it a second of slack.
+	 */
+	if (st.st_mtime + 1 >= time(NULL))
+		return -1;
+
+	strbuf_addf(token, "%s %"PRIuMAX" %"PRIuMAX" %"PRIuMAX".%09u\n",
+		    path, (uintmax_t)st.st_ino, (uintmax_t)st.st_size,
+		    (uintmax_t)st.st_mtime, ST_MTIME_NSEC(st));
+	return 0;
+}
+
+int refs_generation_token(struct ref_store *refs, struct strbuf *token)
+{
+	if (!refs->be->generation_token)
+		return -1;
+	return refs->be->generation_token(refs, token);
+}
+
 int reflog_expire(const char *refname,
 		  unsigned int flags,
 		  reflog_expiry_prepare_fn prepare_fn,
@@ -116,6 +116,14 @@ int is_branch(const char *refname);
 
 int refs_init_db(struct strbuf *err);
 
+/*
+ * Look up a reference storage format by its name ("files", "reftable")
+ * and the other way round. An unknown name gives
+ * REF_STORAGE_FORMAT_UNKNOWN.
+ */
+enum ref_storage_format ref_storage_format_by_name(const char *name);
+const char *ref_storage_format_to_name(enum ref_storage_format format);
+
 /*
  * Return the peeled value of the oid currently being iterated via
  * for_each_ref(), etc. This is equivalent to calling:
@@ -870,6 +878,17 @@ int reflog_expire(const char *refname,
 		  reflog_expiry_cleanup_fn cleanup_fn,
 		  void *policy_cb_data);
 
+/*
+ * Append to `token` a string that is guaranteed to change whenever a
+ * reference in `refs` changes (it may also change when none did), and
+ * return 0. Callers can use it to tell whether something they derived
+ * from the references is still up to date. Return -1 if the ref store
+ * cannot provide such a string, for example because the references
+ * were updated too recently for a further update to be guaranteed to
+ * change it.
+ */
+int refs_generation_token(struct ref_store *refs, struct strbuf *token);
+
 struct ref_store *get_main_ref_store(struct repository *r);
 
 /**
@@ -417,6 +417,15 @@ static int debug_reflog_expire(struct ref_store *ref_store, const char *refname,
 	return res;
 }
 
+static int debug_generation_token(struct ref_store *ref_store,
+				  struct strbuf *token)
+{
+	struct debug_ref_store *drefs = (struct debug_ref_store *)ref_store;
+	int res = refs_generation_token(drefs->refs, token);
+	trace_printf_key(&trace_refs, "generation_token: %d\n", res);
+	return res;
+}
+
 struct ref_storage_be refs_be_debug = {
 	NULL,
 	"debug",
@@ -443,4 +452,6 @@ struct ref_storage_be refs_be_debug = {
 	debug_create_reflog,
 	debug_delete_reflog,
 	debug_reflog_expire,
+
+	debug_generation_token,
 };
@@ -10,6 +10,7 @@
 #include "../object.h"
 #include "../dir.h"
 #include "../chdir-notify.h"
+#include "../strmap.h"
 #include "worktree.h"
 
 /*
@@ -49,6 +50,13 @@
  */
 #define REF_DELETED_RMDIR (1 << 9)
 
+/*
+ * Used as a flag in ref_update::flags when the new value of the
+ * reference is to be written to the packed-refs file instead of to
+ * the loose reference.
+ */
+#define REF_WRITE_PACKED (1 << 12)
+
 struct ref_lock {
 	char *ref_name;
 	struct lock_file lk;
@@ -63,9 +71,28 @@ struct files_ref_store {
 
 	struct ref_cache *loose;
 
+	/*
+	 * The values of loose references read by files_read_raw_ref(),
+	 * keyed by refname and mapping to a struct loose_ref_value.
+	 */
+	struct strmap loose_values;
+
 	struct ref_store *packed_ref_store;
 };
 
+/*
+ * The value of a loose reference together with the stat data of the
+ * file it was read from, so that reading the reference again can be
+ * answered with a single lstat(2) for as long as the file stays the
+ * same.
+ */
+struct loose_ref_value {
+	struct stat_data sd;
+	unsigned int type;
+	struct object_id oid;
+	char *referent;
+};
+
 static void clear_loose_ref_cache(struct files_ref_store *refs)
 {
 	if (refs->loose) {
@@ -88,6 +115,7 @@ static struct ref_store *files_ref_store_create(struct repository *repo,
 
 	base_ref_store_init(ref_store, repo, gitdir, &refs_be_files);
 	refs->store_flags = flags;
+	strmap_init(&refs->loose_values);
 	get_common_dir_noenv(&sb, gitdir);
 	refs->gitcommondir = strbuf_detach(&sb, NULL);
 	refs->packed_ref_store =
@@ -338,6 +366,70 @@ static struct ref_cache *get_loose_ref_cache(struct files_ref_store *refs)
 	return refs->loose;
 }
 
+/*
+ * Look up the value of refname remembered from an earlier read of its
+ * loose file, whose lstat(2) data is st. Return 0 and fill in oid,
+ * referent and type if the file has not changed since, -1 otherwise.
+ */
+static int read_remembered_ref(struct files_ref_store *refs,
+			       const char *refname, struct stat *st,
+			       struct object_id *oid, struct strbuf *referent,
+			       unsigned int *type)
+{
+	struct loose_ref_value *value = strmap_get(&refs->loose_values, refname);
+
+	if (!value)
+		return -1;
+	if (!S_ISREG(st->st_mode) || match_stat_data(&value->sd, st)) {
+		free(value->referent);
+		free(value);
+		strmap_remove(&refs->loose_values, refname, 0);
+		return -1;
+	}
+
+	*type |= value->type;
+	if (value->referent) {
+		strbuf_reset(referent);
+		strbuf_addstr(referent, value->referent);
+	} else {
+		oidcpy(oid, &value->oid);
+	}
+	return 0;
+}
+
+/*
+ * Remember the value of refname just read from its loose file, whose
+ * lstat(2) data is st.
+ *
+ * The file could still be rewritten within the same second without
+ * its stat data changing, so only remember values of files that had
+ * not been touched for a while when we read them; any later write
+ * necessarily gives them a newer mtime.
+ */
+static void remember_ref(struct files_ref_store *refs, const char *refname,
+			 struct stat *st, const struct object_id *oid,
+			 const struct strbuf *referent, unsigned int type)
+{
+	struct loose_ref_value *value;
+
+	if (!S_ISREG(st->st_mode) || st->st_mtime + 1 >= time(NULL))
+		return;
+
+	value = xcalloc(1, sizeof(*value));
+	fill_stat_data(&value->sd, st);
+	value->type = type;
+	if (type & REF_ISSYMREF)
+		value->referent = xstrdup(referent->buf);
+	else
+		oidcpy(&value->oid, oid);
+
+	value = strmap_put(&refs->loose_values, refname, value);
+	if (value) {
+		free(value->referent);
+		free(value);
+	}
+}
+
 static int files_read_raw_ref(struct ref_store *ref_store, const char *refname,
 			      struct object_id *oid, struct strbuf *referent,
 			      unsigned int *type, int *failure_errno)
@@ -392,6 +484,11 @@ static int files_read_raw_ref(struct ref_store *ref_store, const char *refname,
 		goto out;
 	}
 
+	if (!read_remembered_ref(refs, refname, &st, oid, referent, type)) {
+		ret = 0;
+		goto out;
+	}
+
 	/* Follow "normalized" - ie "refs/.." symlinks by hand */
 	if (S_ISLNK(st.st_mode)) {
 		strbuf_reset(&sb_contents);
@@ -458,6 +555,8 @@ static int files_read_raw_ref(struct ref_store *ref_store, const char *refname,
 	buf = sb_contents.buf;
 
 	ret = parse_loose_ref_contents(buf, oid, referent, type, &myerr);
+	if (!ret)
+		remember_ref(refs, refname, &st, oid, referent, *type);
 
 out:
 	if (ret && !myerr)
@@ -1232,6 +1331,9 @@ static int files_pack_refs(struct ref_store *ref_store, unsigned int flags)
 
 	ref_transaction_free(transaction);
 
+	if (packed_refs_compact(refs->packed_ref_store, &err))
+		die("unable to write new packed-refs: %s", err.buf);
+
 	packed_refs_unlock(refs->packed_ref_store);
 
 	prune_refs(refs, &refs_to_prune);
@@ -1753,6 +1855,32 @@ static int files_log_ref_write(struct files_ref_store *refs,
 	return 0;
 }
 
+/*
+ * Check that `oid` names an object that may be stored in the reference
+ * `refname`. On error, write an error message to `err` and return -1.
+ */
+static int verify_ref_value(const char *refname, const struct object_id *oid,
+			    struct strbuf *err)
+{
+	struct object *o = parse_object(the_repository, oid);
+
+	if (!o) {
+		strbuf_addf(
+			err,
+			"trying to write ref '%s' with nonexistent object %s",
+			refname, oid_to_hex(oid));
+		return -1;
+	}
+	if (o->type != OBJ_COMMIT && is_branch(refname)) {
+		strbuf_addf(
+			err,
+			"trying to write non-commit object %s to branch '%s'",
+			oid_to_hex(oid), refname);
+		return -1;
+	}
+	return 0;
+}
+
 /*
  * Write oid into the open lockfile, then close the lockfile. On
  * errors, rollback the lockfile, fill in *err and return -1.
@@ -1762,31 +1890,17 @@ static int write_ref_to_lockfile(struct ref_lock *lock,
 				 int skip_oid_verification, struct strbuf *err)
 {
 	static char term = '\n';
-	struct object *o;
 	int fd;
 
-	if (!skip_oid_verification) {
-		o = parse_object(the_repository, oid);
-		if (!o) {
-			strbuf_addf(
-				err,
-				"trying to write ref '%s' with nonexistent object %s",
-				lock->ref_name, oid_to_hex(oid));
-			unlock_ref(lock);
-			return -1;
-		}
-		if (o->type != OBJ_COMMIT && is_branch(lock->ref_name)) {
-			strbuf_addf(
-				err,
-				"trying to write non-commit object %s to branch '%s'",
-				oid_to_hex(oid), lock->ref_name);
-			unlock_ref(lock);
-			return -1;
-		}
+	if (!skip_oid_verification &&
+	    verify_ref_value(lock->ref_name, oid, err)) {
+		unlock_ref(lock);
+		return -1;
 	}
 	fd = get_lock_file_fd(&lock->lk);
 	if (write_in_full(fd, oid_to_hex(oid), the_hash_algo->hexsz) < 0 ||
 	    write_in_full(fd, &term, 1) < 0 ||
+	    fsync_component(FSYNC_COMPONENT_REFERENCE, fd) < 0 ||
 	    close_ref_gently(lock) < 0) {
 		strbuf_addf(err,
 			    "couldn't write '%s'", get_lock_file_path(&lock->lk));
@@ -2467,12 +2581,17 @@ static int check_old_oid(struct ref_update *update, struct object_id *oid,
  *   the referent to transaction.
  * - If it is an update of head_ref, add a corresponding REF_LOG_ONLY
  *   update of HEAD.
+ * - Write the new value to the lockfile or, if `write_packed` is set
+ *   and it is an ordinary reference, only verify it and mark the
+ *   update with REF_WRITE_PACKED for the caller to write the value
+ *   to the packed-refs file.
  */
 static int lock_ref_for_update(struct files_ref_store *refs,
 			       struct ref_update *update,
 			       struct ref_transaction *transaction,
 			       const char *head_ref,
 			       struct string_list *affected_refnames,
+			       int write_packed,
 			       struct strbuf *err)
 {
 	struct strbuf referent = STRBUF_INIT;
@@ -2574,6 +2693,22 @@ static int lock_ref_for_update(struct files_ref_store *refs,
 			 * The reference already has the desired
 			 * value, so we don't need to write it.
 			 */
+		} else if (write_packed &&
+			   !(update->type & REF_ISSYMREF) &&
+			   ref_type(update->refname) == REF_TYPE_NORMAL) {
+			if (!(update->flags & REF_SKIP_OID_VERIFICATION) &&
+			    verify_ref_value(update->refname,
+					     &update->new_oid, err)) {
+				char *write_err = strbuf_detach(err, NULL);
+
+				strbuf_addf(err,
+					    "cannot update ref '%s': %s",
+					    update->refname, write_err);
+				free(write_err);
+				ret = TRANSACTION_GENERIC_ERROR;
+				goto out;
+			}
+			update->flags |= REF_WRITE_PACKED;
 		} else if (write_ref_to_lockfile(
 				   lock, &update->new_oid,
 				   update->flags & REF_SKIP_OID_VERIFICATION,
@@ -2657,6 +2792,52 @@ static void files_transaction_cleanup(struct files_ref_store *refs,
 	transaction->state = REF_TRANSACTION_CLOSED;
 }
 
+#define PACKED_UPDATES_RATIO 16
+
+/*
+ * Should the new values of the references updated by `transaction` be
+ * written to the packed-refs file rather than as loose references?
+ * Writing a loose reference costs several file operations, which adds
+ * up for transactions that update many references, whereas rewriting
+ * the packed-refs file costs time proportional to its size however few
+ * references change. So only do the latter if the transaction updates
+ * at least `core.packedRefsUpdateThreshold` references, and the
+ * packed-refs file is not much larger than what they add to it, unless
+ * the changes can be recorded in packed-refs.delta instead.
+ */
+static int want_packed_updates(struct files_ref_store *refs,
+			       struct ref_transaction *transaction)
+{
+	static int threshold_configured;
+	static int threshold = 1000;
+	struct strbuf path = STRBUF_INIT;
+	struct stat st;
+	size_t size = 0;
+	size_t i;
+
+	if (!threshold_configured) {
+		git_config_get_int("core.packedrefsupdatethreshold",
+				   &threshold);
+		threshold_configured = 1;
+	}
+
+	if (threshold <= 0 || transaction->nr < threshold)
+		return 0;
+	if (refs->base.repo->packed_refs_delta)
+		return 1;
+
+	for (i = 0; i < transaction->nr; i++)
+		size += the_hash_algo->hexsz + 2 +
+			strlen(transaction->updates[i]->refname);
+
+	strbuf_addf(&path, "%s/packed-refs", refs->gitcommondir);
+	if (stat(path.buf, &st))
+		st.st_size = 0;
+	strbuf_release(&path);
+
+	return xsize_t(st.st_size) / PACKED_UPDATES_RATIO <= size;
+}
+
 static int files_transaction_prepare(struct ref_store *ref_store,
 				     struct ref_transaction *transaction,
 				     struct strbuf *err)
@@ -2671,12 +2852,15 @@ static int files_transaction_prepare(struct ref_store *ref_store,
 	int head_type;
 	struct files_transaction_backend_data *backend_data;
 	struct ref_transaction *packed_transaction = NULL;
+	int write_packed;
 
 	assert(err);
 
 	if (!transaction->nr)
 		goto cleanup;
 
+	write_packed = want_packed_updates(refs, transaction);
+
 	CALLOC_ARRAY(backend_data, 1);
 	transaction->backend_data = backend_data;
 
@@ -2743,21 +2927,29 @@ static int files_transaction_prepare(struct ref_store *ref_store,
 	 * open at a time to avoid running out of file descriptors.
 	 * Note that lock_ref_for_update() might append more updates
 	 * to the transaction.
+	 *
+	 * In a large transaction, new values are written to the
+	 * packed-refs file instead of to the lockfiles. The loose
+	 * references are still locked, so that concurrent updates
+	 * are serialized with ours as usual.
 	 */
 	for (i = 0; i < transaction->nr; i++) {
 		struct ref_update *update = transaction->updates[i];
 
 		ret = lock_ref_for_update(refs, update, transaction,
-					  head_ref, &affected_refnames, err);
+					  head_ref, &affected_refnames,
+					  write_packed, err);
 		if (ret)
 			goto cleanup;
 
-		if (update->flags & REF_DELETING &&
-		    !(update->flags & REF_LOG_ONLY) &&
-		    !(update->flags & REF_IS_PRUNING)) {
+		if ((update->flags & REF_DELETING &&
+		     !(update->flags & REF_LOG_ONLY) &&
+		     !(update->flags & REF_IS_PRUNING)) ||
+		    update->flags & REF_WRITE_PACKED) {
 			/*
 			 * This reference has to be deleted from
-			 * packed-refs if it exists there.
+			 * packed-refs if it exists there, or its new
+			 * value has to be written there.
 			 */
 			if (!packed_transaction) {
 				packed_transaction = ref_store_transaction_begin(
@@ -2860,6 +3052,7 @@ static int files_transaction_finish(struct ref_store *ref_store,
 		struct ref_lock *lock = update->backend_data;
 
 		if (update->flags & REF_NEEDS_COMMIT ||
+		    update->flags & REF_WRITE_PACKED ||
 		    update->flags & REF_LOG_ONLY) {
 			if (files_log_ref_write(refs,
 						lock->ref_name,
@@ -2914,7 +3107,8 @@ static int files_transaction_finish(struct ref_store *ref_store,
 	/*
 	 * Perform deletes now that updates are safely completed.
 	 *
-	 * First delete any packed versions of the references, while
+	 * First delete any packed versions of the references, and
+	 * write the new values that go to packed-refs, while
 	 * retaining the packed-refs lock:
 	 */
 	if (packed_transaction) {
@@ -2926,13 +3120,32 @@ static int files_transaction_finish(struct ref_store *ref_store,
 			goto cleanup;
 	}
 
-	/* Now delete the loose versions of the references: */
+	/*
+	 * Now delete the loose versions of the references, including
+	 * those that would hide new values written to packed-refs:
+	 */
 	for (i = 0; i < transaction->nr; i++) {
 		struct ref_update *update = transaction->updates[i];
 		struct ref_lock *lock = update->backend_data;
 
-		if (update->flags & REF_DELETING &&
-		    !(update->flags & REF_LOG_ONLY)) {
+		if (update->flags & REF_WRITE_PACKED) {
+			/*
+			 * Its lockfile may have been the only
+			 * entry in its parent directories:
+			 */
+			update->flags |= REF_DELETED_RMDIR;
+			if (!(update->type & REF_ISPACKED) &&
+			    !is_null_oid(&lock->old_oid)) {
+				/* It is a loose reference. */
+				strbuf_reset(&sb);
+				files_ref_path(refs, &sb, lock->ref_name);
+				if (unlink_or_msg(sb.buf, err)) {
+					ret = TRANSACTION_GENERIC_ERROR;
+					goto cleanup;
+				}
+			}
+		} else if (update->flags & REF_DELETING &&
+			   !(update->flags & REF_LOG_ONLY)) {
 			update->flags |= REF_DELETED_RMDIR;
 			if (!(update->type & REF_ISPACKED) ||
 			    update->type & REF_ISSYMREF) {
@@ -3268,6 +3481,71 @@ static int files_init_db(struct ref_store *ref_store, struct strbuf *err)
 	return 0;
 }
 
+/*
+ * Append the stat data of the directory `path` and of all directories
+ * below it to `token`. Loose references are only ever created, replaced
+ * or deleted by renaming or unlinking files, which changes the directory
+ * containing them.
+ */
+static int loose_generation_token(struct strbuf *token, struct strbuf *path)
+{
+	size_t len = path->len;
+	struct dirent *de;
+	DIR *d;
+	int ret;
+
+	ret = stat_generation_token(token, path->buf);
+	if (ret)
+		return ret;
+
+	d = opendir(path->buf);
+	if (!d)
+		return 0;
+
+	while (!ret && (de = readdir(d)) != NULL) {
+		struct stat st;
+
+		if (is_dot_or_dotdot(de->d_name) ||
+		    (DTYPE(de) != DT_DIR && DTYPE(de) != DT_UNKNOWN))
+			continue;
+		strbuf_addch(path, '/');
+		strbuf_addstr(path, de->d_name);
+		if (DTYPE(de) == DT_DIR ||
+		    (!lstat(path->buf, &st) && S_ISDIR(st.st_mode)))
+			ret = loose_generation_token(token, path);
+		strbuf_setlen(path, len);
+	}
+	closedir(d);
+	return ret;
+}
+
+static int files_generation_token(struct ref_store *ref_store,
+				  struct strbuf *token)
+{
+	struct files_ref_store *refs =
+		files_downcast(ref_store, REF_STORE_READ, "generation_token");
+	struct strbuf path = STRBUF_INIT;
+	int ret;
+
+	/* HEAD and the pseudorefs live in $GIT_DIR itself. */
+	ret = stat_generation_token(token, refs->base.gitdir);
+
+	if (!ret) {
+		strbuf_addf(&path, "%s/refs", refs->base.gitdir);
+		ret = loose_generation_token(token, &path);
+	}
+	if (!ret && strcmp(refs->base.gitdir, refs->gitcommondir)) {
+		strbuf_reset(&path);
+		strbuf_addf(&path, "%s/refs", refs->gitcommondir);
+		ret = loose_generation_token(token, &path);
+	}
+	if (!ret)
+		ret = refs_generation_token(refs->packed_ref_store, token);
+
+	strbuf_release(&path);
+	return ret;
+}
+
 struct ref_storage_be refs_be_files = {
 	NULL,
 	"files",
@@ -3293,5 +3571,7 @@ struct ref_storage_be refs_be_files = {
 	files_reflog_exists,
 	files_create_reflog,
 	files_delete_reflog,
-	files_reflog_expire
+	files_reflog_expire,
+
+	files_generation_token
 };
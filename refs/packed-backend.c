@@ -6,6 +6,7 @@
 #include "../iterator.h"
 #include "../lockfile.h"
 #include "../chdir-notify.h"
+#include "../dir.h"
 
 enum mmap_strategy {
 	/*
@@ -43,9 +44,9 @@ struct packed_ref_store;
  *
  * Normally, this will be a mmapped view of the contents of the
  * `packed-refs` file at the time the snapshot was created. However,
- * if the `packed-refs` file was not sorted, this might point at heap
- * memory holding the contents of the `packed-refs` file with its
- * records sorted by refname.
+ * if the `packed-refs` file was not sorted and has been iterated over
+ * as a whole, this might point at heap memory holding the contents of
+ * the `packed-refs` file with its records sorted by refname.
  *
  * `snapshot` instances are reference counted (via
  * `acquire_snapshot()` and `release_snapshot()`). This is to prevent
@@ -78,13 +79,57 @@ struct snapshot {
 	 *   contents
 	 *
 	 * If the `packed-refs` file was already sorted, `buf` points
-	 * at the mmapped contents of the file. If not, it points at
-	 * heap-allocated memory containing the contents, sorted. If
-	 * there were no contents (e.g., because the file didn't
-	 * exist), `buf`, `start`, and `eof` are all NULL.
+	 * at the mmapped contents of the file. If not, it points there
+	 * until `sort_snapshot()` is called, and then at heap-allocated
+	 * memory containing the contents, sorted. If there were no
+	 * contents (e.g., because the file didn't exist), `buf`,
+	 * `start`, and `eof` are all NULL.
 	 */
 	char *buf, *start, *eof;
 
+	/*
+	 * Are the records known to be sorted by refname? Sorting a
+	 * large file that lacks the `sorted` trait costs far more than
+	 * looking at each of its records once, so it is put off until
+	 * the whole file is iterated over, or until enough references
+	 * have been looked up by scanning for them; see
+	 * `UNSORTED_LOOKUP_LIMIT`.
+	 */
+	int sorted;
+
+	/* The number of references looked up by scanning `buf`. */
+	unsigned int unsorted_lookups;
+
+	/* Is this a snapshot of the `packed-refs.delta` file? */
+	int is_delta;
+
+	/*
+	 * For a snapshot of the delta file, its generation. For one of
+	 * the `packed-refs` file, the generation of the newest delta
+	 * file whose changes it already includes. Each delta file gets
+	 * a larger generation than the last one folded into
+	 * `packed-refs`, so that a delta file left over from before
+	 * `packed-refs` was rewritten is not applied to it again. Both
+	 * are recorded as traits in the file header, and 0 if absent.
+	 */
+	uintmax_t generation;
+
+	/*
+	 * For a snapshot of the delta file, the length of the part of
+	 * the file that holds complete changes, and that the next ones
+	 * are appended to; 0 if there is no delta file to append to.
+	 */
+	size_t delta_len;
+
+	/*
+	 * For a snapshot of the `packed-refs` file of a store that
+	 * keeps a delta file, the snapshot of the delta file taken
+	 * along with it, which may be empty. Its records take
+	 * precedence over ours; a record with the null object ID
+	 * means that the reference has been deleted.
+	 */
+	struct snapshot *delta;
+
 	/*
 	 * What is the peeled state of the `packed-refs` file that
 	 * this snapshot represents? (This is usually determined from
@@ -131,6 +176,13 @@ struct packed_ref_store {
 	/* The path of the "packed-refs" file: */
 	char *path;
 
+	/*
+	 * The path of the "packed-refs.delta" file, if the repository
+	 * records changes to packed references there rather than
+	 * rewriting "packed-refs" every time; otherwise, NULL.
+	 */
+	char *delta_path;
+
 	/*
 	 * A snapshot of the values read from the `packed-refs` file,
 	 * if it might still be current; otherwise, NULL.
@@ -159,6 +211,13 @@ static void acquire_snapshot(struct snapshot *snapshot)
 	snapshot->referrers++;
 }
 
+/* Return the path of the file that `snapshot` was taken of. */
+static const char *snapshot_path(struct snapshot *snapshot)
+{
+	return snapshot->is_delta ?
+		snapshot->refs->delta_path : snapshot->refs->path;
+}
+
 /*
  * If the buffer in `snapshot` is active, then either munmap the
  * memory and close the file, or free the memory. Then set the buffer
@@ -169,7 +228,7 @@ static void clear_snapshot_buffer(struct snapshot *snapshot)
 	if (snapshot->mmapped) {
 		if (munmap(snapshot->buf, snapshot->eof - snapshot->buf))
 			die_errno("error ummapping packed-refs file %s",
-				  snapshot->refs->path);
+				  snapshot_path(snapshot));
 		snapshot->mmapped = 0;
 	} else {
 		free(snapshot->buf);
@@ -184,6 +243,8 @@ static void clear_snapshot_buffer(struct snapshot *snapshot)
 static int release_snapshot(struct snapshot *snapshot)
 {
 	if (!--snapshot->referrers) {
+		if (snapshot->delta)
+			release_snapshot(snapshot->delta);
 		stat_validity_clear(&snapshot->validity);
 		clear_snapshot_buffer(snapshot);
 		free(snapshot);
@@ -207,6 +268,10 @@ struct ref_store *packed_ref_store_create(struct repository *repo,
 	strbuf_addf(&sb, "%s/packed-refs", gitdir);
 	refs->path = strbuf_detach(&sb, NULL);
 	chdir_notify_reparent("packed-refs", &refs->path);
+	if (repo->packed_refs_delta) {
+		refs->delta_path = xstrfmt("%s.delta", refs->path);
+		chdir_notify_reparent("packed-refs.delta", &refs->delta_path);
+	}
 	return ref_store;
 }
 
@@ -273,6 +338,14 @@ struct snapshot_record {
 	size_t len;
 };
 
+/*
+ * The `packed-refs.delta` file is a log: every transaction appends
+ * the records of the references it changes, followed by this line,
+ * and the last record for a reference wins. Anything after the last
+ * such line was not completely written, and is ignored.
+ */
+static const char DELTA_SEGMENT_END[] = "# end\n";
+
 static int cmp_packed_ref_records(const void *v1, const void *v2)
 {
 	const struct snapshot_record *e1 = v1, *e2 = v2;
@@ -315,73 +388,76 @@ static int cmp_record_to_refname(const char *rec, const char *refname)
 }
 
 /*
- * `snapshot->buf` is not known to be sorted. Check whether it is, and
- * if not, sort it into new memory and munmap/free the old storage.
+ * Return a pointer to the start of the record following the one at
+ * `pos`, skipping its peeled line, if any. Die if the record is too
+ * short to hold an object name and a refname.
  */
-static void sort_snapshot(struct snapshot *snapshot)
+static const char *skip_record(struct snapshot *snapshot, const char *pos)
 {
-	struct snapshot_record *records = NULL;
-	size_t alloc = 0, nr = 0;
-	int sorted = 1;
-	const char *pos, *eof, *eol;
-	size_t len, i;
-	char *new_buffer, *dst;
-
-	pos = snapshot->start;
-	eof = snapshot->eof;
-
-	if (pos == eof)
-		return;
-
-	len = eof - pos;
+	const char *eof = snapshot->eof;
+	const char *eol = memchr(pos, '\n', eof - pos);
 
-	/*
-	 * Initialize records based on a crude estimate of the number
-	 * of references in the file (we'll grow it below if needed):
-	 */
-	ALLOC_GROW(records, len / 80 + 20, alloc);
+	if (!eol)
+		/* The safety check should prevent this. */
+		BUG("unterminated line found in packed-refs");
+	if (eol - pos < the_hash_algo->hexsz + 2)
+		die_invalid_line(snapshot_path(snapshot), pos, eof - pos);
+	eol++;
+	if (eol < eof && *eol == '^') {
+		/*
+		 * Keep any peeled line together with its
+		 * reference:
+		 */
+		const char *peeled_start = eol;
 
-	while (pos < eof) {
-		eol = memchr(pos, '\n', eof - pos);
+		eol = memchr(peeled_start, '\n', eof - peeled_start);
 		if (!eol)
 			/* The safety check should prevent this. */
-			BUG("unterminated line found in packed-refs");
-		if (eol - pos < the_hash_algo->hexsz + 2)
-			die_invalid_line(snapshot->refs->path,
-					 pos, eof - pos);
+			BUG("unterminated peeled line found in packed-refs");
 		eol++;
-		if (eol < eof && *eol == '^') {
-			/*
-			 * Keep any peeled line together with its
-			 * reference:
-			 */
-			const char *peeled_start = eol;
-
-			eol = memchr(peeled_start, '\n', eof - peeled_start);
-			if (!eol)
-				/* The safety check should prevent this. */
-				BUG("unterminated peeled line found in packed-refs");
-			eol++;
-		}
+	}
+	return eol;
+}
 
-		ALLOC_GROW(records, nr + 1, alloc);
-		records[nr].start = pos;
-		records[nr].len = eol - pos;
-		nr++;
+/*
+ * Copy the records of `snapshot` whose refname starts with `prefix`
+ * into newly-allocated memory, sorted by refname. Return the memory
+ * and store its length in `*len`. As every record is checked on the
+ * way, the new memory is as safe to search as a buffer that passed
+ * `verify_buffer_safe()`.
+ */
+static char *sort_records(struct snapshot *snapshot, const char *prefix,
+			  size_t *len)
+{
+	struct snapshot_record *records = NULL;
+	size_t alloc = 0, nr = 0, prefix_len = strlen(prefix);
+	const char *pos = snapshot->start, *eof = snapshot->eof;
+	char *new_buffer, *dst;
+	size_t i;
 
-		if (sorted &&
-		    nr > 1 &&
-		    cmp_packed_ref_records(&records[nr - 2],
-					   &records[nr - 1]) >= 0)
-			sorted = 0;
+	*len = 0;
+	if (!prefix_len)
+		/*
+		 * Initialize records based on a crude estimate of the
+		 * number of references in the file (we'll grow it below
+		 * if needed):
+		 */
+		ALLOC_GROW(records, (eof - pos) / 80 + 20, alloc);
 
-		pos = eol;
+	while (pos < eof) {
+		const char *next = skip_record(snapshot, pos);
+
+		if (!strncmp(pos + the_hash_algo->hexsz + 1, prefix,
+			     prefix_len)) {
+			ALLOC_GROW(records, nr + 1, alloc);
+			records[nr].start = pos;
+			records[nr].len = next - pos;
+			*len += next - pos;
+			nr++;
+		}
+		pos = next;
 	}
 
-	if (sorted)
-		goto cleanup;
-
-	/* We need to sort the memory. First we sort the records array: */
 	QSORT(records, nr, cmp_packed_ref_records);
 
 	/*
@@ -389,11 +465,122 @@ static void sort_snapshot(struct snapshot *snapshot)
 	 * the new in the order indicated by `records` (not bothering
 	 * with the header line):
 	 */
-	new_buffer = xmalloc(len);
+	new_buffer = xmalloc(*len);
+	for (dst = new_buffer, i = 0; i < nr; i++) {
+		memcpy(dst, records[i].start, records[i].len);
+		dst += records[i].len;
+	}
+
+	free(records);
+	return new_buffer;
+}
+
+static int cmp_delta_records(const void *v1, const void *v2)
+{
+	const struct snapshot_record *e1 = v1, *e2 = v2;
+	int cmp = cmp_packed_ref_records(v1, v2);
+
+	/* Keep the records for the same reference in log order: */
+	if (!cmp)
+		cmp = e1->start < e2->start ? -1 : +1;
+	return cmp;
+}
+
+/*
+ * Replace the contents of `snapshot`, which holds the log of changes
+ * from the delta file after its header, with the last record for each
+ * reference from its complete segments, sorted by refname. Set
+ * `snapshot->delta_len` accordingly.
+ */
+static void read_delta_records(struct snapshot *snapshot)
+{
+	struct snapshot_record *records = NULL;
+	size_t alloc = 0, nr = 0, complete_nr = 0, len = 0, i;
+	const char *pos = snapshot->start, *eof = snapshot->eof;
+	const char *complete = snapshot->start;
+	size_t end_len = strlen(DELTA_SEGMENT_END);
+	char *new_buffer, *dst;
+
+	while (pos < eof) {
+		const char *eol = memchr(pos, '\n', eof - pos);
+
+		if (!eol)
+			break;
+		eol++;
+		if ((size_t)(eol - pos) == end_len &&
+		    !memcmp(pos, DELTA_SEGMENT_END, end_len)) {
+			complete = eol;
+			complete_nr = nr;
+		} else if (*pos == '^') {
+			/* Keep the peeled line together with its record: */
+			if (!nr || records[nr - 1].start + records[nr - 1].len != pos)
+				die_invalid_line(snapshot_path(snapshot),
+						 pos, eof - pos);
+			records[nr - 1].len += eol - pos;
+		} else {
+			if (eol - pos < the_hash_algo->hexsz + 2)
+				die_invalid_line(snapshot_path(snapshot),
+						 pos, eof - pos);
+			ALLOC_GROW(records, nr + 1, alloc);
+			records[nr].start = pos;
+			records[nr].len = eol - pos;
+			nr++;
+		}
+		pos = eol;
+	}
+	nr = complete_nr;
+	snapshot->delta_len = complete - snapshot->buf;
+
+	QSORT(records, nr, cmp_delta_records);
+	for (i = 0; i < nr; i++)
+		if (i + 1 == nr ||
+		    cmp_packed_ref_records(&records[i], &records[i + 1]))
+			len += records[i].len;
+
+	new_buffer = xmalloc(len + 1);
 	for (dst = new_buffer, i = 0; i < nr; i++) {
+		if (i + 1 < nr &&
+		    !cmp_packed_ref_records(&records[i], &records[i + 1]))
+			continue;
 		memcpy(dst, records[i].start, records[i].len);
 		dst += records[i].len;
 	}
+	free(records);
+
+	clear_snapshot_buffer(snapshot);
+	snapshot->buf = snapshot->start = new_buffer;
+	snapshot->eof = new_buffer + len;
+	snapshot->sorted = 1;
+}
+
+/*
+ * `snapshot->buf` is not known to be sorted. Check whether it is, and
+ * if not, sort it into new memory and munmap/free the old storage.
+ */
+static void sort_snapshot(struct snapshot *snapshot)
+{
+	struct snapshot_record prev = { NULL }, cur;
+	const char *pos = snapshot->start, *eof = snapshot->eof;
+	char *new_buffer;
+	size_t len;
+
+	if (snapshot->sorted)
+		return;
+
+	while (pos < eof) {
+		const char *next = skip_record(snapshot, pos);
+
+		cur.start = pos;
+		if (prev.start && cmp_packed_ref_records(&prev, &cur) >= 0)
+			break;
+		prev = cur;
+		pos = next;
+	}
+	snapshot->sorted = 1;
+	if (pos == eof)
+		return;
+
+	new_buffer = sort_records(snapshot, "", &len);
 
 	/*
 	 * Now munmap the old buffer and use the sorted buffer in its
@@ -402,9 +589,24 @@ static void sort_snapshot(struct snapshot *snapshot)
 	clear_snapshot_buffer(snapshot);
 	snapshot->buf = snapshot->start = new_buffer;
 	snapshot->eof = new_buffer + len;
+}
 
-cleanup:
-	free(records);
+/*
+ * Look for the record for `refname` in `snapshot`, whose records are
+ * not known to be sorted, by comparing it to every record. Return the
+ * start of the record, or NULL if there is none.
+ */
+static const char *scan_for_reference(struct snapshot *snapshot,
+				      const char *refname)
+{
+	const char *pos = snapshot->start, *eof = snapshot->eof;
+
+	while (pos < eof) {
+		if (!cmp_record_to_refname(pos, refname))
+			return pos;
+		pos = skip_record(snapshot, pos);
+	}
+	return NULL;
 }
 
 /*
@@ -459,7 +661,7 @@ static void verify_buffer_safe(struct snapshot *snapshot)
 
 	last_line = find_start_of_record(start, eof - 1);
 	if (*(eof - 1) != '\n' || eof - last_line < the_hash_algo->hexsz + 2)
-		die_invalid_line(snapshot->refs->path,
+		die_invalid_line(snapshot_path(snapshot),
 				 last_line, eof - last_line);
 }
 
@@ -478,7 +680,7 @@ static int load_contents(struct snapshot *snapshot)
 	size_t size;
 	ssize_t bytes_read;
 
-	fd = open(snapshot->refs->path, O_RDONLY);
+	fd = open(snapshot_path(snapshot), O_RDONLY);
 	if (fd < 0) {
 		if (errno == ENOENT) {
 			/*
@@ -490,24 +692,26 @@ static int load_contents(struct snapshot *snapshot)
 			 */
 			return 0;
 		} else {
-			die_errno("couldn't read %s", snapshot->refs->path);
+			die_errno("couldn't read %s", snapshot_path(snapshot));
 		}
 	}
 
 	stat_validity_update(&snapshot->validity, fd);
 
 	if (fstat(fd, &st) < 0)
-		die_errno("couldn't stat %s", snapshot->refs->path);
+		die_errno("couldn't stat %s", snapshot_path(snapshot));
 	size = xsize_t(st.st_size);
 
 	if (!size) {
 		close(fd);
 		return 0;
-	} else if (mmap_strategy == MMAP_NONE || size <= SMALL_FILE_SIZE) {
+	} else if (mmap_strategy == MMAP_NONE || size <= SMALL_FILE_SIZE ||
+		   /* the delta file may be truncated under us */
+		   snapshot->is_delta) {
 		snapshot->buf = xmalloc(size);
 		bytes_read = read_in_full(fd, snapshot->buf, size);
 		if (bytes_read < 0 || bytes_read != size)
-			die_errno("couldn't read %s", snapshot->refs->path);
+			die_errno("couldn't read %s", snapshot_path(snapshot));
 		snapshot->mmapped = 0;
 	} else {
 		snapshot->buf = xmmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
@@ -614,13 +818,23 @@ static const char *find_reference_location(struct snapshot *snapshot,
  *   `sorted`:
  *
  *      The references in this file are known to be sorted by refname.
+ *
+ *   `delta-generation=<n>`, `delta-folded=<n>`:
+ *
+ *      The `generation` of a delta file, or of the last delta file
+ *      folded into a `packed-refs` file, respectively.
+ *
+ * If `is_delta` is set, read the `packed-refs.delta` file instead.
  */
-static struct snapshot *create_snapshot(struct packed_ref_store *refs)
+static struct snapshot *create_snapshot(struct packed_ref_store *refs,
+					int is_delta)
 {
 	struct snapshot *snapshot = xcalloc(1, sizeof(*snapshot));
 	int sorted = 0;
+	size_t i;
 
 	snapshot->refs = refs;
+	snapshot->is_delta = is_delta;
 	acquire_snapshot(snapshot);
 	snapshot->peeled = PEELED_NONE;
 
@@ -634,15 +848,20 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 
 		eol = memchr(snapshot->buf, '\n',
 			     snapshot->eof - snapshot->buf);
+		if (!eol && is_delta) {
+			/* The delta file is still being created. */
+			clear_snapshot_buffer(snapshot);
+			return snapshot;
+		}
 		if (!eol)
-			die_unterminated_line(refs->path,
+			die_unterminated_line(snapshot_path(snapshot),
 					      snapshot->buf,
 					      snapshot->eof - snapshot->buf);
 
 		tmp = xmemdupz(snapshot->buf, eol - snapshot->buf);
 
 		if (!skip_prefix(tmp, "# pack-refs with:", (const char **)&p))
-			die_invalid_line(refs->path,
+			die_invalid_line(snapshot_path(snapshot),
 					 snapshot->buf,
 					 snapshot->eof - snapshot->buf);
 
@@ -655,6 +874,15 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 
 		sorted = unsorted_string_list_has_string(&traits, "sorted");
 
+		for (i = 0; i < traits.nr; i++) {
+			const char *value;
+
+			if (skip_prefix(traits.items[i].string,
+					is_delta ? "delta-generation=" :
+						   "delta-folded=", &value))
+				snapshot->generation = strtoumax(value, NULL, 10);
+		}
+
 		/* perhaps other traits later as well */
 
 		/* The "+ 1" is for the LF character. */
@@ -664,19 +892,14 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 		free(tmp);
 	}
 
-	verify_buffer_safe(snapshot);
-
-	if (!sorted) {
-		sort_snapshot(snapshot);
-
-		/*
-		 * Reordering the records might have moved a short one
-		 * to the end of the buffer, so verify the buffer's
-		 * safety again:
-		 */
-		verify_buffer_safe(snapshot);
+	if (is_delta) {
+		read_delta_records(snapshot);
+		return snapshot;
 	}
 
+	verify_buffer_safe(snapshot);
+	snapshot->sorted = sorted;
+
 	if (mmap_strategy != MMAP_OK && snapshot->mmapped) {
 		/*
 		 * We don't want to leave the file mmapped, so we are
@@ -694,14 +917,59 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 	return snapshot;
 }
 
+/*
+ * Take a snapshot of the `packed-refs` file and, if the store keeps
+ * one, of the `packed-refs.delta` file.
+ *
+ * The two have to match. Writers replace the delta file on its own,
+ * or first replace `packed-refs` with one that includes the changes
+ * from the delta file and then remove it. So read the delta file
+ * first, and start over if it has changed by the time `packed-refs`
+ * has been read. The `packed-refs` file read after it is then either
+ * the one the delta file applies to, or a newer one that already
+ * includes its changes, as told by their generations; the delta file
+ * is ignored in the latter case, as it might undo changes made since.
+ */
+static struct snapshot *create_snapshots(struct packed_ref_store *refs)
+{
+	struct snapshot *snapshot, *delta;
+
+	if (!refs->delta_path)
+		return create_snapshot(refs, 0);
+
+	while (1) {
+		delta = create_snapshot(refs, 1);
+		snapshot = create_snapshot(refs, 0);
+		if (stat_validity_check(&delta->validity, refs->delta_path))
+			break;
+		release_snapshot(delta);
+		release_snapshot(snapshot);
+	}
+
+	if (delta->generation <= snapshot->generation) {
+		clear_snapshot_buffer(delta);
+		delta->delta_len = 0;
+	}
+
+	snapshot->delta = delta;
+	return snapshot;
+}
+
 /*
  * Check that `refs->snapshot` (if present) still reflects the
- * contents of the `packed-refs` file. If not, clear the snapshot.
+ * contents of the `packed-refs` file and of the `packed-refs.delta`
+ * file. If not, clear the snapshot.
  */
 static void validate_snapshot(struct packed_ref_store *refs)
 {
-	if (refs->snapshot &&
-	    !stat_validity_check(&refs->snapshot->validity, refs->path))
+	struct snapshot *snapshot = refs->snapshot;
+
+	if (!snapshot)
+		return;
+	if (!stat_validity_check(&snapshot->validity, refs->path) ||
+	    (snapshot->delta &&
+	     !stat_validity_check(&snapshot->delta->validity,
+				  refs->delta_path)))
 		clear_snapshot(refs);
 }
 
@@ -720,11 +988,33 @@ static struct snapshot *get_snapshot(struct packed_ref_store *refs)
 		validate_snapshot(refs);
 
 	if (!refs->snapshot)
-		refs->snapshot = create_snapshot(refs);
+		refs->snapshot = create_snapshots(refs);
 
 	return refs->snapshot;
 }
 
+/*
+ * How many references to look up by scanning a `packed-refs` file
+ * that is not known to be sorted before sorting it. Sorting it costs
+ * as much as a few dozen scans, but is wasted on commands that only
+ * look up a handful of references.
+ */
+#define UNSORTED_LOOKUP_LIMIT 8
+
+/*
+ * Return the start of the record for `refname` in `snapshot`, or NULL
+ * if there is none.
+ */
+static const char *find_record(struct snapshot *snapshot, const char *refname)
+{
+	if (!snapshot->sorted &&
+	    snapshot->unsorted_lookups++ < UNSORTED_LOOKUP_LIMIT)
+		return scan_for_reference(snapshot, refname);
+
+	sort_snapshot(snapshot);
+	return find_reference_location(snapshot, refname, 1);
+}
+
 static int packed_read_raw_ref(struct ref_store *ref_store, const char *refname,
 			       struct object_id *oid, struct strbuf *referent,
 			       unsigned int *type, int *failure_errno)
@@ -732,11 +1022,14 @@ static int packed_read_raw_ref(struct ref_store *ref_store, const char *refname,
 	struct packed_ref_store *refs =
 		packed_downcast(ref_store, REF_STORE_READ, "read_raw_ref");
 	struct snapshot *snapshot = get_snapshot(refs);
-	const char *rec;
+	const char *rec = NULL;
 
 	*type = 0;
 
-	rec = find_reference_location(snapshot, refname, 1);
+	if (snapshot->delta && (rec = find_record(snapshot->delta, refname)))
+		snapshot = snapshot->delta;
+	else
+		rec = find_record(snapshot, refname);
 
 	if (!rec) {
 		/* refname is not a packed reference. */
@@ -745,7 +1038,14 @@ static int packed_read_raw_ref(struct ref_store *ref_store, const char *refname,
 	}
 
 	if (get_oid_hex(rec, oid))
-		die_invalid_line(refs->path, rec, snapshot->eof - rec);
+		die_invalid_line(snapshot_path(snapshot), rec,
+				 snapshot->eof - rec);
+
+	if (snapshot->is_delta && is_null_oid(oid)) {
+		/* refname has been deleted. */
+		*failure_errno = ENOENT;
+		return -1;
+	}
 
 	*type = REF_ISPACKED;
 	return 0;
@@ -773,6 +1073,12 @@ struct packed_ref_iterator {
 	/* The end of the part of the buffer that will be iterated over: */
 	const char *eof;
 
+	/*
+	 * The sorted copy of the records being iterated over, if they
+	 * were picked out of an unsorted snapshot; otherwise NULL:
+	 */
+	char *buf;
+
 	/* Scratch space for current values: */
 	struct object_id oid, peeled;
 	struct strbuf refname_buf;
@@ -802,12 +1108,12 @@ static int next_record(struct packed_ref_iterator *iter)
 	if (iter->eof - p < the_hash_algo->hexsz + 2 ||
 	    parse_oid_hex(p, &iter->oid, &p) ||
 	    !isspace(*p++))
-		die_invalid_line(iter->snapshot->refs->path,
+		die_invalid_line(snapshot_path(iter->snapshot),
 				 iter->pos, iter->eof - iter->pos);
 
 	eol = memchr(p, '\n', iter->eof - p);
 	if (!eol)
-		die_unterminated_line(iter->snapshot->refs->path,
+		die_unterminated_line(snapshot_path(iter->snapshot),
 				      iter->pos, iter->eof - iter->pos);
 
 	strbuf_add(&iter->refname_buf, p, eol - p);
@@ -832,7 +1138,7 @@ static int next_record(struct packed_ref_iterator *iter)
 		if (iter->eof - p < the_hash_algo->hexsz + 1 ||
 		    parse_oid_hex(p, &iter->peeled, &p) ||
 		    *p++ != '\n')
-			die_invalid_line(iter->snapshot->refs->path,
+			die_invalid_line(snapshot_path(iter->snapshot),
 					 iter->pos, iter->eof - iter->pos);
 		iter->pos = p;
 
@@ -866,9 +1172,18 @@ static int packed_ref_iterator_advance(struct ref_iterator *ref_iterator)
 			continue;
 
 		if (!(iter->flags & DO_FOR_EACH_INCLUDE_BROKEN) &&
+		    !(iter->snapshot->is_delta && is_null_oid(&iter->oid)) &&
 		    !ref_resolves_to_object(iter->base.refname, iter->repo,
-					    &iter->oid, iter->flags))
-			continue;
+					    &iter->oid, iter->flags)) {
+			if (!iter->snapshot->is_delta)
+				continue;
+			/*
+			 * Records of a delta file have to reach
+			 * delta_iterator_select() to hide the old value,
+			 * so pass a broken one on as a deletion:
+			 */
+			oidclr(&iter->oid);
+		}
 
 		return ITER_OK;
 	}
@@ -905,6 +1220,7 @@ static int packed_ref_iterator_abort(struct ref_iterator *ref_iterator)
 	int ok = ITER_DONE;
 
 	strbuf_release(&iter->refname_buf);
+	free(iter->buf);
 	release_snapshot(iter->snapshot);
 	base_ref_iterator_free(ref_iterator);
 	return ok;
@@ -916,35 +1232,42 @@ static struct ref_iterator_vtable packed_ref_iterator_vtable = {
 	packed_ref_iterator_abort
 };
 
-static struct ref_iterator *packed_ref_iterator_begin(
-		struct ref_store *ref_store,
+/*
+ * Return an iterator over the records in `snapshot` (but not over
+ * those of its delta snapshot) whose refnames start with `prefix`.
+ */
+static struct ref_iterator *snapshot_iterator_begin(
+		struct repository *repo, struct snapshot *snapshot,
 		const char *prefix, unsigned int flags)
 {
-	struct packed_ref_store *refs;
-	struct snapshot *snapshot;
-	const char *start;
+	const char *start, *eof;
+	char *buf = NULL;
 	struct packed_ref_iterator *iter;
 	struct ref_iterator *ref_iterator;
-	unsigned int required_flags = REF_STORE_READ;
-
-	if (!(flags & DO_FOR_EACH_INCLUDE_BROKEN))
-		required_flags |= REF_STORE_ODB;
-	refs = packed_downcast(ref_store, required_flags, "ref_iterator_begin");
 
-	/*
-	 * Note that `get_snapshot()` internally checks whether the
-	 * snapshot is up to date with what is on disk, and re-reads
-	 * it if not.
-	 */
-	snapshot = get_snapshot(refs);
+	if (!snapshot->sorted && prefix && *prefix) {
+		/*
+		 * Rather than sorting the whole file, sort only the
+		 * records that we are going to iterate over:
+		 */
+		size_t len;
 
-	if (prefix && *prefix)
-		start = find_reference_location(snapshot, prefix, 0);
-	else
-		start = snapshot->start;
+		buf = sort_records(snapshot, prefix, &len);
+		start = buf;
+		eof = buf + len;
+	} else {
+		sort_snapshot(snapshot);
+		if (prefix && *prefix)
+			start = find_reference_location(snapshot, prefix, 0);
+		else
+			start = snapshot->start;
+		eof = snapshot->eof;
+	}
 
-	if (start == snapshot->eof)
+	if (start == eof) {
+		free(buf);
 		return empty_ref_iterator_begin();
+	}
 
 	CALLOC_ARRAY(iter, 1);
 	ref_iterator = &iter->base;
@@ -954,12 +1277,13 @@ static struct ref_iterator *packed_ref_iterator_begin(
 	acquire_snapshot(snapshot);
 
 	iter->pos = start;
-	iter->eof = snapshot->eof;
+	iter->eof = eof;
+	iter->buf = buf;
 	strbuf_init(&iter->refname_buf, 0);
 
 	iter->base.oid = &iter->oid;
 
-	iter->repo = ref_store->repo;
+	iter->repo = repo;
 	iter->flags = flags;
 
 	if (prefix && *prefix)
@@ -969,6 +1293,64 @@ static struct ref_iterator *packed_ref_iterator_begin(
 	return ref_iterator;
 }
 
+/*
+ * Merge the references in a delta file (iterated over by `delta`)
+ * into those of the `packed-refs` file (iterated over by `base`).
+ */
+static enum iterator_selection delta_iterator_select(
+		struct ref_iterator *delta, struct ref_iterator *base,
+		void *cb_data)
+{
+	int cmp;
+
+	if (!delta)
+		return base ? ITER_SELECT_1 : ITER_SELECT_DONE;
+
+	cmp = base ? strcmp(delta->refname, base->refname) : -1;
+	if (cmp > 0)
+		return ITER_SELECT_1;
+	if (!is_null_oid(delta->oid))
+		return cmp ? ITER_SELECT_0 : ITER_SELECT_0_SKIP_1;
+
+	/* The reference has been deleted; drop it from both. */
+	return cmp ? ITER_SKIP_0 : ITER_SKIP_1;
+}
+
+static struct ref_iterator *packed_ref_iterator_begin(
+		struct ref_store *ref_store,
+		const char *prefix, unsigned int flags)
+{
+	struct packed_ref_store *refs;
+	struct snapshot *snapshot;
+	struct ref_iterator *iter, *delta;
+	unsigned int required_flags = REF_STORE_READ;
+
+	if (!(flags & DO_FOR_EACH_INCLUDE_BROKEN))
+		required_flags |= REF_STORE_ODB;
+	refs = packed_downcast(ref_store, required_flags, "ref_iterator_begin");
+
+	/*
+	 * Note that `get_snapshot()` internally checks whether the
+	 * snapshot is up to date with what is on disk, and re-reads
+	 * it if not.
+	 */
+	snapshot = get_snapshot(refs);
+
+	iter = snapshot_iterator_begin(ref_store->repo, snapshot,
+				       prefix, flags);
+	if (!snapshot->delta)
+		return iter;
+
+	delta = snapshot_iterator_begin(ref_store->repo, snapshot->delta,
+					prefix, flags);
+	if (is_empty_ref_iterator(delta)) {
+		ref_iterator_abort(delta);
+		return iter;
+	}
+	return merge_ref_iterator_begin(1, delta, iter,
+					delta_iterator_select, NULL);
+}
+
 /*
  * Write an entry to the packed-refs file for the specified refname.
  * If peeled is non-NULL, write it as the entry's peeled value. On
@@ -1078,6 +1460,16 @@ int packed_refs_is_locked(struct ref_store *ref_store)
 static const char PACKED_REFS_HEADER[] =
 	"# pack-refs with: peeled fully-peeled sorted \n";
 
+/*
+ * The header lines of the `packed-refs` and `packed-refs.delta` files
+ * of a store that keeps a delta file, recording the `generation` of
+ * the snapshot.
+ */
+#define PACKED_REFS_FOLDED_HEADER \
+	"# pack-refs with: peeled fully-peeled sorted delta-folded=%"PRIuMAX" \n"
+#define PACKED_REFS_DELTA_HEADER \
+	"# pack-refs with: peeled fully-peeled delta-generation=%"PRIuMAX" \n"
+
 static int packed_init_db(struct ref_store *ref_store, struct strbuf *err)
 {
 	/* Nothing to do. */
@@ -1132,8 +1524,19 @@ static int write_with_updates(struct packed_ref_store *refs,
 		goto error;
 	}
 
-	if (fprintf(out, "%s", PACKED_REFS_HEADER) < 0)
+	if (refs->delta_path) {
+		/* The delta file is about to be folded into the new file: */
+		struct snapshot *snapshot = get_snapshot(refs);
+
+		if (fprintf(out, PACKED_REFS_FOLDED_HEADER,
+			    (uintmax_t)(snapshot->delta->generation >
+					snapshot->generation ?
+					snapshot->delta->generation :
+					snapshot->generation)) < 0)
+			goto write_error;
+	} else if (fprintf(out, "%s", PACKED_REFS_HEADER) < 0) {
 		goto write_error;
+	}
 
 	/*
 	 * We iterate in parallel through the current list of refs and
@@ -1262,7 +1665,8 @@ static int write_with_updates(struct packed_ref_store *refs,
 		goto error;
 	}
 
-	if (close_tempfile_gently(refs->tempfile)) {
+	if (fsync_component(FSYNC_COMPONENT_REFERENCE, get_tempfile_fd(refs->tempfile)) ||
+	    close_tempfile_gently(refs->tempfile)) {
 		strbuf_addf(err, "error closing file %s: %s",
 			    get_tempfile_path(refs->tempfile),
 			    strerror(errno));
@@ -1285,6 +1689,224 @@ static int write_with_updates(struct packed_ref_store *refs,
 	return -1;
 }
 
+/*
+ * Format an entry for the specified refname as `write_packed_entry()`
+ * would write it, appending it to `sb`.
+ */
+static void add_packed_entry(struct strbuf *sb, const char *refname,
+			     const struct object_id *oid,
+			     const struct object_id *peeled)
+{
+	strbuf_addf(sb, "%s %s\n", oid_to_hex(oid), refname);
+	if (peeled)
+		strbuf_addf(sb, "^%s\n", oid_to_hex(peeled));
+}
+
+/*
+ * Prepare the segment of the delta file that records the changes from
+ * `updates`, which must be sorted as for `write_with_updates()`, in
+ * `segment`. Deleting a reference that is in the `packed-refs` file or
+ * in the delta file is recorded with the null object ID. If there is
+ * no current delta file to append the segment to, write a new one,
+ * holding just the segment, to a tempfile next to it. On error,
+ * rollback the tempfile, write an error message to `err`, and return a
+ * nonzero value.
+ *
+ * The packfile must be locked before calling this function and will
+ * remain locked when it is done.
+ */
+static int write_delta_with_updates(struct packed_ref_store *refs,
+				    struct string_list *updates,
+				    struct strbuf *segment,
+				    struct strbuf *err)
+{
+	struct snapshot *snapshot = get_snapshot(refs);
+	struct strbuf sb = STRBUF_INIT;
+	size_t i;
+	FILE *out;
+
+	if (!is_lock_file_locked(&refs->lock))
+		BUG("write_delta_with_updates() called while unlocked");
+
+	/* Check the old values against the packed refs as a whole: */
+	for (i = 0; i < updates->nr; i++) {
+		struct ref_update *update = updates->items[i].util;
+		struct object_id oid;
+		unsigned int type;
+		int failure_errno;
+
+		if (!(update->flags & REF_HAVE_OLD))
+			continue;
+
+		if (refs_read_raw_ref(&refs->base, update->refname, &oid, &sb,
+				      &type, &failure_errno)) {
+			if (!is_null_oid(&update->old_oid)) {
+				strbuf_addf(err, "cannot update ref '%s': "
+					    "reference is missing but expected %s",
+					    update->refname,
+					    oid_to_hex(&update->old_oid));
+				goto error;
+			}
+		} else if (is_null_oid(&update->old_oid)) {
+			strbuf_addf(err, "cannot update ref '%s': "
+				    "reference already exists",
+				    update->refname);
+			goto error;
+		} else if (!oideq(&update->old_oid, &oid)) {
+			strbuf_addf(err, "cannot update ref '%s': "
+				    "is at %s but expected %s",
+				    update->refname,
+				    oid_to_hex(&oid),
+				    oid_to_hex(&update->old_oid));
+			goto error;
+		}
+	}
+	strbuf_release(&sb);
+
+	for (i = 0; i < updates->nr; i++) {
+		struct ref_update *update = updates->items[i].util;
+
+		if (!(update->flags & REF_HAVE_NEW))
+			continue;
+
+		if (!is_null_oid(&update->new_oid)) {
+			struct object_id peeled;
+			int peel_error = peel_object(&update->new_oid,
+						     &peeled);
+
+			add_packed_entry(segment, update->refname,
+					 &update->new_oid,
+					 peel_error ? NULL : &peeled);
+		} else if (find_record(snapshot, update->refname) ||
+			   find_record(snapshot->delta, update->refname)) {
+			add_packed_entry(segment, update->refname,
+					 null_oid(), NULL);
+		}
+	}
+	if (!segment->len)
+		return 0;
+	strbuf_addstr(segment, DELTA_SEGMENT_END);
+
+	if (snapshot->delta->delta_len)
+		/* packed_transaction_finish() appends the segment. */
+		return 0;
+
+	strbuf_addf(&sb, "%s.new", refs->delta_path);
+	refs->tempfile = create_tempfile(sb.buf);
+	if (!refs->tempfile) {
+		strbuf_addf(err, "unable to create file %s: %s",
+			    sb.buf, strerror(errno));
+		strbuf_release(&sb);
+		return -1;
+	}
+	strbuf_release(&sb);
+
+	out = fdopen_tempfile(refs->tempfile, "w");
+	if (!out) {
+		strbuf_addf(err, "unable to fdopen packed-refs tempfile: %s",
+			    strerror(errno));
+		goto error;
+	}
+
+	/* Start a new delta file, with the next generation: */
+	if (fprintf(out, PACKED_REFS_DELTA_HEADER,
+		    (uintmax_t)snapshot->generation + 1) < 0 ||
+	    fwrite(segment->buf, 1, segment->len, out) != segment->len)
+		goto write_error;
+
+	if (fsync_component(FSYNC_COMPONENT_REFERENCE, get_tempfile_fd(refs->tempfile)) ||
+	    close_tempfile_gently(refs->tempfile)) {
+		strbuf_addf(err, "error closing file %s: %s",
+			    get_tempfile_path(refs->tempfile),
+			    strerror(errno));
+		delete_tempfile(&refs->tempfile);
+		return -1;
+	}
+
+	return 0;
+
+write_error:
+	strbuf_addf(err, "error writing to %s: %s",
+		    get_tempfile_path(refs->tempfile), strerror(errno));
+
+error:
+	strbuf_release(&sb);
+	delete_tempfile(&refs->tempfile);
+	return -1;
+}
+
+/*
+ * Append `segment` to the delta file, whose complete part is
+ * `delta_len` bytes long; anything after it is left over from a
+ * writer that died, and is overwritten. On error, write an error
+ * message to `err` and return a nonzero value.
+ */
+static int append_delta_segment(struct packed_ref_store *refs,
+				struct strbuf *segment, size_t delta_len,
+				struct strbuf *err)
+{
+	int fd = open(refs->delta_path, O_WRONLY);
+
+	if (fd < 0) {
+		strbuf_addf(err, "unable to open %s: %s",
+			    refs->delta_path, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(fd, delta_len) ||
+	    lseek(fd, delta_len, SEEK_SET) < 0 ||
+	    write_in_full(fd, segment->buf, segment->len) < 0 ||
+	    fsync_component(FSYNC_COMPONENT_REFERENCE, fd)) {
+		strbuf_addf(err, "error writing to %s: %s",
+			    refs->delta_path, strerror(errno));
+		/* Leave readers as little as possible to skip over: */
+		if (ftruncate(fd, delta_len))
+			; /* they can cope */
+		close(fd);
+		return -1;
+	}
+	if (close(fd)) {
+		strbuf_addf(err, "error closing file %s: %s",
+			    refs->delta_path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Record the changes from a transaction with `updates` in the delta
+ * file only while it stays small compared to the `packed-refs` file;
+ * otherwise rewrite `packed-refs`, folding the delta file into it.
+ * As changes are appended to the delta file, and it is folded only
+ * once it has grown to a fraction of the size of `packed-refs`, the
+ * cost of rewriting `packed-refs` is amortized over the transactions
+ * that filled the delta file.
+ */
+#define PACKED_REFS_DELTA_RATIO 8
+
+static int use_delta(struct packed_ref_store *refs,
+		     struct string_list *updates)
+{
+	struct snapshot *snapshot;
+	size_t size, delta_size;
+	size_t i;
+
+	/*
+	 * A transaction without updates is a request to rewrite the
+	 * `packed-refs` file:
+	 */
+	if (!refs->delta_path || !updates->nr)
+		return 0;
+
+	snapshot = get_snapshot(refs);
+	size = snapshot->eof - snapshot->start;
+	delta_size = snapshot->delta->delta_len;
+	for (i = 0; i < updates->nr; i++)
+		delta_size += 2 * (the_hash_algo->hexsz + 1) +
+			strlen(updates->items[i].string) + 1;
+
+	return delta_size <= size / PACKED_REFS_DELTA_RATIO;
+}
+
 int is_packed_transaction_needed(struct ref_store *ref_store,
 				 struct ref_transaction *transaction)
 {
@@ -1384,6 +2006,16 @@ struct packed_transaction_backend_data {
 	/* True iff the transaction owns the packed-refs lock. */
 	int own_lock;
 
+	/* True iff the transaction writes the delta file. */
+	int delta;
+
+	/*
+	 * The changes to append to the delta file, and the length of
+	 * its complete part to append them to, if it is not replaced.
+	 */
+	struct strbuf segment;
+	size_t delta_len;
+
 	struct string_list updates;
 };
 
@@ -1394,6 +2026,7 @@ static void packed_transaction_cleanup(struct packed_ref_store *refs,
 
 	if (data) {
 		string_list_clear(&data->updates, 0);
+		strbuf_release(&data->segment);
 
 		if (is_tempfile_active(refs->tempfile))
 			delete_tempfile(&refs->tempfile);
@@ -1425,14 +2058,15 @@ static int packed_transaction_prepare(struct ref_store *ref_store,
 	/*
 	 * Note that we *don't* skip transactions with zero updates,
 	 * because such a transaction might be executed for the side
-	 * effect of ensuring that all of the references are peeled or
-	 * ensuring that the `packed-refs` file is sorted. If the
-	 * caller wants to optimize away empty transactions, it should
-	 * do so itself.
+	 * effect of ensuring that all of the references are peeled,
+	 * ensuring that the `packed-refs` file is sorted, or folding
+	 * the delta file into it. If the caller wants to optimize away
+	 * empty transactions, it should do so itself.
 	 */
 
 	CALLOC_ARRAY(data, 1);
 	string_list_init_nodup(&data->updates);
+	strbuf_init(&data->segment, 0);
 
 	transaction->backend_data = data;
 
@@ -1459,8 +2093,15 @@ static int packed_transaction_prepare(struct ref_store *ref_store,
 		data->own_lock = 1;
 	}
 
-	if (write_with_updates(refs, &data->updates, err))
+	data->delta = use_delta(refs, &data->updates);
+	if (data->delta) {
+		data->delta_len = get_snapshot(refs)->delta->delta_len;
+		if (write_delta_with_updates(refs, &data->updates,
+					     &data->segment, err))
+			goto failure;
+	} else if (write_with_updates(refs, &data->updates, err)) {
 		goto failure;
+	}
 
 	transaction->state = REF_TRANSACTION_PREPARED;
 	return 0;
@@ -1491,11 +2132,27 @@ static int packed_transaction_finish(struct ref_store *ref_store,
 			ref_store,
 			REF_STORE_READ | REF_STORE_WRITE | REF_STORE_ODB,
 			"ref_transaction_finish");
+	struct packed_transaction_backend_data *data = transaction->backend_data;
 	int ret = TRANSACTION_GENERIC_ERROR;
-	char *packed_refs_path;
+	char *packed_refs_path = NULL;
 
 	clear_snapshot(refs);
 
+	if (data->delta) {
+		if (!is_tempfile_active(refs->tempfile)) {
+			if (!data->segment.len ||
+			    !append_delta_segment(refs, &data->segment,
+						  data->delta_len, err))
+				ret = 0;
+		} else if (rename_tempfile(&refs->tempfile, refs->delta_path)) {
+			strbuf_addf(err, "error replacing %s: %s",
+				    refs->delta_path, strerror(errno));
+		} else {
+			ret = 0;
+		}
+		goto cleanup;
+	}
+
 	packed_refs_path = get_locked_file_path(&refs->lock);
 	if (rename_tempfile(&refs->tempfile, packed_refs_path)) {
 		strbuf_addf(err, "error replacing %s: %s",
@@ -1503,6 +2160,14 @@ static int packed_transaction_finish(struct ref_store *ref_store,
 		goto cleanup;
 	}
 
+	/*
+	 * The new `packed-refs` file includes the changes from the
+	 * delta file, so it is no longer needed. Readers that still
+	 * see it ignore it, as its generation has been folded.
+	 */
+	if (refs->delta_path)
+		unlink_or_warn(refs->delta_path);
+
 	ret = 0;
 
 cleanup:
@@ -1581,6 +2246,29 @@ int packed_refs_delete_refs(struct ref_store *ref_store,
 	return ret;
 }
 
+int packed_refs_compact(struct ref_store *ref_store, struct strbuf *err)
+{
+	struct packed_ref_store *refs = packed_downcast(
+			ref_store,
+			REF_STORE_READ | REF_STORE_WRITE | REF_STORE_ODB,
+			"packed_refs_compact");
+	struct ref_transaction *transaction;
+	int ret;
+
+	if (!refs->delta_path || !file_exists(refs->delta_path))
+		return 0;
+
+	/* A transaction without updates rewrites `packed-refs`. */
+	transaction = ref_store_transaction_begin(ref_store,
+						  REF_TRANSACTION_SKIP_HOOK,
+						  err);
+	if (!transaction)
+		return -1;
+	ret = ref_transaction_commit(transaction, err);
+	ref_transaction_free(transaction);
+	return ret;
+}
+
 static int packed_pack_refs(struct ref_store *ref_store, unsigned int flags)
 {
 	/*
@@ -1666,6 +2354,20 @@ static int packed_reflog_expire(struct ref_store *ref_store,
 	return 0;
 }
 
+static int packed_generation_token(struct ref_store *ref_store,
+				   struct strbuf *token)
+{
+	struct packed_ref_store *refs = packed_downcast(
+			ref_store, REF_STORE_READ, "generation_token");
+
+	/* Both files are only ever replaced, never written in place. */
+	if (stat_generation_token(token, refs->path) ||
+	    (refs->delta_path &&
+	     stat_generation_token(token, refs->delta_path)))
+		return -1;
+	return 0;
+}
+
 struct ref_storage_be refs_be_packed = {
 	NULL,
 	"packed",
@@ -1691,5 +2393,7 @@ struct ref_storage_be refs_be_packed = {
 	packed_reflog_exists,
 	packed_create_reflog,
 	packed_delete_reflog,
-	packed_reflog_expire
+	packed_reflog_expire,
+
+	packed_generation_token
 };
@@ -43,4 +43,13 @@ int packed_refs_delete_refs(struct ref_store *ref_store,
 int is_packed_transaction_needed(struct ref_store *ref_store,
 				 struct ref_transaction *transaction);
 
+/*
+ * If the repository records changes to packed references in a
+ * `packed-refs.delta` file, fold them into the `packed-refs` file.
+ * `ref_store` must be locked before calling this function. Return 0
+ * on success. On errors, write an error message to `err` and return a
+ * nonzero value.
+ */
+int packed_refs_compact(struct ref_store *ref_store, struct strbuf *err);
+
 #endif /* REFS_PACKED_BACKEND_H */
@@ -603,6 +603,21 @@ typedef int reflog_expire_fn(struct ref_store *ref_store,
 			     reflog_expiry_cleanup_fn cleanup_fn,
 			     void *policy_cb_data);
 
+/*
+ * Append a string that changes whenever a reference in the store
+ * changes to `token`; see refs_generation_token(). Optional.
+ */
+typedef int generation_token_fn(struct ref_store *ref_store,
+				struct strbuf *token);
+
+/*
+ * Append the stat data of `path`, which backends replace by renaming
+ * a new file into place, to `token`. Return -1 if `path` was modified
+ * so recently that its timestamp might not change with the next
+ * modification.
+ */
+int stat_generation_token(struct strbuf *token, const char *path);
+
 /*
  * Read a reference from the specified reference store, non-recursively.
  * Set type to describe the reference, and:
@@ -676,9 +691,12 @@ struct ref_storage_be {
 	create_reflog_fn *create_reflog;
 	delete_reflog_fn *delete_reflog;
 	reflog_expire_fn *reflog_expire;
+
+	generation_token_fn *generation_token;
 };
 
 extern struct ref_storage_be refs_be_files;
+extern struct ref_storage_be refs_be_reftable;
 extern struct ref_storage_be refs_be_packed;
 
 /*
@@ -0,0 +1,2258 @@
+#include "../cache.h"
+#include "../config.h"
+#include "../iterator.h"
+#include "../object.h"
+#include "../refs.h"
+#include "../strmap.h"
+#include "../worktree.h"
+#include "refs-internal.h"
+#include "../reftable/reftable-error.h"
+#include "../reftable/reftable-iterator.h"
+#include "../reftable/reftable-merged.h"
+#include "../reftable/reftable-record.h"
+#include "../reftable/reftable-stack.h"
+
+/*
+ * Used as a flag in ref_update::flags when the ref_update was via an
+ * update to HEAD. See the same flag in files-backend.c.
+ */
+#define REF_UPDATE_VIA_HEAD (1 << 8)
+
+/*
+ * A stack of tables together with the directory it lives in, which
+ * iterators need to open a snapshot of their own.
+ */
+struct reftable_backend {
+	struct reftable_stack *stack;
+	char *dir;
+};
+
+struct reftable_ref_store {
+	struct ref_store base;
+
+	/*
+	 * The main backend holds all refs shared between worktrees. In a
+	 * linked worktree, its per-worktree refs and pseudorefs live in
+	 * worktree_backend instead; in the main worktree that has no
+	 * stack. Backends of other worktrees, for "worktrees/<id>/" refs,
+	 * are opened on demand and kept in worktree_backends.
+	 */
+	struct reftable_backend main_backend;
+	struct reftable_backend worktree_backend;
+	struct strmap worktree_backends;
+	struct reftable_write_options write_options;
+
+	unsigned int store_flags;
+	int err;
+};
+
+/*
+ * Downcast ref_store to reftable_ref_store. Die if ref_store is not a
+ * reftable_ref_store or lacks any of the required_flags.
+ */
+static struct reftable_ref_store *reftable_downcast(struct ref_store *ref_store,
+						    unsigned int required_flags,
+						    const char *caller)
+{
+	struct reftable_ref_store *refs;
+
+	if (ref_store->be != &refs_be_reftable)
+		BUG("ref_store is type \"%s\" not \"reftable\" in %s",
+		    ref_store->be->name, caller);
+
+	refs = (struct reftable_ref_store *)ref_store;
+
+	if ((refs->store_flags & required_flags) != required_flags)
+		BUG("operation %s requires abilities 0x%x, but only have 0x%x",
+		    caller, required_flags, refs->store_flags);
+
+	return refs;
+}
+
+static int open_backend(struct reftable_ref_store *refs, const char *gitdir,
+			struct reftable_backend *be)
+{
+	struct strbuf path = STRBUF_INIT;
+
+	/*
+	 * Make the path absolute to survive a chdir() of the process.
+	 */
+	strbuf_addf(&path, "%s/reftable", absolute_path(gitdir));
+
+	/*
+	 * A missing directory reads as an empty stack. Linked worktrees
+	 * get theirs when first opened for writing; failing to create it
+	 * is reported by the first write.
+	 */
+	if ((refs->store_flags & REF_STORE_WRITE) && !mkdir(path.buf, 0777))
+		adjust_shared_perm(path.buf);
+
+	be->dir = strbuf_detach(&path, NULL);
+	return reftable_new_stack(&be->stack, be->dir, refs->write_options);
+}
+
+/*
+ * Open a private copy of the stack of "be". Unlike the shared stack,
+ * which is reloaded whenever a ref is read, it stays valid while we
+ * iterate over it even if other processes update the refs.
+ */
+static int open_snapshot(struct reftable_ref_store *refs,
+			 struct reftable_backend *be,
+			 struct reftable_stack **snapshot)
+{
+	return reftable_new_stack(snapshot, be->dir, refs->write_options);
+}
+
+/*
+ * Return the backend holding "refname" and point "rewritten_ref" at
+ * the name it has in that backend, which differs from "refname" for
+ * refs of another worktree ("main-worktree/HEAD",
+ * "worktrees/<id>/HEAD"). Return NULL if it could not be opened.
+ */
+static struct reftable_backend *backend_for(struct reftable_ref_store *refs,
+					    const char *refname,
+					    const char **rewritten_ref)
+{
+	const char *wtname;
+	int wtname_len;
+
+	if (rewritten_ref)
+		*rewritten_ref = refname;
+
+	switch (ref_type(refname)) {
+	case REF_TYPE_PER_WORKTREE:
+	case REF_TYPE_PSEUDOREF:
+		if (refs->worktree_backend.stack)
+			return &refs->worktree_backend;
+		return &refs->main_backend;
+	case REF_TYPE_MAIN_PSEUDOREF:
+	case REF_TYPE_OTHER_PSEUDOREF:
+		if (parse_worktree_ref(refname, &wtname, &wtname_len,
+				       rewritten_ref))
+			BUG("refname %s is not a worktree ref", refname);
+		if (wtname) {
+			struct strbuf wtdir = STRBUF_INIT;
+			char *name = xmemdupz(wtname, wtname_len);
+			struct reftable_backend *be;
+
+			be = strmap_get(&refs->worktree_backends, name);
+			if (!be) {
+				CALLOC_ARRAY(be, 1);
+				get_common_dir_noenv(&wtdir, refs->base.gitdir);
+				strbuf_addf(&wtdir, "/worktrees/%s", name);
+				if (open_backend(refs, wtdir.buf, be)) {
+					free(be->dir);
+					FREE_AND_NULL(be);
+				} else {
+					strmap_put(&refs->worktree_backends,
+						   name, be);
+				}
+				strbuf_release(&wtdir);
+			}
+			free(name);
+			return be;
+		}
+		return &refs->main_backend;
+	case REF_TYPE_NORMAL:
+		return &refs->main_backend;
+	default:
+		BUG("unknown ref type %d of ref %s", ref_type(refname), refname);
+	}
+}
+
+static struct ref_store *reftable_be_init(struct repository *repo,
+					  const char *gitdir,
+					  unsigned int store_flags)
+{
+	struct reftable_ref_store *refs = xcalloc(1, sizeof(*refs));
+	struct strbuf common_dir = STRBUF_INIT;
+	int lock_timeout_ms = 100;
+	mode_t mask;
+
+	base_ref_store_init(&refs->base, repo, gitdir, &refs_be_reftable);
+	strmap_init(&refs->worktree_backends);
+	refs->store_flags = store_flags;
+	refs->write_options.hash_id = repo->hash_algo->format_id;
+	refs->write_options.skip_name_check = 1;
+	refs->write_options.exact_log_message = 1;
+	/*
+	 * Tables are written via temporary files, which get restrictive
+	 * permissions. Give them those loose refs would get instead.
+	 */
+	mask = umask(0);
+	umask(mask);
+	refs->write_options.default_permissions = 0666 & ~mask;
+	if (get_shared_repository())
+		refs->write_options.default_permissions =
+			calc_shared_perm(refs->write_options.default_permissions);
+	git_config_get_int("reftable.locktimeout", &lock_timeout_ms);
+	refs->write_options.lock_timeout_ms = lock_timeout_ms;
+
+	get_common_dir_noenv(&common_dir, gitdir);
+	refs->err = open_backend(refs, common_dir.buf, &refs->main_backend);
+	if (!refs->err && strcmp(common_dir.buf, gitdir))
+		refs->err = open_backend(refs, gitdir, &refs->worktree_backend);
+	strbuf_release(&common_dir);
+
+	return &refs->base;
+}
+
+static int reftable_be_init_db(struct ref_store *ref_store, struct strbuf *err)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "init_db");
+	struct strbuf sb = STRBUF_INIT;
+
+	strbuf_addf(&sb, "%s/reftable", refs->base.gitdir);
+	safe_create_dir(sb.buf, 1);
+
+	/*
+	 * Older versions of Git, and tools that look for a "HEAD" file
+	 * and a "refs" directory to recognize a repository, must not
+	 * mistake this for a repository using loose refs. Give them an
+	 * invalid HEAD and a "refs/heads" that is not a directory.
+	 */
+	strbuf_reset(&sb);
+	strbuf_addf(&sb, "%s/HEAD", refs->base.gitdir);
+	write_file(sb.buf, "ref: refs/heads/.invalid");
+	adjust_shared_perm(sb.buf);
+
+	strbuf_reset(&sb);
+	strbuf_addf(&sb, "%s/refs", refs->base.gitdir);
+	safe_create_dir(sb.buf, 1);
+	strbuf_addstr(&sb, "/heads");
+	write_file(sb.buf, "this repository uses the reftable format");
+	adjust_shared_perm(sb.buf);
+
+	strbuf_release(&sb);
+	return 0;
+}
+
+/*
+ * Lock "stack" for adding a new table. The stack is reloaded first, so
+ * that the values read while holding the lock are current.
+ */
+static int lock_stack(struct reftable_stack *stack,
+		      struct reftable_addition **addition,
+		      struct strbuf *err)
+{
+	int ret;
+
+	/*
+	 * Reload under the lock, so that updates by other writers that went
+	 * in while we were waiting for it do not make us fail.
+	 */
+	ret = reftable_stack_new_addition(addition, stack,
+					  REFTABLE_STACK_NEW_ADDITION_RELOAD);
+	if (ret > 0)
+		ret = REFTABLE_LOCK_ERROR;
+	if (ret < 0)
+		strbuf_addf(err, _("unable to lock reference database: %s"),
+			    reftable_error_str(ret));
+	return ret;
+}
+
+/*
+ * Commit a table added to a locked stack and compact the stack if it
+ * has become unbalanced.
+ */
+static int commit_stack(struct reftable_stack *stack,
+			struct reftable_addition *addition,
+			struct strbuf *err)
+{
+	int ret = reftable_addition_commit(addition);
+
+	if (ret < 0) {
+		strbuf_addf(err, _("unable to update reference database: %s"),
+			    reftable_error_str(ret));
+		return ret;
+	}
+
+	/*
+	 * Failing to compact is not an error: the refs are written, and
+	 * the next update will try again.
+	 */
+	reftable_stack_auto_compact(stack);
+	return 0;
+}
+
+static int read_ref_without_reload(struct reftable_stack *stack,
+				   const char *refname,
+				   struct object_id *oid,
+				   struct strbuf *referent,
+				   unsigned int *type)
+{
+	struct reftable_ref_record ref = { 0 };
+	int ret;
+
+	ret = reftable_stack_read_ref(stack, refname, &ref);
+	if (ret)
+		goto done;
+
+	if (ref.value_type == REFTABLE_REF_SYMREF) {
+		strbuf_reset(referent);
+		strbuf_addstr(referent, ref.value.symref);
+		*type |= REF_ISSYMREF;
+	} else if (reftable_ref_record_val1(&ref)) {
+		oidread(oid, reftable_ref_record_val1(&ref));
+	} else {
+		/* Deletions are filtered out by reftable_stack_read_ref(). */
+		BUG("unexpected value type %d for ref %s",
+		    ref.value_type, refname);
+	}
+
+done:
+	reftable_ref_record_release(&ref);
+	return ret;
+}
+
+static int reftable_be_read_raw_ref(struct ref_store *ref_store,
+				    const char *refname,
+				    struct object_id *oid,
+				    struct strbuf *referent,
+				    unsigned int *type,
+				    int *failure_errno)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_READ, "read_raw_ref");
+	struct reftable_backend *be;
+	int ret;
+
+	*type = 0;
+	if (refs->err < 0) {
+		*failure_errno = EIO;
+		return -1;
+	}
+
+	be = backend_for(refs, refname, &refname);
+	if (!be || reftable_stack_reload(be->stack) < 0) {
+		*failure_errno = EIO;
+		return -1;
+	}
+
+	ret = read_ref_without_reload(be->stack, refname, oid, referent, type);
+	if (ret) {
+		*failure_errno = ret > 0 ? ENOENT : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Fill in the committer of a reflog entry from the current identity,
+ * which git_committer_info() gives us as a single string.
+ */
+static void fill_log_committer(struct reftable_log_record *log)
+{
+	const char *info = git_committer_info(0);
+	struct ident_split split = { NULL };
+	int sign = 1;
+
+	if (split_ident_line(&split, info, strlen(info)))
+		BUG("unable to split committer ident '%s'", info);
+
+	log->value.update.name =
+		xmemdupz(split.name_begin, split.name_end - split.name_begin);
+	log->value.update.email =
+		xmemdupz(split.mail_begin, split.mail_end - split.mail_begin);
+	log->value.update.time = parse_timestamp(split.date_begin, NULL, 10);
+	if (*split.tz_begin == '-') {
+		sign = -1;
+		split.tz_begin++;
+	} else if (*split.tz_begin == '+') {
+		split.tz_begin++;
+	}
+	log->value.update.tz_offset = sign * atoi(split.tz_begin);
+}
+
+/*
+ * Log records queued for writing. Each record owns all of its strings
+ * and hashes.
+ */
+struct reftable_log_list {
+	struct reftable_log_record *logs;
+	size_t nr, alloc;
+};
+
+static struct reftable_log_record *
+new_log_record(struct reftable_log_list *list, const char *refname,
+	       uint64_t update_index)
+{
+	struct reftable_log_record *log;
+
+	ALLOC_GROW(list->logs, list->nr + 1, list->alloc);
+	log = &list->logs[list->nr++];
+	memset(log, 0, sizeof(*log));
+	log->refname = xstrdup(refname);
+	log->update_index = update_index;
+	return log;
+}
+
+static void add_log_update(struct reftable_log_list *list, const char *refname,
+			   uint64_t update_index,
+			   const struct object_id *old_oid,
+			   const struct object_id *new_oid, const char *msg)
+{
+	struct reftable_log_record *log =
+		new_log_record(list, refname, update_index);
+
+	log->value_type = REFTABLE_LOG_UPDATE;
+	fill_log_committer(log);
+	log->value.update.old_hash = xmemdupz(old_oid->hash, GIT_MAX_RAWSZ);
+	log->value.update.new_hash = xmemdupz(new_oid->hash, GIT_MAX_RAWSZ);
+	/* Like the files backend, store the message with its newline. */
+	log->value.update.message = xstrfmt("%s\n", msg ? msg : "");
+}
+
+/*
+ * Queue a tombstone for each reflog entry of "refname" in "stack".
+ */
+static int add_log_deletions(struct reftable_log_list *list,
+			     struct reftable_stack *stack,
+			     const char *refname)
+{
+	struct reftable_merged_table *mt = reftable_stack_merged_table(stack);
+	struct reftable_log_record log = { NULL };
+	struct reftable_iterator it = { NULL };
+	int ret;
+
+	ret = reftable_merged_table_seek_log(mt, &it, refname);
+	while (!ret) {
+		ret = reftable_iterator_next_log(&it, &log);
+		if (ret)
+			break;
+		if (strcmp(log.refname, refname)) {
+			ret = 1;
+			break;
+		}
+
+		new_log_record(list, refname, log.update_index)->value_type =
+			REFTABLE_LOG_DELETION;
+	}
+
+	reftable_log_record_release(&log);
+	reftable_iterator_destroy(&it);
+	return ret < 0 ? ret : 0;
+}
+
+static void clear_log_list(struct reftable_log_list *list)
+{
+	size_t i;
+
+	for (i = 0; i < list->nr; i++)
+		reftable_log_record_release(&list->logs[i]);
+	FREE_AND_NULL(list->logs);
+	list->nr = list->alloc = 0;
+}
+
+static int reflog_exists_without_reload(struct reftable_stack *stack,
+					const char *refname)
+{
+	struct reftable_log_record log = { NULL };
+	int ret = reftable_stack_read_log(stack, refname, &log);
+
+	reftable_log_record_release(&log);
+	return !ret;
+}
+
+/*
+ * Return whether an update of "refname" should be logged, because the
+ * ref has a reflog or core.logAllRefUpdates asks for one.
+ */
+static int should_write_log(struct reftable_stack *stack, const char *refname)
+{
+	if (log_all_ref_updates == LOG_REFS_UNSET)
+		log_all_ref_updates = is_bare_repository() ? LOG_REFS_NONE : LOG_REFS_NORMAL;
+
+	return should_autocreate_reflog(refname) ||
+	       reflog_exists_without_reload(stack, refname);
+}
+
+/*
+ * Fill in "ref" to point "refname" at "oid", recording the peeled
+ * value as well if "oid" is a tag so that iterating callers can peel
+ * without reading the object.
+ */
+static void fill_ref_record(struct reftable_ref_record *ref,
+			    const char *refname, uint64_t update_index,
+			    const struct object_id *oid,
+			    struct object_id *peeled)
+{
+	memset(ref, 0, sizeof(*ref));
+	ref->refname = (char *)refname;
+	ref->update_index = update_index;
+	if (is_null_oid(oid)) {
+		ref->value_type = REFTABLE_REF_DELETION;
+	} else if (peel_object(oid, peeled) == PEEL_PEELED) {
+		ref->value_type = REFTABLE_REF_VAL2;
+		ref->value.val2.value = (uint8_t *)oid->hash;
+		ref->value.val2.target_value = peeled->hash;
+	} else {
+		ref->value_type = REFTABLE_REF_VAL1;
+		ref->value.val1 = (uint8_t *)oid->hash;
+	}
+}
+
+/* Per-update state of a transaction; see ref_update::backend_data. */
+struct reftable_update_data {
+	struct reftable_stack *stack;
+	const char *rewritten_ref;
+
+	/* The value of the ref, or its referent, when it was locked. */
+	struct object_id current_oid;
+	struct object_id peeled;
+	int exists;
+};
+
+/* Everything a transaction writes to one stack. */
+struct write_transaction_table_arg {
+	struct reftable_ref_store *refs;
+	struct reftable_stack *stack;
+	struct reftable_addition *addition;
+	struct ref_update **updates;
+	size_t updates_nr, updates_alloc;
+};
+
+struct reftable_transaction_data {
+	struct write_transaction_table_arg *args;
+	size_t args_nr, args_alloc;
+};
+
+static struct write_transaction_table_arg *
+transaction_arg_for(struct reftable_ref_store *refs,
+		    struct reftable_transaction_data *tx_data,
+		    struct reftable_stack *stack,
+		    struct strbuf *err)
+{
+	struct write_transaction_table_arg *arg;
+	size_t i;
+
+	for (i = 0; i < tx_data->args_nr; i++)
+		if (tx_data->args[i].stack == stack)
+			return &tx_data->args[i];
+
+	ALLOC_GROW(tx_data->args, tx_data->args_nr + 1, tx_data->args_alloc);
+	arg = &tx_data->args[tx_data->args_nr];
+	memset(arg, 0, sizeof(*arg));
+	arg->refs = refs;
+	arg->stack = stack;
+	if (lock_stack(stack, &arg->addition, err) < 0)
+		return NULL;
+	tx_data->args_nr++;
+	return arg;
+}
+
+static void reftable_transaction_cleanup(struct ref_transaction *transaction)
+{
+	struct reftable_transaction_data *tx_data = transaction->backend_data;
+	size_t i;
+
+	for (i = 0; i < transaction->nr; i++)
+		FREE_AND_NULL(transaction->updates[i]->backend_data);
+
+	if (tx_data) {
+		for (i = 0; i < tx_data->args_nr; i++) {
+			reftable_addition_destroy(tx_data->args[i].addition);
+			free(tx_data->args[i].updates);
+		}
+		free(tx_data->args);
+		FREE_AND_NULL(transaction->backend_data);
+	}
+
+	transaction->state = REF_TRANSACTION_CLOSED;
+}
+
+/*
+ * Return the refname under which update was originally requested.
+ */
+static const char *original_update_refname(struct ref_update *update)
+{
+	while (update->parent_update)
+		update = update->parent_update;
+
+	return update->refname;
+}
+
+/*
+ * Check whether the REF_HAVE_OLD and old_oid values stored in update
+ * are consistent with oid, which is the reference's current value. If
+ * everything is OK, return 0; otherwise, write an error message to
+ * err and return -1.
+ */
+static int check_old_oid(struct ref_update *update, struct object_id *oid,
+			 struct strbuf *err)
+{
+	if (!(update->flags & REF_HAVE_OLD) ||
+		   oideq(oid, &update->old_oid))
+		return 0;
+
+	if (is_null_oid(&update->old_oid))
+		strbuf_addf(err, "cannot lock ref '%s': "
+			    "reference already exists",
+			    original_update_refname(update));
+	else if (is_null_oid(oid))
+		strbuf_addf(err, "cannot lock ref '%s': "
+			    "reference is missing but expected %s",
+			    original_update_refname(update),
+			    oid_to_hex(&update->old_oid));
+	else
+		strbuf_addf(err, "cannot lock ref '%s': "
+			    "is at %s but expected %s",
+			    original_update_refname(update),
+			    oid_to_hex(oid),
+			    oid_to_hex(&update->old_oid));
+
+	return -1;
+}
+
+static int check_new_object(struct reftable_ref_store *refs,
+			    struct ref_update *update,
+			    struct strbuf *err)
+{
+	struct object *o;
+
+	if (!(update->flags & REF_HAVE_NEW) ||
+	    (update->flags & (REF_LOG_ONLY | REF_SKIP_OID_VERIFICATION)) ||
+	    is_null_oid(&update->new_oid))
+		return 0;
+
+	o = parse_object(refs->base.repo, &update->new_oid);
+	if (!o)
+		strbuf_addf(err, "cannot update ref '%s': "
+			    "trying to write ref '%s' with nonexistent object %s",
+			    update->refname, update->refname,
+			    oid_to_hex(&update->new_oid));
+	else if (o->type != OBJ_COMMIT && is_branch(update->refname))
+		strbuf_addf(err, "cannot update ref '%s': "
+			    "trying to write non-commit object %s to branch '%s'",
+			    update->refname, oid_to_hex(&update->new_oid),
+			    update->refname);
+	else
+		return 0;
+	return -1;
+}
+
+/*
+ * Add "update" to the table written to its stack, locking that stack
+ * if this is the first update for it.
+ */
+static int queue_transaction_update(struct reftable_ref_store *refs,
+				    struct reftable_transaction_data *tx_data,
+				    struct ref_update *update,
+				    struct strbuf *err)
+{
+	struct reftable_update_data *data;
+	struct write_transaction_table_arg *arg;
+	struct reftable_backend *be;
+	const char *rewritten_ref;
+
+	be = backend_for(refs, update->refname, &rewritten_ref);
+	if (!be) {
+		strbuf_addf(err, _("unable to open reference database for '%s'"),
+			    update->refname);
+		return TRANSACTION_GENERIC_ERROR;
+	}
+
+	arg = transaction_arg_for(refs, tx_data, be->stack, err);
+	if (!arg)
+		return TRANSACTION_GENERIC_ERROR;
+
+	CALLOC_ARRAY(data, 1);
+	data->stack = be->stack;
+	data->rewritten_ref = rewritten_ref;
+	update->backend_data = data;
+
+	ALLOC_GROW(arg->updates, arg->updates_nr + 1, arg->updates_alloc);
+	arg->updates[arg->updates_nr++] = update;
+	return 0;
+}
+
+static int reftable_be_transaction_prepare(struct ref_store *ref_store,
+					   struct ref_transaction *transaction,
+					   struct strbuf *err)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE|REF_STORE_MAIN,
+				  "ref_transaction_prepare");
+	struct string_list affected_refnames = STRING_LIST_INIT_NODUP;
+	struct strbuf referent = STRBUF_INIT, head_referent = STRBUF_INIT;
+	struct reftable_transaction_data *tx_data;
+	struct reftable_stack *head_stack;
+	const char *head_name;
+	unsigned int head_type = 0;
+	size_t i;
+	int ret = 0;
+
+	if (refs->err < 0) {
+		strbuf_addf(err, _("unable to open reference database: %s"),
+			    reftable_error_str(refs->err));
+		ret = TRANSACTION_GENERIC_ERROR;
+		goto done;
+	}
+
+	CALLOC_ARRAY(tx_data, 1);
+	transaction->backend_data = tx_data;
+
+	/*
+	 * Fail if a refname appears more than once in the transaction.
+	 * Updates added below for symrefs and HEAD check this on their
+	 * own.
+	 */
+	for (i = 0; i < transaction->nr; i++)
+		string_list_append(&affected_refnames,
+				   transaction->updates[i]->refname);
+	string_list_sort(&affected_refnames);
+	if (ref_update_reject_duplicates(&affected_refnames, err)) {
+		ret = TRANSACTION_GENERIC_ERROR;
+		goto done;
+	}
+
+	/*
+	 * Lock all stacks we are going to write to, so that the values
+	 * we check and record below cannot change under us.
+	 */
+	for (i = 0; i < transaction->nr; i++) {
+		ret = queue_transaction_update(refs, tx_data,
+					       transaction->updates[i], err);
+		if (ret)
+			goto done;
+	}
+
+	/*
+	 * As in the files backend, an update of the branch HEAD points
+	 * to is logged in the reflog of HEAD, too.
+	 */
+	head_stack = backend_for(refs, "HEAD", &head_name)->stack;
+	if (reftable_stack_reload(head_stack) < 0 ||
+	    read_ref_without_reload(head_stack, head_name, &(struct object_id){ 0 },
+				    &head_referent, &head_type) < 0) {
+		strbuf_addstr(err, _("unable to read HEAD"));
+		ret = TRANSACTION_GENERIC_ERROR;
+		goto done;
+	}
+	if (!(head_type & REF_ISSYMREF))
+		strbuf_reset(&head_referent);
+
+	/*
+	 * Note that more updates are appended to the transaction while
+	 * we go, for HEAD and for the referents of symrefs.
+	 */
+	for (i = 0; i < transaction->nr; i++) {
+		struct ref_update *update = transaction->updates[i];
+		struct reftable_update_data *data = update->backend_data;
+		struct ref_update *parent;
+
+		if (head_referent.len &&
+		    !(update->flags & (REF_LOG_ONLY | REF_UPDATE_VIA_HEAD)) &&
+		    !strcmp(update->refname, head_referent.buf)) {
+			struct ref_update *head_update;
+
+			if (string_list_has_string(&affected_refnames, "HEAD")) {
+				strbuf_addf(err,
+					    _("multiple updates for 'HEAD' (including one "
+					    "via its referent '%s') are not allowed"),
+					    update->refname);
+				ret = TRANSACTION_NAME_CONFLICT;
+				goto done;
+			}
+
+			head_update = ref_transaction_add_update(
+					transaction, "HEAD",
+					update->flags | REF_LOG_ONLY | REF_NO_DEREF,
+					&update->new_oid, &update->old_oid,
+					update->msg);
+			string_list_insert(&affected_refnames,
+					   head_update->refname);
+			ret = queue_transaction_update(refs, tx_data,
+						       head_update, err);
+			if (ret)
+				goto done;
+		}
+
+		ret = read_ref_without_reload(data->stack, data->rewritten_ref,
+					      &data->current_oid, &referent,
+					      &update->type);
+		if (ret < 0) {
+			strbuf_addf(err, _("cannot lock ref '%s': %s"),
+				    original_update_refname(update),
+				    reftable_error_str(ret));
+			ret = TRANSACTION_GENERIC_ERROR;
+			goto done;
+		}
+		data->exists = !ret;
+		ret = 0;
+
+		if (!data->exists && (update->flags & REF_HAVE_OLD) &&
+		    !is_null_oid(&update->old_oid)) {
+			strbuf_addf(err, "cannot lock ref '%s': "
+				    "unable to resolve reference '%s'",
+				    original_update_refname(update),
+				    update->refname);
+			ret = TRANSACTION_GENERIC_ERROR;
+			goto done;
+		}
+
+		if (!data->exists && (update->flags & REF_HAVE_NEW) &&
+		    !is_null_oid(&update->new_oid) &&
+		    refs_verify_refname_available(ref_store, update->refname,
+						  &affected_refnames, NULL,
+						  err)) {
+			ret = TRANSACTION_NAME_CONFLICT;
+			goto done;
+		}
+
+		if (update->type & REF_ISSYMREF) {
+			if (update->flags & REF_NO_DEREF) {
+				/*
+				 * The referent is not part of the
+				 * transaction, so read it here to check
+				 * and log the old value.
+				 */
+				if (!refs_resolve_ref_unsafe(ref_store, referent.buf,
+							     0, &data->current_oid,
+							     NULL)) {
+					if (update->flags & REF_HAVE_OLD) {
+						strbuf_addf(err, "cannot lock ref '%s': "
+							    "error reading reference",
+							    original_update_refname(update));
+						ret = TRANSACTION_GENERIC_ERROR;
+						goto done;
+					}
+				} else if (check_old_oid(update, &data->current_oid, err)) {
+					ret = TRANSACTION_GENERIC_ERROR;
+					goto done;
+				}
+			} else {
+				/*
+				 * Split the update into a log-only update
+				 * of the symref and an update of its
+				 * referent, which is checked when we get
+				 * to it.
+				 */
+				struct ref_update *new_update;
+				unsigned int new_flags = update->flags;
+
+				if (string_list_has_string(&affected_refnames,
+							   referent.buf)) {
+					strbuf_addf(err,
+						    _("multiple updates for '%s' (including one "
+						    "via symref '%s') are not allowed"),
+						    referent.buf, update->refname);
+					ret = TRANSACTION_NAME_CONFLICT;
+					goto done;
+				}
+
+				if (!strcmp(update->refname, "HEAD"))
+					new_flags |= REF_UPDATE_VIA_HEAD;
+
+				new_update = ref_transaction_add_update(
+						transaction, referent.buf, new_flags,
+						&update->new_oid, &update->old_oid,
+						update->msg);
+				new_update->parent_update = update;
+
+				update->flags |= REF_LOG_ONLY | REF_NO_DEREF;
+				update->flags &= ~REF_HAVE_OLD;
+
+				string_list_insert(&affected_refnames,
+						   new_update->refname);
+				ret = queue_transaction_update(refs, tx_data,
+							       new_update, err);
+				if (ret)
+					goto done;
+			}
+		} else {
+			if (check_old_oid(update, &data->current_oid, err)) {
+				ret = TRANSACTION_GENERIC_ERROR;
+				goto done;
+			}
+
+			/*
+			 * Record the old value in the symrefs that led
+			 * here for their reflogs.
+			 */
+			for (parent = update->parent_update; parent;
+			     parent = parent->parent_update) {
+				struct reftable_update_data *parent_data =
+					parent->backend_data;
+				oidcpy(&parent_data->current_oid,
+				       &data->current_oid);
+			}
+		}
+
+		if (check_new_object(refs, update, err)) {
+			ret = TRANSACTION_GENERIC_ERROR;
+			goto done;
+		}
+	}
+
+	transaction->state = REF_TRANSACTION_PREPARED;
+
+done:
+	if (ret)
+		reftable_transaction_cleanup(transaction);
+	string_list_clear(&affected_refnames, 0);
+	strbuf_release(&referent);
+	strbuf_release(&head_referent);
+	return ret;
+}
+
+static int reftable_be_transaction_abort(struct ref_store *ref_store,
+					 struct ref_transaction *transaction,
+					 struct strbuf *err)
+{
+	reftable_transaction_cleanup(transaction);
+	return 0;
+}
+
+static int write_transaction_table(struct reftable_writer *writer,
+				   void *cb_data)
+{
+	struct write_transaction_table_arg *arg = cb_data;
+	uint64_t ts = reftable_stack_next_update_index(arg->stack);
+	struct reftable_ref_record *ref_records;
+	struct reftable_log_list logs = { NULL };
+	size_t i, refs_nr = 0;
+	int ret = 0;
+
+	CALLOC_ARRAY(ref_records, arg->updates_nr);
+	reftable_writer_set_limits(writer, ts, ts);
+
+	for (i = 0; i < arg->updates_nr; i++) {
+		struct ref_update *update = arg->updates[i];
+		struct reftable_update_data *data = update->backend_data;
+		const char *refname = data->rewritten_ref;
+		int write_ref = 0, deleting;
+
+		if ((update->flags & REF_HAVE_NEW) &&
+		    !(update->flags & REF_LOG_ONLY)) {
+			/*
+			 * Like the files backend, neither write nor log
+			 * a ref whose value does not change, unless it
+			 * is a symref to be overwritten.
+			 */
+			if (update->type & REF_ISSYMREF)
+				write_ref = 1;
+			else if (!oideq(&data->current_oid, &update->new_oid))
+				write_ref = 1;
+		}
+		deleting = write_ref && is_null_oid(&update->new_oid);
+
+		if (write_ref)
+			fill_ref_record(&ref_records[refs_nr++], refname, ts,
+					&update->new_oid, &data->peeled);
+
+		if (deleting) {
+			/* The reflog of a ref goes away with the ref. */
+			ret = add_log_deletions(&logs, arg->stack, refname);
+			if (ret < 0)
+				goto done;
+		} else if ((write_ref || (update->flags & REF_LOG_ONLY)) &&
+			   ((update->flags & REF_FORCE_CREATE_REFLOG) ||
+			    should_write_log(arg->stack, refname))) {
+			add_log_update(&logs, refname, ts, &data->current_oid,
+				       &update->new_oid, update->msg);
+		}
+	}
+
+	ret = reftable_writer_add_refs(writer, ref_records, refs_nr);
+	if (ret < 0)
+		goto done;
+	ret = reftable_writer_add_logs(writer, logs.logs, logs.nr);
+
+done:
+	free(ref_records);
+	clear_log_list(&logs);
+	return ret;
+}
+
+static int reftable_be_transaction_finish(struct ref_store *ref_store,
+					  struct ref_transaction *transaction,
+					  struct strbuf *err)
+{
+	struct reftable_transaction_data *tx_data = transaction->backend_data;
+	size_t i;
+	int ret = 0;
+
+	for (i = 0; tx_data && i < tx_data->args_nr; i++) {
+		struct write_transaction_table_arg *arg = &tx_data->args[i];
+
+		ret = reftable_addition_add(arg->addition,
+					    write_transaction_table, arg);
+		if (ret < 0) {
+			strbuf_addf(err, _("unable to write references: %s"),
+				    reftable_error_str(ret));
+			ret = TRANSACTION_GENERIC_ERROR;
+			goto done;
+		}
+
+		ret = commit_stack(arg->stack, arg->addition, err);
+		reftable_addition_destroy(arg->addition);
+		arg->addition = NULL;
+		if (ret < 0) {
+			ret = TRANSACTION_GENERIC_ERROR;
+			goto done;
+		}
+	}
+
+done:
+	reftable_transaction_cleanup(transaction);
+	return ret;
+}
+
+static int reftable_be_initial_transaction_commit(struct ref_store *ref_store,
+						  struct ref_transaction *transaction,
+						  struct strbuf *err)
+{
+	int ret = reftable_be_transaction_prepare(ref_store, transaction, err);
+
+	if (ret)
+		return ret;
+	return reftable_be_transaction_finish(ref_store, transaction, err);
+}
+
+static int reftable_be_pack_refs(struct ref_store *ref_store, unsigned int flags)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "pack_refs");
+	int ret;
+
+	if (refs->err < 0)
+		return refs->err;
+
+	ret = reftable_stack_compact_all(refs->main_backend.stack, NULL);
+	if (!ret && refs->worktree_backend.stack)
+		ret = reftable_stack_compact_all(refs->worktree_backend.stack,
+						 NULL);
+	if (ret)
+		return error(_("unable to compact reference database: %s"),
+			     reftable_error_str(ret));
+	return 0;
+}
+
+struct write_create_symref_arg {
+	struct reftable_stack *stack;
+	const char *refname;
+	const char *target;
+	const char *logmsg;
+	struct object_id old_oid, new_oid;
+	int log;
+};
+
+static int write_create_symref_table(struct reftable_writer *writer,
+				     void *cb_data)
+{
+	struct write_create_symref_arg *arg = cb_data;
+	uint64_t ts = reftable_stack_next_update_index(arg->stack);
+	struct reftable_ref_record ref = {
+		.refname = (char *)arg->refname,
+		.value_type = REFTABLE_REF_SYMREF,
+		.value.symref = (char *)arg->target,
+		.update_index = ts,
+	};
+	struct reftable_log_list logs = { NULL };
+	int ret;
+
+	reftable_writer_set_limits(writer, ts, ts);
+
+	ret = reftable_writer_add_ref(writer, &ref);
+	if (!ret && arg->log) {
+		add_log_update(&logs, arg->refname, ts, &arg->old_oid,
+			       &arg->new_oid, arg->logmsg);
+		ret = reftable_writer_add_logs(writer, logs.logs, logs.nr);
+	}
+
+	clear_log_list(&logs);
+	return ret;
+}
+
+static int reftable_be_create_symref(struct ref_store *ref_store,
+				     const char *refname,
+				     const char *target,
+				     const char *logmsg)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "create_symref");
+	struct write_create_symref_arg arg = {
+		.target = target,
+		.logmsg = logmsg,
+	};
+	struct reftable_backend *be;
+	struct reftable_addition *addition = NULL;
+	struct strbuf err = STRBUF_INIT;
+	int ret;
+
+	if (refs->err < 0)
+		return error(_("unable to open reference database: %s"),
+			     reftable_error_str(refs->err));
+
+	be = backend_for(refs, refname, &arg.refname);
+	if (!be)
+		return error(_("unable to open reference database for '%s'"),
+			     refname);
+	arg.stack = be->stack;
+	ret = lock_stack(arg.stack, &addition, &err);
+	if (ret < 0)
+		goto done;
+
+	/* As in the files backend, only log when the target resolves. */
+	if (logmsg &&
+	    refs_resolve_ref_unsafe(ref_store, target, RESOLVE_REF_READING,
+				    &arg.new_oid, NULL) &&
+	    should_write_log(arg.stack, arg.refname)) {
+		if (!refs_resolve_ref_unsafe(ref_store, refname, 0,
+					     &arg.old_oid, NULL))
+			oidclr(&arg.old_oid);
+		arg.log = 1;
+	}
+
+	ret = reftable_addition_add(addition, write_create_symref_table, &arg);
+	if (ret < 0) {
+		strbuf_addf(&err, _("unable to write symref for %s: %s"),
+			    refname, reftable_error_str(ret));
+		goto done;
+	}
+	ret = commit_stack(arg.stack, addition, &err);
+
+done:
+	reftable_addition_destroy(addition);
+	if (ret < 0)
+		ret = error("%s", err.buf);
+	strbuf_release(&err);
+	return ret;
+}
+
+static int reftable_be_delete_refs(struct ref_store *ref_store, const char *msg,
+				   struct string_list *refnames,
+				   unsigned int flags)
+{
+	struct ref_transaction *transaction;
+	struct strbuf err = STRBUF_INIT;
+	struct string_list_item *item;
+	int ret = 0;
+
+	if (!refnames->nr)
+		return 0;
+
+	/* All refs go away in a single table, hence atomically. */
+	transaction = ref_store_transaction_begin(ref_store, 0, &err);
+	if (!transaction) {
+		ret = -1;
+		goto done;
+	}
+
+	for_each_string_list_item(item, refnames) {
+		ret = ref_transaction_delete(transaction, item->string, NULL,
+					     flags, msg, &err);
+		if (ret)
+			goto done;
+	}
+
+	ret = ref_transaction_commit(transaction, &err);
+
+done:
+	if (ret) {
+		if (refnames->nr == 1)
+			error(_("could not delete reference %s: %s"),
+			      refnames->items[0].string, err.buf);
+		else
+			error(_("could not delete references: %s"), err.buf);
+		ret = -1;
+	}
+	ref_transaction_free(transaction);
+	strbuf_release(&err);
+	return ret;
+}
+
+struct write_copy_arg {
+	struct reftable_stack *stack;
+	const char *oldname;
+	const char *newname;
+	const char *logmsg;
+	struct object_id oid;
+	int delete_old;
+	int log_head;
+};
+
+static int write_copy_table(struct reftable_writer *writer, void *cb_data)
+{
+	struct write_copy_arg *arg = cb_data;
+	uint64_t ts = reftable_stack_next_update_index(arg->stack);
+	struct reftable_merged_table *mt = reftable_stack_merged_table(arg->stack);
+	struct reftable_ref_record refs[2];
+	struct reftable_log_record old_log = { NULL };
+	struct reftable_iterator it = { NULL };
+	struct reftable_log_list logs = { NULL };
+	struct object_id peeled;
+	size_t refs_nr = 0, i;
+	int copied_log = 0, ret;
+
+	reftable_writer_set_limits(writer, ts, ts);
+
+	/*
+	 * Moving a ref onto itself leaves everything as it is, except
+	 * for the entry we log.
+	 */
+	if (!strcmp(arg->oldname, arg->newname)) {
+		goto write;
+	}
+
+	/*
+	 * The new ref takes over the value of the old one, as does its
+	 * reflog, replacing whatever either had before.
+	 */
+	fill_ref_record(&refs[refs_nr++], arg->newname, ts, &arg->oid, &peeled);
+	if (arg->delete_old)
+		fill_ref_record(&refs[refs_nr++], arg->oldname, ts,
+				null_oid(), NULL);
+
+	ret = add_log_deletions(&logs, arg->stack, arg->newname);
+	if (ret < 0)
+		goto done;
+	if (arg->delete_old) {
+		ret = add_log_deletions(&logs, arg->stack, arg->oldname);
+		if (ret < 0)
+			goto done;
+	}
+
+	ret = reftable_merged_table_seek_log(mt, &it, arg->oldname);
+	while (!ret) {
+		struct reftable_log_record *log;
+
+		ret = reftable_iterator_next_log(&it, &old_log);
+		if (ret)
+			break;
+		if (strcmp(old_log.refname, arg->oldname)) {
+			ret = 1;
+			break;
+		}
+
+		if (old_log.value_type != REFTABLE_LOG_UPDATE)
+			continue;
+
+		/*
+		 * The copy keeps the update index of the original, so
+		 * it replaces a tombstone queued for the new name.
+		 */
+		for (i = 0; i < logs.nr; i++) {
+			log = &logs.logs[i];
+			if (log->update_index == old_log.update_index &&
+			    !strcmp(log->refname, arg->newname))
+				break;
+		}
+		if (i < logs.nr) {
+			reftable_log_record_release(log);
+			log->refname = xstrdup(arg->newname);
+			log->update_index = old_log.update_index;
+		} else {
+			log = new_log_record(&logs, arg->newname,
+					     old_log.update_index);
+		}
+
+		/* Steal the values; "old_log" is reused by the iterator. */
+		log->value_type = REFTABLE_LOG_UPDATE;
+		log->value.update = old_log.value.update;
+		memset(&old_log.value.update, 0, sizeof(old_log.value.update));
+		copied_log = 1;
+	}
+	if (ret < 0)
+		goto done;
+
+write:
+	if (copied_log || should_write_log(arg->stack, arg->newname))
+		add_log_update(&logs, arg->newname, ts, &arg->oid, &arg->oid,
+			       arg->logmsg);
+
+	/*
+	 * Like any deletion of the branch HEAD points to, moving it away
+	 * is logged for HEAD. The caller points HEAD to the new name.
+	 */
+	if (arg->log_head)
+		add_log_update(&logs, "HEAD", ts, &arg->oid, null_oid(),
+			       arg->logmsg);
+
+	ret = reftable_writer_add_refs(writer, refs, refs_nr);
+	if (ret < 0)
+		goto done;
+	ret = reftable_writer_add_logs(writer, logs.logs, logs.nr);
+
+done:
+	reftable_iterator_destroy(&it);
+	reftable_log_record_release(&old_log);
+	clear_log_list(&logs);
+	return ret;
+}
+
+static int reftable_be_copy_or_rename_ref(struct ref_store *ref_store,
+					  const char *oldrefname,
+					  const char *newrefname,
+					  const char *logmsg, int delete_old)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "rename_ref");
+	struct write_copy_arg arg = {
+		.logmsg = logmsg,
+		.delete_old = delete_old,
+	};
+	struct reftable_backend *be;
+	struct reftable_addition *addition = NULL;
+	struct string_list skip = STRING_LIST_INIT_NODUP;
+	struct strbuf referent = STRBUF_INIT, err = STRBUF_INIT;
+	unsigned int type = 0;
+	int ret;
+
+	if (refs->err < 0)
+		return error(_("unable to open reference database: %s"),
+			     reftable_error_str(refs->err));
+
+	be = backend_for(refs, oldrefname, &arg.oldname);
+	if (!be || be != backend_for(refs, newrefname, &arg.newname))
+		return error(_("cannot move '%s' to '%s' across worktrees"),
+			     oldrefname, newrefname);
+	arg.stack = be->stack;
+
+	ret = lock_stack(arg.stack, &addition, &err);
+	if (ret < 0) {
+		ret = error("%s", err.buf);
+		goto done;
+	}
+
+	ret = read_ref_without_reload(arg.stack, arg.oldname, &arg.oid,
+				      &referent, &type);
+	if (ret) {
+		ret = error("refname %s not found", oldrefname);
+		goto done;
+	}
+	if (type & REF_ISSYMREF) {
+		if (delete_old)
+			ret = error("refname %s is a symbolic ref, renaming it is not supported",
+				    oldrefname);
+		else
+			ret = error("refname %s is a symbolic ref, copying it is not supported",
+				    oldrefname);
+		goto done;
+	}
+
+	if (delete_old && strcmp(arg.oldname, arg.newname)) {
+		const char *head_name;
+
+		type = 0;
+		if (backend_for(refs, "HEAD", &head_name) == be &&
+		    should_write_log(arg.stack, head_name) &&
+		    !read_ref_without_reload(arg.stack, head_name,
+					     &(struct object_id){ 0 },
+					     &referent, &type) &&
+		    (type & REF_ISSYMREF) && !strcmp(referent.buf, arg.oldname))
+			arg.log_head = 1;
+	}
+
+	/* A renamed ref makes way for the new name, a copied one does not. */
+	if (delete_old)
+		string_list_insert(&skip, oldrefname);
+	if (refs_verify_refname_available(ref_store, newrefname, NULL,
+					  &skip, &err)) {
+		ret = error("%s", err.buf);
+		goto done;
+	}
+
+	ret = reftable_addition_add(addition, write_copy_table, &arg);
+	if (ret < 0) {
+		ret = error(_("unable to write reference '%s': %s"),
+			    newrefname, reftable_error_str(ret));
+		goto done;
+	}
+	ret = commit_stack(arg.stack, addition, &err);
+	if (ret < 0)
+		ret = error("%s", err.buf);
+
+done:
+	reftable_addition_destroy(addition);
+	string_list_clear(&skip, 0);
+	strbuf_release(&referent);
+	strbuf_release(&err);
+	return ret;
+}
+
+static int reftable_be_rename_ref(struct ref_store *ref_store,
+				  const char *oldrefname, const char *newrefname,
+				  const char *logmsg)
+{
+	return reftable_be_copy_or_rename_ref(ref_store, oldrefname,
+					      newrefname, logmsg, 1);
+}
+
+static int reftable_be_copy_ref(struct ref_store *ref_store,
+				const char *oldrefname, const char *newrefname,
+				const char *logmsg)
+{
+	return reftable_be_copy_or_rename_ref(ref_store, oldrefname,
+					      newrefname, logmsg, 0);
+}
+
+struct reftable_ref_iterator {
+	struct ref_iterator base;
+	struct reftable_ref_store *refs;
+	struct reftable_stack *snapshot;
+	struct reftable_iterator iter;
+	struct reftable_ref_record ref;
+	struct object_id oid;
+	char *prefix;
+	unsigned int flags;
+
+	/*
+	 * Skip per-worktree refs, which in a linked worktree are
+	 * stored in its own stack and not in the main one.
+	 */
+	int skip_per_worktree;
+};
+
+static int reftable_ref_iterator_advance(struct ref_iterator *ref_iterator)
+{
+	struct reftable_ref_iterator *iter =
+		(struct reftable_ref_iterator *)ref_iterator;
+	struct reftable_ref_store *refs = iter->refs;
+	int ret;
+
+	while (!(ret = reftable_iterator_next_ref(&iter->iter, &iter->ref))) {
+		const char *refname = iter->ref.refname;
+		int flags = 0;
+
+		if (!starts_with(refname, iter->prefix))
+			break;
+
+		/* Like loose refs, only refs under "refs/" are iterated. */
+		if (!starts_with(refname, "refs/"))
+			continue;
+
+		if ((iter->flags & DO_FOR_EACH_PER_WORKTREE_ONLY) &&
+		    ref_type(refname) != REF_TYPE_PER_WORKTREE)
+			continue;
+		if (iter->skip_per_worktree &&
+		    ref_type(refname) == REF_TYPE_PER_WORKTREE)
+			continue;
+
+		switch (iter->ref.value_type) {
+		case REFTABLE_REF_VAL1:
+		case REFTABLE_REF_VAL2:
+			oidread(&iter->oid, reftable_ref_record_val1(&iter->ref));
+			break;
+		case REFTABLE_REF_SYMREF:
+			if (!refs_resolve_ref_unsafe(&refs->base, refname,
+						     RESOLVE_REF_READING,
+						     &iter->oid, &flags))
+				oidclr(&iter->oid);
+			break;
+		default:
+			BUG("unexpected value type %d for ref %s",
+			    iter->ref.value_type, refname);
+		}
+
+		if (is_null_oid(&iter->oid))
+			flags |= REF_ISBROKEN;
+
+		if (check_refname_format(refname, REFNAME_ALLOW_ONELEVEL)) {
+			if (!refname_is_safe(refname))
+				die(_("refname is dangerous: %s"), refname);
+			oidclr(&iter->oid);
+			flags |= REF_BAD_NAME | REF_ISBROKEN;
+		}
+
+		if ((iter->flags & DO_FOR_EACH_OMIT_DANGLING_SYMREFS) &&
+		    (flags & REF_ISSYMREF) && (flags & REF_ISBROKEN))
+			continue;
+
+		if (!(iter->flags & DO_FOR_EACH_INCLUDE_BROKEN) &&
+		    !ref_resolves_to_object(refname, refs->base.repo,
+					    &iter->oid, flags))
+			continue;
+
+		iter->base.refname = refname;
+		iter->base.oid = &iter->oid;
+		iter->base.flags = flags;
+		return ITER_OK;
+	}
+
+	if (ret < 0) {
+		error(_("unable to read references: %s"),
+		      reftable_error_str(ret));
+		ref_iterator_abort(ref_iterator);
+		return ITER_ERROR;
+	}
+
+	if (ref_iterator_abort(ref_iterator) != ITER_DONE)
+		return ITER_ERROR;
+	return ITER_DONE;
+}
+
+static int reftable_ref_iterator_peel(struct ref_iterator *ref_iterator,
+				      struct object_id *peeled)
+{
+	struct reftable_ref_iterator *iter =
+		(struct reftable_ref_iterator *)ref_iterator;
+
+	if (iter->ref.value_type == REFTABLE_REF_VAL2) {
+		oidread(peeled, iter->ref.value.val2.target_value);
+		return 0;
+	}
+
+	return peel_object(ref_iterator->oid, peeled) ? -1 : 0;
+}
+
+static int reftable_ref_iterator_abort(struct ref_iterator *ref_iterator)
+{
+	struct reftable_ref_iterator *iter =
+		(struct reftable_ref_iterator *)ref_iterator;
+
+	reftable_ref_record_release(&iter->ref);
+	reftable_iterator_destroy(&iter->iter);
+	if (iter->snapshot)
+		reftable_stack_destroy(iter->snapshot);
+	free(iter->prefix);
+	base_ref_iterator_free(ref_iterator);
+	return ITER_DONE;
+}
+
+static struct ref_iterator_vtable reftable_ref_iterator_vtable = {
+	.advance = reftable_ref_iterator_advance,
+	.peel = reftable_ref_iterator_peel,
+	.abort = reftable_ref_iterator_abort
+};
+
+static struct ref_iterator *
+ref_iterator_for_backend(struct reftable_ref_store *refs,
+			 struct reftable_backend *be,
+			 const char *prefix, unsigned int flags,
+			 int skip_per_worktree)
+{
+	struct reftable_ref_iterator *iter;
+	struct reftable_merged_table *mt;
+	int ret;
+
+	CALLOC_ARRAY(iter, 1);
+	base_ref_iterator_init(&iter->base, &reftable_ref_iterator_vtable, 1);
+	iter->refs = refs;
+	iter->prefix = xstrdup(prefix);
+	iter->flags = flags;
+	iter->skip_per_worktree = skip_per_worktree;
+
+	ret = open_snapshot(refs, be, &iter->snapshot);
+	if (!ret) {
+		mt = reftable_stack_merged_table(iter->snapshot);
+		ret = reftable_merged_table_seek_ref(mt, &iter->iter, prefix);
+	}
+	if (ret) {
+		error(_("unable to read references: %s"),
+		      reftable_error_str(ret));
+		ref_iterator_abort(&iter->base);
+		return empty_ref_iterator_begin();
+	}
+
+	return &iter->base;
+}
+
+static struct ref_iterator *reftable_be_iterator_begin(struct ref_store *ref_store,
+						      const char *prefix,
+						      unsigned int flags)
+{
+	struct reftable_ref_store *refs;
+	struct ref_iterator *main_iter, *worktree_iter;
+	unsigned int required_flags = REF_STORE_READ;
+
+	if (!(flags & DO_FOR_EACH_INCLUDE_BROKEN))
+		required_flags |= REF_STORE_ODB;
+	refs = reftable_downcast(ref_store, required_flags, "ref_iterator_begin");
+
+	if (refs->err < 0) {
+		error(_("unable to open reference database: %s"),
+		      reftable_error_str(refs->err));
+		return empty_ref_iterator_begin();
+	}
+
+	main_iter = ref_iterator_for_backend(refs, &refs->main_backend,
+					     prefix, flags,
+					     !!refs->worktree_backend.stack);
+	if (!refs->worktree_backend.stack)
+		return main_iter;
+
+	worktree_iter = ref_iterator_for_backend(refs, &refs->worktree_backend,
+						 prefix, flags, 0);
+	return overlay_ref_iterator_begin(worktree_iter, main_iter);
+}
+
+struct reftable_reflog_iterator {
+	struct ref_iterator base;
+	struct reftable_ref_store *refs;
+	struct reftable_stack *snapshot;
+	struct reftable_iterator iter;
+	struct reftable_log_record log;
+	struct object_id oid;
+	char *last_name;
+	int only_per_worktree, skip_per_worktree;
+};
+
+static int reftable_reflog_iterator_advance(struct ref_iterator *ref_iterator)
+{
+	struct reftable_reflog_iterator *iter =
+		(struct reftable_reflog_iterator *)ref_iterator;
+	int ret;
+
+	while (!(ret = reftable_iterator_next_log(&iter->iter, &iter->log))) {
+		int flags;
+
+		/* There is one record per entry, but we want each log once. */
+		if (iter->last_name && !strcmp(iter->log.refname, iter->last_name))
+			continue;
+		free(iter->last_name);
+		iter->last_name = xstrdup(iter->log.refname);
+
+		if (iter->only_per_worktree &&
+		    ref_type(iter->last_name) != REF_TYPE_PER_WORKTREE)
+			continue;
+		if (iter->skip_per_worktree &&
+		    ref_type(iter->last_name) == REF_TYPE_PER_WORKTREE)
+			continue;
+
+		if (!refs_resolve_ref_unsafe(&iter->refs->base, iter->last_name,
+					     0, &iter->oid, &flags)) {
+			error("bad ref for %s", iter->last_name);
+			continue;
+		}
+
+		iter->base.refname = iter->last_name;
+		iter->base.oid = &iter->oid;
+		iter->base.flags = flags;
+		return ITER_OK;
+	}
+
+	if (ret < 0) {
+		error(_("unable to read reflogs: %s"), reftable_error_str(ret));
+		ref_iterator_abort(ref_iterator);
+		return ITER_ERROR;
+	}
+
+	if (ref_iterator_abort(ref_iterator) != ITER_DONE)
+		return ITER_ERROR;
+	return ITER_DONE;
+}
+
+static int reftable_reflog_iterator_peel(struct ref_iterator *ref_iterator,
+					 struct object_id *peeled)
+{
+	BUG("ref_iterator_peel() called for reflog_iterator");
+}
+
+static int reftable_reflog_iterator_abort(struct ref_iterator *ref_iterator)
+{
+	struct reftable_reflog_iterator *iter =
+		(struct reftable_reflog_iterator *)ref_iterator;
+
+	reftable_log_record_release(&iter->log);
+	reftable_iterator_destroy(&iter->iter);
+	if (iter->snapshot)
+		reftable_stack_destroy(iter->snapshot);
+	free(iter->last_name);
+	base_ref_iterator_free(ref_iterator);
+	return ITER_DONE;
+}
+
+static struct ref_iterator_vtable reftable_reflog_iterator_vtable = {
+	.advance = reftable_reflog_iterator_advance,
+	.peel = reftable_reflog_iterator_peel,
+	.abort = reftable_reflog_iterator_abort
+};
+
+static struct ref_iterator *
+reflog_iterator_for_backend(struct reftable_ref_store *refs,
+			    struct reftable_backend *be,
+			    int only_per_worktree, int skip_per_worktree)
+{
+	struct reftable_reflog_iterator *iter;
+	int ret;
+
+	CALLOC_ARRAY(iter, 1);
+	base_ref_iterator_init(&iter->base, &reftable_reflog_iterator_vtable, 1);
+	iter->refs = refs;
+	iter->only_per_worktree = only_per_worktree;
+	iter->skip_per_worktree = skip_per_worktree;
+
+	ret = open_snapshot(refs, be, &iter->snapshot);
+	if (!ret)
+		ret = reftable_merged_table_seek_log(
+				reftable_stack_merged_table(iter->snapshot),
+				&iter->iter, "");
+	if (ret) {
+		error(_("unable to read reflogs: %s"), reftable_error_str(ret));
+		ref_iterator_abort(&iter->base);
+		return empty_ref_iterator_begin();
+	}
+
+	return &iter->base;
+}
+
+static struct ref_iterator *reftable_be_reflog_iterator_begin(struct ref_store *ref_store)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_READ,
+				  "reflog_iterator_begin");
+	struct ref_iterator *main_iter, *worktree_iter;
+
+	if (refs->err < 0)
+		return empty_ref_iterator_begin();
+
+	main_iter = reflog_iterator_for_backend(refs, &refs->main_backend, 0,
+						!!refs->worktree_backend.stack);
+	if (!refs->worktree_backend.stack)
+		return main_iter;
+
+	worktree_iter = reflog_iterator_for_backend(refs, &refs->worktree_backend,
+						    1, 0);
+	return overlay_ref_iterator_begin(worktree_iter, main_iter);
+}
+
+/*
+ * Call "fn" for the entries of the reflog of "refname", newest first,
+ * and return what the last call returned, or -1 if there is no such
+ * reflog.
+ */
+static int for_each_reflog_ent_newest_first(struct reftable_ref_store *refs,
+					    const char *refname,
+					    each_reflog_ent_fn fn,
+					    void *cb_data)
+{
+	struct reftable_backend *be;
+	struct reftable_stack *snapshot = NULL;
+	struct reftable_iterator it = { NULL };
+	struct reftable_log_record log = { NULL };
+	struct strbuf committer = STRBUF_INIT;
+	int found = 0, ret;
+
+	if (refs->err < 0)
+		return refs->err;
+
+	be = backend_for(refs, refname, &refname);
+	if (!be)
+		return -1;
+	ret = open_snapshot(refs, be, &snapshot);
+	if (!ret)
+		ret = reftable_merged_table_seek_log(
+				reftable_stack_merged_table(snapshot),
+				&it, refname);
+	if (ret)
+		goto done;
+
+	while (1) {
+		struct object_id old_oid, new_oid;
+
+		ret = reftable_iterator_next_log(&it, &log);
+		if (ret < 0)
+			goto done;
+		if (ret > 0 || strcmp(log.refname, refname)) {
+			ret = found ? 0 : -1;
+			break;
+		}
+		found = 1;
+
+		oidread(&old_oid, log.value.update.old_hash);
+		oidread(&new_oid, log.value.update.new_hash);
+
+		/* Skip the record that only marks the reflog as existing. */
+		if (is_null_oid(&old_oid) && is_null_oid(&new_oid))
+			continue;
+
+		strbuf_reset(&committer);
+		strbuf_addf(&committer, "%s <%s>", log.value.update.name,
+			    log.value.update.email);
+		ret = fn(&old_oid, &new_oid, committer.buf,
+			 log.value.update.time, log.value.update.tz_offset,
+			 log.value.update.message, cb_data);
+		if (ret)
+			break;
+	}
+
+done:
+	reftable_log_record_release(&log);
+	reftable_iterator_destroy(&it);
+	if (snapshot)
+		reftable_stack_destroy(snapshot);
+	strbuf_release(&committer);
+	return ret;
+}
+
+static int reftable_be_for_each_reflog_ent_reverse(struct ref_store *ref_store,
+						   const char *refname,
+						   each_reflog_ent_fn fn,
+						   void *cb_data)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_READ,
+				  "for_each_reflog_ent_reverse");
+
+	return for_each_reflog_ent_newest_first(refs, refname, fn, cb_data);
+}
+
+struct reflog_entry {
+	struct object_id old_oid, new_oid;
+	char *committer;
+	timestamp_t timestamp;
+	int tz;
+	char *msg;
+};
+
+struct reflog_entries {
+	struct reflog_entry *entries;
+	size_t nr, alloc;
+};
+
+static int collect_reflog_entry(struct object_id *old_oid,
+				struct object_id *new_oid,
+				const char *committer, timestamp_t timestamp,
+				int tz, const char *msg, void *cb_data)
+{
+	struct reflog_entries *list = cb_data;
+	struct reflog_entry *e;
+
+	ALLOC_GROW(list->entries, list->nr + 1, list->alloc);
+	e = &list->entries[list->nr++];
+	oidcpy(&e->old_oid, old_oid);
+	oidcpy(&e->new_oid, new_oid);
+	e->committer = xstrdup(committer);
+	e->timestamp = timestamp;
+	e->tz = tz;
+	e->msg = xstrdup(msg);
+	return 0;
+}
+
+static void clear_reflog_entries(struct reflog_entries *list)
+{
+	size_t i;
+
+	for (i = 0; i < list->nr; i++) {
+		free(list->entries[i].committer);
+		free(list->entries[i].msg);
+	}
+	FREE_AND_NULL(list->entries);
+	list->nr = list->alloc = 0;
+}
+
+static int reftable_be_for_each_reflog_ent(struct ref_store *ref_store,
+					   const char *refname,
+					   each_reflog_ent_fn fn,
+					   void *cb_data)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_READ,
+				  "for_each_reflog_ent");
+	struct reflog_entries list = { NULL };
+	size_t i;
+	int ret;
+
+	/*
+	 * Tables store the newest entry of a log first, so collect the
+	 * entries to hand them out oldest first.
+	 */
+	ret = for_each_reflog_ent_newest_first(refs, refname,
+					       collect_reflog_entry, &list);
+	for (i = list.nr; !ret && i > 0; i--) {
+		struct reflog_entry *e = &list.entries[i - 1];
+
+		ret = fn(&e->old_oid, &e->new_oid, e->committer,
+			 e->timestamp, e->tz, e->msg, cb_data);
+	}
+
+	clear_reflog_entries(&list);
+	return ret;
+}
+
+static int reftable_be_reflog_exists(struct ref_store *ref_store,
+				     const char *refname)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_READ, "reflog_exists");
+	struct reftable_backend *be;
+
+	if (refs->err < 0)
+		return 0;
+
+	be = backend_for(refs, refname, &refname);
+	if (!be || reftable_stack_reload(be->stack) < 0)
+		return 0;
+	return reflog_exists_without_reload(be->stack, refname);
+}
+
+struct write_reflog_arg {
+	struct reftable_stack *stack;
+	const char *refname;
+	int delete;
+};
+
+static int write_reflog_table(struct reftable_writer *writer, void *cb_data)
+{
+	struct write_reflog_arg *arg = cb_data;
+	uint64_t ts = reftable_stack_next_update_index(arg->stack);
+	struct reftable_log_list logs = { NULL };
+	int ret;
+
+	reftable_writer_set_limits(writer, ts, ts);
+
+	if (arg->delete) {
+		ret = add_log_deletions(&logs, arg->stack, arg->refname);
+		if (ret < 0)
+			goto done;
+	} else {
+		/*
+		 * An empty reflog is recorded as an entry whose old and
+		 * new values are both null, which readers skip.
+		 */
+		add_log_update(&logs, arg->refname, ts, null_oid(), null_oid(),
+			       NULL);
+	}
+	ret = reftable_writer_add_logs(writer, logs.logs, logs.nr);
+
+done:
+	clear_log_list(&logs);
+	return ret;
+}
+
+static int write_reflog(struct reftable_ref_store *refs, const char *refname,
+			int delete, struct strbuf *err)
+{
+	struct write_reflog_arg arg = { .delete = delete };
+	struct reftable_addition *addition = NULL;
+	struct reftable_backend *be;
+	int ret;
+
+	if (refs->err < 0) {
+		strbuf_addf(err, _("unable to open reference database: %s"),
+			    reftable_error_str(refs->err));
+		return -1;
+	}
+
+	be = backend_for(refs, refname, &arg.refname);
+	if (!be) {
+		strbuf_addf(err, _("unable to open reference database for '%s'"),
+			    refname);
+		return -1;
+	}
+	arg.stack = be->stack;
+
+	ret = lock_stack(arg.stack, &addition, err);
+	if (ret < 0)
+		goto done;
+
+	if (reflog_exists_without_reload(arg.stack, arg.refname) == delete) {
+		ret = reftable_addition_add(addition, write_reflog_table, &arg);
+		if (ret < 0) {
+			strbuf_addf(err, _("unable to write reflog for '%s': %s"),
+				    refname, reftable_error_str(ret));
+			goto done;
+		}
+		ret = commit_stack(arg.stack, addition, err);
+	}
+
+done:
+	reftable_addition_destroy(addition);
+	return ret < 0 ? -1 : 0;
+}
+
+static int reftable_be_create_reflog(struct ref_store *ref_store,
+				     const char *refname,
+				     struct strbuf *err)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "create_reflog");
+
+	return write_reflog(refs, refname, 0, err);
+}
+
+static int reftable_be_delete_reflog(struct ref_store *ref_store,
+				     const char *refname)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "delete_reflog");
+	struct strbuf err = STRBUF_INIT;
+	int ret = write_reflog(refs, refname, 1, &err);
+
+	if (ret)
+		error("%s", err.buf);
+	strbuf_release(&err);
+	return ret;
+}
+
+struct write_reflog_expiry_arg {
+	struct reftable_stack *stack;
+	const char *refname;
+	struct reftable_log_list *logs;
+	struct object_id update_oid;
+	int update_ref;
+};
+
+static int write_reflog_expiry_table(struct reftable_writer *writer,
+				     void *cb_data)
+{
+	struct write_reflog_expiry_arg *arg = cb_data;
+	uint64_t ts = reftable_stack_next_update_index(arg->stack);
+	struct reftable_ref_record ref;
+	struct object_id peeled;
+	int ret;
+
+	reftable_writer_set_limits(writer, ts, ts);
+
+	if (arg->update_ref) {
+		fill_ref_record(&ref, arg->refname, ts, &arg->update_oid,
+				&peeled);
+		ret = reftable_writer_add_ref(writer, &ref);
+		if (ret < 0)
+			return ret;
+	}
+
+	return reftable_writer_add_logs(writer, arg->logs->logs, arg->logs->nr);
+}
+
+/*
+ * Read the entries of the reflog of "refname" from "stack", newest
+ * first, into "list".
+ */
+static int read_reflog_records(struct reftable_stack *stack,
+			       const char *refname,
+			       struct reftable_log_list *list)
+{
+	struct reftable_merged_table *mt = reftable_stack_merged_table(stack);
+	struct reftable_log_record log = { NULL };
+	struct reftable_iterator it = { NULL };
+	int ret;
+
+	ret = reftable_merged_table_seek_log(mt, &it, refname);
+	while (!ret) {
+		ret = reftable_iterator_next_log(&it, &log);
+		if (ret)
+			break;
+		if (strcmp(log.refname, refname)) {
+			ret = 1;
+			break;
+		}
+
+		ALLOC_GROW(list->logs, list->nr + 1, list->alloc);
+		list->logs[list->nr++] = log;
+		memset(&log, 0, sizeof(log));
+	}
+
+	reftable_log_record_release(&log);
+	reftable_iterator_destroy(&it);
+	return ret < 0 ? ret : 0;
+}
+
+static int reftable_be_reflog_expire(struct ref_store *ref_store,
+				     const char *refname,
+				     unsigned int expire_flags,
+				     reflog_expiry_prepare_fn prepare_fn,
+				     reflog_expiry_should_prune_fn should_prune_fn,
+				     reflog_expiry_cleanup_fn cleanup_fn,
+				     void *policy_cb_data)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_WRITE, "reflog_expire");
+	struct write_reflog_expiry_arg arg = { NULL };
+	struct reftable_log_list entries = { NULL }, out = { NULL };
+	struct reftable_addition *addition = NULL;
+	struct reftable_backend *be;
+	struct strbuf committer = STRBUF_INIT, referent = STRBUF_INIT;
+	struct strbuf err = STRBUF_INIT;
+	struct object_id oid, last_kept = { 0 };
+	int rewrite = !!(expire_flags & EXPIRE_REFLOGS_REWRITE);
+	int kept = 0, ret;
+	size_t i;
+
+	if (refs->err < 0)
+		return error(_("unable to open reference database: %s"),
+			     reftable_error_str(refs->err));
+
+	be = backend_for(refs, refname, &arg.refname);
+	if (!be)
+		return error(_("unable to open reference database for '%s'"),
+			     refname);
+	arg.stack = be->stack;
+	arg.logs = &out;
+
+	/*
+	 * Holding the lock on the stack keeps the ref and its reflog
+	 * from changing while we decide what to expire.
+	 */
+	ret = lock_stack(arg.stack, &addition, &err);
+	if (ret < 0) {
+		ret = error("cannot lock ref '%s': %s", refname, err.buf);
+		goto done;
+	}
+
+	/* Somebody else deleted the reflog; that is fine with us. */
+	if (!reflog_exists_without_reload(arg.stack, arg.refname))
+		goto done;
+
+	ret = read_reflog_records(arg.stack, arg.refname, &entries);
+	if (ret < 0) {
+		ret = error(_("unable to read reflog for '%s': %s"),
+			    refname, reftable_error_str(ret));
+		goto done;
+	}
+
+	if (!refs_resolve_ref_unsafe(ref_store, refname, 0, &oid, NULL))
+		oidclr(&oid);
+	prepare_fn(refname, &oid, policy_cb_data);
+
+	for (i = entries.nr; i > 0; i--) {
+		struct reftable_log_record *log = &entries.logs[i - 1];
+		struct object_id orig_old_oid, old_oid, new_oid;
+
+		if (log->value_type != REFTABLE_LOG_UPDATE)
+			continue;
+		oidread(&orig_old_oid, log->value.update.old_hash);
+		oidread(&new_oid, log->value.update.new_hash);
+		if (is_null_oid(&orig_old_oid) && is_null_oid(&new_oid))
+			continue;
+		oidcpy(&old_oid, rewrite ? &last_kept : &orig_old_oid);
+
+		strbuf_reset(&committer);
+		strbuf_addf(&committer, "%s <%s>", log->value.update.name,
+			    log->value.update.email);
+		if (should_prune_fn(&old_oid, &new_oid, committer.buf,
+				    log->value.update.time,
+				    log->value.update.tz_offset,
+				    log->value.update.message,
+				    policy_cb_data)) {
+			new_log_record(&out, arg.refname, log->update_index)->value_type =
+				REFTABLE_LOG_DELETION;
+			continue;
+		}
+
+		kept = 1;
+		if (rewrite && !oideq(&orig_old_oid, &last_kept)) {
+			struct reftable_log_record *rewritten =
+				new_log_record(&out, arg.refname,
+					       log->update_index);
+
+			rewritten->value_type = REFTABLE_LOG_UPDATE;
+			rewritten->value.update = log->value.update;
+			memset(&log->value.update, 0, sizeof(log->value.update));
+			memcpy(rewritten->value.update.old_hash, last_kept.hash,
+			       the_hash_algo->rawsz);
+		}
+		oidcpy(&last_kept, &new_oid);
+	}
+	cleanup_fn(policy_cb_data);
+
+	if (expire_flags & EXPIRE_REFLOGS_DRY_RUN)
+		goto done;
+
+	/*
+	 * The files backend leaves an empty reflog behind when all of
+	 * its entries expire; mark ours as existing in the same way.
+	 */
+	if (!kept && out.nr)
+		add_log_update(&out, arg.refname,
+			       reftable_stack_next_update_index(arg.stack),
+			       null_oid(), null_oid(), NULL);
+
+	/*
+	 * It doesn't make sense to adjust a reference pointed to by a
+	 * symbolic ref based on expiring entries in the symbolic
+	 * reference's reflog. Nor can we update a reference if there
+	 * are no remaining reflog entries.
+	 */
+	if ((expire_flags & EXPIRE_REFLOGS_UPDATE_REF) &&
+	    !is_null_oid(&last_kept)) {
+		unsigned int type = 0;
+
+		if (!read_ref_without_reload(arg.stack, arg.refname,
+					     &arg.update_oid, &referent, &type) &&
+		    !(type & REF_ISSYMREF) &&
+		    !oideq(&arg.update_oid, &last_kept)) {
+			oidcpy(&arg.update_oid, &last_kept);
+			arg.update_ref = 1;
+		}
+	}
+
+	if (!out.nr && !arg.update_ref)
+		goto done;
+
+	ret = reftable_addition_add(addition, write_reflog_expiry_table, &arg);
+	if (ret < 0) {
+		ret = error(_("unable to write reflog for '%s': %s"),
+			    refname, reftable_error_str(ret));
+		goto done;
+	}
+	ret = commit_stack(arg.stack, addition, &err);
+	if (ret < 0)
+		ret = error("%s", err.buf);
+
+done:
+	reftable_addition_destroy(addition);
+	clear_log_list(&entries);
+	clear_log_list(&out);
+	strbuf_release(&committer);
+	strbuf_release(&referent);
+	strbuf_release(&err);
+	return ret;
+}
+
+/*
+ * Every update adds a table with a new, unique name to "tables.list",
+ * and compacting replaces tables by others with new names, so the
+ * contents of that file tell which state the stack is in.
+ */
+static int tables_list_generation_token(struct strbuf *token,
+					struct reftable_backend *be)
+{
+	struct strbuf path = STRBUF_INIT;
+	int ret = 0;
+
+	strbuf_addf(&path, "%s/tables.list", be->dir);
+	strbuf_addf(token, "%s\n", path.buf);
+	if (strbuf_read_file(token, path.buf, 0) < 0 && errno != ENOENT)
+		ret = -1;
+	strbuf_release(&path);
+	return ret;
+}
+
+static int reftable_be_generation_token(struct ref_store *ref_store,
+					struct strbuf *token)
+{
+	struct reftable_ref_store *refs =
+		reftable_downcast(ref_store, REF_STORE_READ, "generation_token");
+
+	if (refs->err)
+		return -1;
+	if (tables_list_generation_token(token, &refs->main_backend))
+		return -1;
+	if (refs->worktree_backend.stack &&
+	    tables_list_generation_token(token, &refs->worktree_backend))
+		return -1;
+	return 0;
+}
+
+struct ref_storage_be refs_be_reftable = {
+	.name = "reftable",
+	.init = reftable_be_init,
+	.init_db = reftable_be_init_db,
+	.transaction_prepare = reftable_be_transaction_prepare,
+	.transaction_finish = reftable_be_transaction_finish,
+	.transaction_abort = reftable_be_transaction_abort,
+	.initial_transaction_commit = reftable_be_initial_transaction_commit,
+
+	.pack_refs = reftable_be_pack_refs,
+	.create_symref = reftable_be_create_symref,
+	.delete_refs = reftable_be_delete_refs,
+	.rename_ref = reftable_be_rename_ref,
+	.copy_ref = reftable_be_copy_ref,
+
+	.iterator_begin = reftable_be_iterator_begin,
+	.read_raw_ref = reftable_be_read_raw_ref,
+
+	.reflog_iterator_begin = reftable_be_reflog_iterator_begin,
+	.for_each_reflog_ent = reftable_be_for_each_reflog_ent,
+	.for_each_reflog_ent_reverse = reftable_be_for_each_reflog_ent_reverse,
+	.reflog_exists = reftable_be_reflog_exists,
+	.create_reflog = reftable_be_create_reflog,
+	.delete_reflog = reftable_be_delete_reflog,
+	.reflog_expire = reftable_be_reflog_expire,
+
+	.generation_token = reftable_be_generation_token,
+};
@@ -280,6 +280,10 @@ struct restart_find_args {
 	struct block_reader *r;
 };
 
+/*
+ * Returns whether the wanted key sorts before the key at restart point `idx`,
+ * which is what binsearch() needs to find the first restart point past it.
+ */
 static int restart_key_less(size_t idx, void *args)
 {
 	struct restart_find_args *a = args;
@@ -288,22 +292,35 @@ static int restart_key_less(size_t idx, void *args)
 		.buf = a->r->block.data + off,
 		.len = a->r->block_len - off,
 	};
+	uint64_t prefix_len, suffix_len;
+	int n, result;
+
+	/*
+	 * Keys at restart points are stored verbatim, so compare against the
+	 * block data directly instead of decoding them into a buffer.
+	 */
+	n = get_var_int(&prefix_len, &in);
+	if (n < 0 || prefix_len)
+		goto corrupt;
+	string_view_consume(&in, n);
 
-	/* the restart key is verbatim in the block, so this could avoid the
-	   alloc for decoding the key */
-	struct strbuf rkey = STRBUF_INIT;
-	struct strbuf last_key = STRBUF_INIT;
-	uint8_t unused_extra;
-	int n = reftable_decode_key(&rkey, &unused_extra, last_key, in);
-	int result;
-	if (n < 0) {
-		a->error = 1;
-		return -1;
-	}
-
-	result = strbuf_cmp(&a->key, &rkey);
-	strbuf_release(&rkey);
-	return result;
+	n = get_var_int(&suffix_len, &in);
+	if (n <= 0)
+		goto corrupt;
+	string_view_consume(&in, n);
+	suffix_len >>= 3;
+	if (in.len < suffix_len)
+		goto corrupt;
+
+	result = memcmp(a->key.buf, in.buf,
+			a->key.len < suffix_len ? a->key.len : suffix_len);
+	if (!result)
+		return a->key.len < suffix_len;
+	return result < 0;
+
+corrupt:
+	a->error = 1;
+	return 0;
 }
 
 void block_iter_copy_from(struct block_iter *dest, struct block_iter *src)
@@ -0,0 +1,257 @@
+/*
+Copyright 2020 Google LLC
+
+Use of this source code is governed by a BSD-style
+license that can be found in the LICENSE file or at
+https://developers.google.com/open-source/licenses/bsd
+*/
+
+#include "blockcache.h"
+
+#include "system.h"
+#include "basics.h"
+
+struct block_cache_entry {
+	struct reftable_reader *reader;
+	uint64_t off;
+
+	/* chain of entries in the same hash bucket. */
+	struct block_cache_entry *next;
+
+	/* least recently used entries are at the tail. */
+	struct block_cache_entry *lru_prev, *lru_next;
+
+	/* block reader as initialized from the block; owns the block. */
+	struct block_reader br;
+
+	/* number of block readers currently using the block. */
+	int refcount;
+
+	/* set when the entry was dropped from the cache while in use. */
+	int detached;
+};
+
+struct block_cache {
+	uint64_t capacity;
+	uint64_t bytes;
+
+	struct block_cache_entry **buckets;
+	size_t buckets_len;
+	size_t entries;
+
+	struct block_cache_entry *lru_head, *lru_tail;
+
+	uint64_t hits, misses, evictions;
+};
+
+static void entry_free(struct block_cache_entry *e)
+{
+	reftable_block_done(&e->br.block);
+	reftable_free(e);
+}
+
+static void cache_return_block(void *arg, struct reftable_block *block)
+{
+	struct block_cache_entry *e = arg;
+
+	if (--e->refcount == 0 && e->detached)
+		entry_free(e);
+}
+
+static struct reftable_block_source_vtable cache_vtable = {
+	.return_block = &cache_return_block,
+};
+
+static size_t bucket_for(struct block_cache *cache, struct reftable_reader *r,
+			 uint64_t off)
+{
+	/*
+	 * Block offsets are multiples of the block size, so their low bits
+	 * carry no information. Multiply to spread the key over the high
+	 * bits, and take the bucket from those.
+	 */
+	uint64_t h = ((uint64_t)(uintptr_t)r ^ off) * 0x9e3779b97f4a7c15ULL;
+	return (h >> 32) & (cache->buckets_len - 1);
+}
+
+static void lru_unlink(struct block_cache *cache, struct block_cache_entry *e)
+{
+	if (e->lru_prev)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		cache->lru_head = e->lru_next;
+	if (e->lru_next)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		cache->lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_push(struct block_cache *cache, struct block_cache_entry *e)
+{
+	e->lru_prev = NULL;
+	e->lru_next = cache->lru_head;
+	if (cache->lru_head)
+		cache->lru_head->lru_prev = e;
+	cache->lru_head = e;
+	if (!cache->lru_tail)
+		cache->lru_tail = e;
+}
+
+static void bucket_unlink(struct block_cache *cache,
+			  struct block_cache_entry *e)
+{
+	struct block_cache_entry **pp =
+		&cache->buckets[bucket_for(cache, e->reader, e->off)];
+
+	while (*pp != e)
+		pp = &(*pp)->next;
+	*pp = e->next;
+	e->next = NULL;
+}
+
+/* Drop `e` from the cache, freeing it unless it is still in use. */
+static void cache_drop(struct block_cache *cache, struct block_cache_entry *e)
+{
+	bucket_unlink(cache, e);
+	lru_unlink(cache, e);
+	cache->bytes -= e->br.block.len;
+	cache->entries--;
+
+	if (e->refcount)
+		e->detached = 1;
+	else
+		entry_free(e);
+}
+
+static void cache_grow(struct block_cache *cache)
+{
+	struct block_cache_entry **old = cache->buckets;
+	size_t old_len = cache->buckets_len;
+	size_t i;
+
+	cache->buckets_len = old_len ? 2 * old_len : 64;
+	cache->buckets = reftable_calloc(sizeof(*cache->buckets) *
+					 cache->buckets_len);
+
+	for (i = 0; i < old_len; i++) {
+		struct block_cache_entry *e = old[i];
+		while (e) {
+			struct block_cache_entry *next = e->next;
+			size_t b = bucket_for(cache, e->reader, e->off);
+			e->next = cache->buckets[b];
+			cache->buckets[b] = e;
+			e = next;
+		}
+	}
+	reftable_free(old);
+}
+
+static struct block_cache_entry *cache_find(struct block_cache *cache,
+					    struct reftable_reader *r,
+					    uint64_t off)
+{
+	struct block_cache_entry *e;
+
+	for (e = cache->buckets[bucket_for(cache, r, off)]; e; e = e->next)
+		if (e->reader == r && e->off == off)
+			return e;
+	return NULL;
+}
+
+struct block_cache *block_cache_new(uint64_t capacity)
+{
+	struct block_cache *cache = reftable_calloc(sizeof(*cache));
+	cache->capacity = capacity;
+	cache_grow(cache);
+	return cache;
+}
+
+void block_cache_free(struct block_cache *cache)
+{
+	if (!cache)
+		return;
+
+	while (cache->lru_head)
+		cache_drop(cache, cache->lru_head);
+	reftable_free(cache->buckets);
+	reftable_free(cache);
+}
+
+int block_cache_get(struct block_cache *cache, struct reftable_reader *r,
+		    uint64_t off, struct block_reader *br)
+{
+	struct block_cache_entry *e = cache_find(cache, r, off);
+
+	if (!e) {
+		cache->misses++;
+		return 0;
+	}
+	cache->hits++;
+
+	lru_unlink(cache, e);
+	lru_push(cache, e);
+
+	*br = e->br;
+	br->block.source.ops = &cache_vtable;
+	br->block.source.arg = e;
+	e->refcount++;
+	return 1;
+}
+
+void block_cache_put(struct block_cache *cache, struct reftable_reader *r,
+		     uint64_t off, struct block_reader *br)
+{
+	struct block_cache_entry *e;
+
+	if (br->block.len > cache->capacity || cache_find(cache, r, off))
+		return;
+
+	e = reftable_calloc(sizeof(*e));
+	e->reader = r;
+	e->off = off;
+	e->br = *br;
+	e->refcount = 1;
+
+	br->block.source.ops = &cache_vtable;
+	br->block.source.arg = e;
+
+	if (cache->entries >= 2 * cache->buckets_len)
+		cache_grow(cache);
+
+	{
+		size_t b = bucket_for(cache, r, off);
+		e->next = cache->buckets[b];
+		cache->buckets[b] = e;
+	}
+	lru_push(cache, e);
+	cache->entries++;
+	cache->bytes += e->br.block.len;
+
+	while (cache->bytes > cache->capacity) {
+		cache->evictions++;
+		cache_drop(cache, cache->lru_tail);
+	}
+}
+
+void block_cache_evict_reader(struct block_cache *cache,
+			      struct reftable_reader *r)
+{
+	struct block_cache_entry *e = cache->lru_head;
+
+	while (e) {
+		struct block_cache_entry *next = e->lru_next;
+		if (e->reader == r)
+			cache_drop(cache, e);
+		e = next;
+	}
+}
+
+void block_cache_get_stats(struct block_cache *cache,
+			   struct block_cache_stats *stats)
+{
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->evictions = cache->evictions;
+	stats->bytes = cache->bytes;
+}
@@ -0,0 +1,66 @@
+/*
+Copyright 2020 Google LLC
+
+Use of this source code is governed by a BSD-style
+license that can be found in the LICENSE file or at
+https://developers.google.com/open-source/licenses/bsd
+*/
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "block.h"
+
+struct reftable_reader;
+
+/*
+ * A size-bounded cache of decoded blocks, shared by the readers of a stack.
+ * Blocks are keyed by their reader and offset, and hold the data after log
+ * blocks have been inflated, so that repeated seeks neither re-read nor
+ * re-inflate them.
+ *
+ * Blocks handed out by the cache are reference counted through their block
+ * source: returning the block with reftable_block_done() drops the
+ * reference. A block that is evicted while still in use is freed when its
+ * last user returns it.
+ */
+struct block_cache;
+
+/* Create a cache that keeps up to `capacity` bytes of unused blocks. */
+struct block_cache *block_cache_new(uint64_t capacity);
+
+/*
+ * Free the cache. Blocks that are still in use stay valid until they are
+ * returned.
+ */
+void block_cache_free(struct block_cache *cache);
+
+/*
+ * Look up the block of `r` at offset `off`. On a hit, initialize `br` to
+ * read it and return 1. Return 0 on a miss.
+ */
+int block_cache_get(struct block_cache *cache, struct reftable_reader *r,
+		    uint64_t off, struct block_reader *br);
+
+/*
+ * Add the block that `br` has just been initialized with. The cache takes
+ * over the block, and `br` is pointed at the cached copy.
+ */
+void block_cache_put(struct block_cache *cache, struct reftable_reader *r,
+		     uint64_t off, struct block_reader *br);
+
+/* Drop all blocks belonging to `r`, which is about to be closed. */
+void block_cache_evict_reader(struct block_cache *cache,
+			      struct reftable_reader *r);
+
+struct block_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t bytes;
+};
+
+void block_cache_get_stats(struct block_cache *cache,
+			   struct block_cache_stats *stats);
+
+#endif
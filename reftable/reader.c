@@ -283,10 +283,21 @@ int reader_init_block_reader(struct reftable_reader *r, struct block_reader *br,
 	int err = 0;
 	uint32_t header_off = next_off ? 0 : header_size(r->version);
 	int32_t block_size = 0;
+	int wrong_typ = 0;
 
 	if (next_off >= r->size)
 		return 1;
 
+	if (r->block_cache &&
+	    block_cache_get(r->block_cache, r, next_off, br)) {
+		if (want_typ != BLOCK_TYPE_ANY &&
+		    block_reader_type(br) != want_typ) {
+			reftable_block_done(&br->block);
+			return 1;
+		}
+		return 0;
+	}
+
 	err = reader_get_block(r, &block, next_off, guess_block_size);
 	if (err < 0)
 		goto done;
@@ -299,7 +310,14 @@ int reader_init_block_reader(struct reftable_reader *r, struct block_reader *br,
 	}
 	if (want_typ != BLOCK_TYPE_ANY && block_typ != want_typ) {
 		err = 1;
-		goto done;
+		/*
+		 * A seek that runs off the end of a section asks for the
+		 * block after it every time; cache that block as well so
+		 * that the next seek does not read it again.
+		 */
+		if (!r->block_cache || !reftable_is_block_type(block_typ))
+			goto done;
+		wrong_typ = 1;
 	}
 
 	if (block_size > guess_block_size) {
@@ -312,6 +330,12 @@ int reader_init_block_reader(struct reftable_reader *r, struct block_reader *br,
 
 	err = block_reader_init(br, &block, header_off, r->block_size,
 				hash_size(r->hash_id));
+	if (!err && r->block_cache)
+		block_cache_put(r->block_cache, r, next_off, br);
+	if (!err && wrong_typ) {
+		reftable_block_done(&br->block);
+		err = 1;
+	}
 done:
 	reftable_block_done(&block);
 
@@ -625,6 +649,10 @@ int reftable_reader_seek_log(struct reftable_reader *r,
 
 void reader_close(struct reftable_reader *r)
 {
+	if (r->block_cache) {
+		block_cache_evict_reader(r->block_cache, r);
+		r->block_cache = NULL;
+	}
 	block_source_close(&r->source);
 	FREE_AND_NULL(r->name);
 }
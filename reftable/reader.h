@@ -10,6 +10,7 @@ license that can be found in the LICENSE file or at
 #define READER_H
 
 #include "block.h"
+#include "blockcache.h"
 #include "record.h"
 #include "reftable-iterator.h"
 #include "reftable-reader.h"
@@ -50,6 +51,9 @@ struct reftable_reader {
 	struct reftable_reader_offsets ref_offsets;
 	struct reftable_reader_offsets obj_offsets;
 	struct reftable_reader_offsets log_offsets;
+
+	/* Cache of decoded blocks shared with other readers, or NULL. */
+	struct block_cache *block_cache;
 };
 
 int init_reader(struct reftable_reader *r, struct reftable_block_source *source,
@@ -46,6 +46,19 @@ struct reftable_write_options {
 	 *   is a single line, and add '\n' if missing.
 	 */
 	unsigned exact_log_message : 1;
+
+	/* Number of bytes of decoded blocks that a stack keeps in memory to
+	 * speed up repeated lookups. If unset, use DEFAULT_BLOCK_CACHE_SIZE.
+	 */
+	uint64_t block_cache_size;
+
+	/* boolean: do not cache decoded blocks across lookups. */
+	unsigned skip_block_cache : 1;
+
+	/* How long to wait for a lock held by another process, in
+	 * milliseconds. 0 tries once, and a negative value waits forever.
+	 */
+	long lock_timeout_ms;
 };
 
 /* reftable_block_stats holds statistics for a single block type */
@@ -9,6 +9,8 @@ license that can be found in the LICENSE file or at
 #include "stack.h"
 
 #include "system.h"
+#include "blockcache.h"
+#include "constants.h"
 #include "merged.h"
 #include "reader.h"
 #include "refname.h"
@@ -66,6 +68,10 @@ int reftable_new_stack(struct reftable_stack **dest, const char *dir,
 	p->list_file = strbuf_detach(&list_file_name, NULL);
 	p->reftable_dir = xstrdup(dir);
 	p->config = config;
+	if (!config.skip_block_cache)
+		p->block_cache = block_cache_new(config.block_cache_size ?
+						 config.block_cache_size :
+						 DEFAULT_BLOCK_CACHE_SIZE);
 
 	err = reftable_stack_reload_maybe_reuse(p, 1);
 	if (err < 0) {
@@ -173,6 +179,7 @@ void reftable_stack_destroy(struct reftable_stack *st)
 		st->readers_len = 0;
 		FREE_AND_NULL(st->readers);
 	}
+	block_cache_free(st->block_cache);
 	FREE_AND_NULL(st->list_file);
 	FREE_AND_NULL(st->reftable_dir);
 	reftable_free(st);
@@ -236,6 +243,7 @@ static int reftable_stack_reload_once(struct reftable_stack *st, char **names,
 			err = reftable_new_reader(&rd, &src, name);
 			if (err < 0)
 				goto done;
+			rd->block_cache = st->block_cache;
 		}
 
 		new_readers[new_readers_len] = rd;
@@ -443,6 +451,76 @@ static void format_name(struct strbuf *dest, uint64_t min, uint64_t max)
 	strbuf_addstr(dest, buf);
 }
 
+#define INITIAL_LOCK_BACKOFF_MS 1L
+#define LOCK_BACKOFF_MAX_MULTIPLIER 1000
+
+struct lock_backoff {
+	long timeout_ms;
+	long remaining_ms;
+	int multiplier;
+	int n;
+};
+
+#define LOCK_BACKOFF_INIT(timeout) { (timeout), (timeout), 1, 1 }
+
+/*
+ * Sleep before the next attempt to take a lock, with quadratic backoff like
+ * lockfile.c. Returns 0 without sleeping once the timeout has run out.
+ */
+static int lock_backoff_wait(struct lock_backoff *b)
+{
+	long wait_ms;
+
+	if (!b->timeout_ms || (b->timeout_ms > 0 && b->remaining_ms <= 0))
+		return 0;
+
+	/* back off for between 0.75 and 1.25 times the backoff */
+	wait_ms = (750 + rand() % 500) * b->multiplier *
+		  INITIAL_LOCK_BACKOFF_MS / 1000;
+	sleep_millisec(wait_ms);
+	b->remaining_ms -= wait_ms;
+
+	/* (n+1)^2 = n^2 + 2n + 1 */
+	b->multiplier += 2 * b->n + 1;
+	if (b->multiplier > LOCK_BACKOFF_MAX_MULTIPLIER)
+		b->multiplier = LOCK_BACKOFF_MAX_MULTIPLIER;
+	else
+		b->n++;
+	return 1;
+}
+
+/*
+ * Create the lock file `name`. While somebody else holds it, retry with
+ * quadratic backoff for at least `timeout_ms` milliseconds, the same way
+ * Git's lockfile API does: 0 tries exactly once, and -1 retries forever.
+ *
+ * Returns the file descriptor of the lock, REFTABLE_LOCK_ERROR if the lock
+ * is still taken when giving up, or REFTABLE_IO_ERROR.
+ */
+static int stack_lock_file(struct reftable_stack *st, const char *name,
+			   long timeout_ms)
+{
+	struct lock_backoff backoff = LOCK_BACKOFF_INIT(timeout_ms);
+
+	while (1) {
+		int fd = open(name, O_EXCL | O_CREAT | O_WRONLY, 0666);
+
+		if (fd >= 0) {
+			if (st->config.default_permissions &&
+			    chmod(name, st->config.default_permissions) < 0) {
+				close(fd);
+				unlink(name);
+				return REFTABLE_IO_ERROR;
+			}
+			return fd;
+		}
+		if (errno != EEXIST)
+			return REFTABLE_IO_ERROR;
+		if (!lock_backoff_wait(&backoff))
+			return REFTABLE_LOCK_ERROR;
+	}
+}
+
 struct reftable_addition {
 	int lock_file_fd;
 	struct strbuf lock_file_name;
@@ -459,7 +537,8 @@ struct reftable_addition {
 	}
 
 static int reftable_stack_init_addition(struct reftable_addition *add,
-					struct reftable_stack *st)
+					struct reftable_stack *st,
+					unsigned int flags)
 {
 	int err = 0;
 	add->stack = st;
@@ -468,30 +547,34 @@ static int reftable_stack_init_addition(struct reftable_addition *add,
 	strbuf_addstr(&add->lock_file_name, st->list_file);
 	strbuf_addstr(&add->lock_file_name, ".lock");
 
-	add->lock_file_fd = open(add->lock_file_name.buf,
-				 O_EXCL | O_CREAT | O_WRONLY, 0666);
+	add->lock_file_fd = stack_lock_file(st, add->lock_file_name.buf,
+					    st->config.lock_timeout_ms);
 	if (add->lock_file_fd < 0) {
-		if (errno == EEXIST) {
-			err = REFTABLE_LOCK_ERROR;
-		} else {
-			err = REFTABLE_IO_ERROR;
-		}
+		err = add->lock_file_fd;
+		add->lock_file_fd = 0;
+		/* the lock is somebody else's; do not remove it. */
+		strbuf_release(&add->lock_file_name);
 		goto done;
 	}
-	if (st->config.default_permissions) {
-		if (chmod(add->lock_file_name.buf, st->config.default_permissions) < 0) {
-			err = REFTABLE_IO_ERROR;
-			goto done;
-		}
-	}
 
 	err = stack_uptodate(st);
 	if (err < 0)
 		goto done;
 
-	if (err > 1) {
-		err = REFTABLE_LOCK_ERROR;
-		goto done;
+	if (err > 0) {
+		/*
+		 * Somebody updated the stack before we got the lock. Unless
+		 * the caller only looks at the stack once it is locked, the
+		 * values it based the addition on may be stale.
+		 */
+		if (!(flags & REFTABLE_STACK_NEW_ADDITION_RELOAD)) {
+			err = REFTABLE_LOCK_ERROR;
+			goto done;
+		}
+
+		err = reftable_stack_reload_maybe_reuse(st, 1);
+		if (err < 0)
+			goto done;
 	}
 
 	add->next_update_index = reftable_stack_next_update_index(st);
@@ -590,13 +673,14 @@ int reftable_addition_commit(struct reftable_addition *add)
 }
 
 int reftable_stack_new_addition(struct reftable_addition **dest,
-				struct reftable_stack *st)
+				struct reftable_stack *st,
+				unsigned int flags)
 {
 	int err = 0;
 	struct reftable_addition empty = REFTABLE_ADDITION_INIT;
 	*dest = reftable_calloc(sizeof(**dest));
 	**dest = empty;
-	err = reftable_stack_init_addition(*dest, st);
+	err = reftable_stack_init_addition(*dest, st, flags);
 	if (err) {
 		reftable_free(*dest);
 		*dest = NULL;
@@ -610,7 +694,7 @@ static int stack_try_add(struct reftable_stack *st,
 			 void *arg)
 {
 	struct reftable_addition add = REFTABLE_ADDITION_INIT;
-	int err = reftable_stack_init_addition(&add, st);
+	int err = reftable_stack_init_addition(&add, st, 0);
 	if (err < 0)
 		goto done;
 	if (err > 0) {
@@ -749,6 +833,15 @@ static int stack_compact_locked(struct reftable_stack *st, int first, int last,
 	strbuf_addstr(temp_tab, ".temp.XXXXXX");
 
 	tab_fd = mkstemp(temp_tab->buf);
+	if (tab_fd < 0) {
+		err = REFTABLE_IO_ERROR;
+		goto done;
+	}
+	if (st->config.default_permissions &&
+	    chmod(temp_tab->buf, st->config.default_permissions) < 0) {
+		err = REFTABLE_IO_ERROR;
+		goto done;
+	}
 	wr = reftable_new_writer(reftable_fd_write, &tab_fd, &st->config);
 
 	err = stack_write_compact(st, wr, first, last, config);
@@ -878,9 +971,51 @@ static int stack_write_compact(struct reftable_stack *st,
 	return err;
 }
 
-/* <  0: error. 0 == OK, > 0 attempt failed; could retry. */
+int stack_replace_compacted(struct strbuf *out, char **names,
+			    char **compacted, const char *new_table)
+{
+	int names_len = names_length(names);
+	int compacted_len = names_length(compacted);
+	int i, j;
+
+	for (i = 0; i + compacted_len <= names_len; i++) {
+		for (j = 0; j < compacted_len; j++)
+			if (strcmp(names[i + j], compacted[j]))
+				break;
+		if (j == compacted_len)
+			break;
+	}
+	if (!compacted_len || i + compacted_len > names_len)
+		return 1;
+
+	strbuf_reset(out);
+	for (j = 0; j < i; j++)
+		strbuf_addf(out, "%s\n", names[j]);
+	if (new_table)
+		strbuf_addf(out, "%s\n", new_table);
+	for (j = i + compacted_len; j < names_len; j++)
+		strbuf_addf(out, "%s\n", names[j]);
+	return 0;
+}
+
+/*
+ * Compact the tables first..last into one.
+ *
+ * The list lock is only held while locking the tables to compact and while
+ * swapping in the result, so that writers can keep adding tables while the
+ * compacted table is written. Those tables are kept when the result is
+ * swapped in. With `all` set, wait for the list lock, and compact whatever
+ * the stack holds once it is locked; otherwise give up right away if the
+ * lock is taken or the stack has changed.
+ *
+ * Table locks are never waited for, as their holder may be waiting for the
+ * list lock we hold.
+ *
+ * <  0: error. 0 == OK, > 0 attempt failed; could retry.
+ */
 static int stack_compact_range(struct reftable_stack *st, int first, int last,
-			       struct reftable_log_expiry_config *expiry)
+			       struct reftable_log_expiry_config *expiry,
+			       int all)
 {
 	struct strbuf temp_tab_file_name = STRBUF_INIT;
 	struct strbuf new_table_name = STRBUF_INIT;
@@ -890,12 +1025,12 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 	int err = 0;
 	int have_lock = 0;
 	int lock_file_fd = -1;
-	int compact_count = last - first + 1;
+	int compact_count;
 	char **listp = NULL;
-	char **delete_on_success =
-		reftable_calloc(sizeof(char *) * (compact_count + 1));
-	char **subtable_locks =
-		reftable_calloc(sizeof(char *) * (compact_count + 1));
+	char **delete_on_success = NULL;
+	char **subtable_locks = NULL;
+	char **compacted_names = NULL;
+	char **names = NULL;
 	int i = 0;
 	int j = 0;
 	int is_empty_table = 0;
@@ -911,14 +1046,11 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 	strbuf_addstr(&lock_file_name, st->list_file);
 	strbuf_addstr(&lock_file_name, ".lock");
 
-	lock_file_fd =
-		open(lock_file_name.buf, O_EXCL | O_CREAT | O_WRONLY, 0666);
+	lock_file_fd = stack_lock_file(st, lock_file_name.buf,
+				       all ? st->config.lock_timeout_ms : 0);
 	if (lock_file_fd < 0) {
-		if (errno == EEXIST) {
-			err = 1;
-		} else {
-			err = REFTABLE_IO_ERROR;
-		}
+		err = lock_file_fd == REFTABLE_LOCK_ERROR ? 1 : lock_file_fd;
+		lock_file_fd = -1;
 		goto done;
 	}
 	/* Don't want to write to the lock for now.  */
@@ -927,9 +1059,24 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 
 	have_lock = 1;
 	err = stack_uptodate(st);
+	if (err > 0 && all) {
+		err = reftable_stack_reload_maybe_reuse(st, 1);
+		if (err < 0)
+			goto done;
+		last = st->merged->stack_len - 1;
+		if (first > last || (!expiry && first == last))
+			goto done;
+	}
 	if (err != 0)
 		goto done;
 
+	compact_count = last - first + 1;
+	delete_on_success =
+		reftable_calloc(sizeof(char *) * (compact_count + 1));
+	subtable_locks = reftable_calloc(sizeof(char *) * (compact_count + 1));
+	compacted_names =
+		reftable_calloc(sizeof(char *) * (compact_count + 1));
+
 	for (i = first, j = 0; i <= last; i++) {
 		struct strbuf subtab_file_name = STRBUF_INIT;
 		struct strbuf subtab_lock = STRBUF_INIT;
@@ -954,8 +1101,13 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 			}
 		}
 
-		subtable_locks[j] = subtab_lock.buf;
+		/* only remove locks that we created ourselves. */
+		if (err)
+			strbuf_release(&subtab_lock);
+		else
+			subtable_locks[j] = subtab_lock.buf;
 		delete_on_success[j] = subtab_file_name.buf;
+		compacted_names[j] = xstrdup(reader_name(st->readers[i]));
 		j++;
 
 		if (err != 0)
@@ -978,22 +1130,31 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 	if (err < 0)
 		goto done;
 
-	lock_file_fd =
-		open(lock_file_name.buf, O_EXCL | O_CREAT | O_WRONLY, 0666);
+	/*
+	 * Having written the table, wait for writers that took the lock in
+	 * the meantime rather than throw the work away.
+	 */
+	lock_file_fd = stack_lock_file(st, lock_file_name.buf,
+				       st->config.lock_timeout_ms);
 	if (lock_file_fd < 0) {
-		if (errno == EEXIST) {
-			err = 1;
-		} else {
-			err = REFTABLE_IO_ERROR;
-		}
+		err = lock_file_fd == REFTABLE_LOCK_ERROR ? 1 : lock_file_fd;
+		lock_file_fd = -1;
+		if (!is_empty_table)
+			unlink(temp_tab_file_name.buf);
 		goto done;
 	}
 	have_lock = 1;
-	if (st->config.default_permissions) {
-		if (chmod(lock_file_name.buf, st->config.default_permissions) < 0) {
-			err = REFTABLE_IO_ERROR;
-			goto done;
-		}
+
+	/*
+	 * Tables may have been added, or tables below ours compacted, while
+	 * we were not holding the lock. Splice our table into the list as it
+	 * is now instead of the list we started from.
+	 */
+	err = read_lines(st->list_file, &names);
+	if (err < 0) {
+		if (!is_empty_table)
+			unlink(temp_tab_file_name.buf);
+		goto done;
 	}
 
 	format_name(&new_table_name, st->readers[first]->min_update_index,
@@ -1002,6 +1163,17 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 
 	stack_filename(&new_table_path, st, new_table_name.buf);
 
+	err = stack_replace_compacted(&ref_list_contents, names,
+				      compacted_names,
+				      is_empty_table ? NULL :
+						       new_table_name.buf);
+	if (err) {
+		/* our tables are gone; somebody else must have won. */
+		if (!is_empty_table)
+			unlink(temp_tab_file_name.buf);
+		goto done;
+	}
+
 	if (!is_empty_table) {
 		/* retry? */
 		err = rename(temp_tab_file_name.buf, new_table_path.buf);
@@ -1011,19 +1183,6 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 		}
 	}
 
-	for (i = 0; i < first; i++) {
-		strbuf_addstr(&ref_list_contents, st->readers[i]->name);
-		strbuf_addstr(&ref_list_contents, "\n");
-	}
-	if (!is_empty_table) {
-		strbuf_addbuf(&ref_list_contents, &new_table_name);
-		strbuf_addstr(&ref_list_contents, "\n");
-	}
-	for (i = last + 1; i < st->merged->stack_len; i++) {
-		strbuf_addstr(&ref_list_contents, st->readers[i]->name);
-		strbuf_addstr(&ref_list_contents, "\n");
-	}
-
 	err = write(lock_file_fd, ref_list_contents.buf, ref_list_contents.len);
 	if (err < 0) {
 		err = REFTABLE_IO_ERROR;
@@ -1061,12 +1220,11 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 
 done:
 	free_names(delete_on_success);
+	free_names(compacted_names);
+	free_names(names);
 
-	listp = subtable_locks;
-	while (*listp) {
+	for (listp = subtable_locks; listp && *listp; listp++)
 		unlink(*listp);
-		listp++;
-	}
 	free_names(subtable_locks);
 	if (lock_file_fd >= 0) {
 		close(lock_file_fd);
@@ -1086,14 +1244,26 @@ static int stack_compact_range(struct reftable_stack *st, int first, int last,
 int reftable_stack_compact_all(struct reftable_stack *st,
 			       struct reftable_log_expiry_config *config)
 {
-	return stack_compact_range(st, 0, st->merged->stack_len - 1, config);
+	struct lock_backoff backoff =
+		LOCK_BACKOFF_INIT(st->config.lock_timeout_ms);
+	int err;
+
+	/*
+	 * Tables may be locked by a writer compacting them after an update;
+	 * wait for it to be done.
+	 */
+	do {
+		err = stack_compact_range(st, 0, st->merged->stack_len - 1,
+					  config, 1);
+	} while (err > 0 && lock_backoff_wait(&backoff));
+	return err;
 }
 
 static int stack_compact_range_stats(struct reftable_stack *st, int first,
 				     int last,
 				     struct reftable_log_expiry_config *config)
 {
-	int err = stack_compact_range(st, first, last, config);
+	int err = stack_compact_range(st, first, last, config, 0);
 	if (err > 0) {
 		st->stats.failures++;
 	}
@@ -1376,12 +1546,8 @@ static int reftable_stack_clean_locked(struct reftable_stack *st)
 int reftable_stack_clean(struct reftable_stack *st)
 {
 	struct reftable_addition *add = NULL;
-	int err = reftable_stack_new_addition(&add, st);
-	if (err < 0) {
-		goto done;
-	}
-
-	err = reftable_stack_reload(st);
+	int err = reftable_stack_new_addition(&add, st,
+					      REFTABLE_STACK_NEW_ADDITION_RELOAD);
 	if (err < 0) {
 		goto done;
 	}
@@ -24,10 +24,21 @@ struct reftable_stack {
 	size_t readers_len;
 	struct reftable_merged_table *merged;
 	struct reftable_compaction_stats stats;
+
+	/* decoded blocks shared by all readers of the stack, or NULL. */
+	struct block_cache *block_cache;
 };
 
 int read_lines(const char *filename, char ***lines);
 
+/*
+ * Write to `out` the table list `names` with the run of tables `compacted`
+ * replaced by `new_table`, or dropped if `new_table` is NULL. Returns 1 if
+ * `names` no longer contains the run.
+ */
+int stack_replace_compacted(struct strbuf *out, char **names,
+			    char **compacted, const char *new_table);
+
 struct segment {
 	int start, end;
 	int log;
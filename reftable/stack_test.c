@@ -10,9 +10,11 @@ license that can be found in the LICENSE file or at
 
 #include "system.h"
 
+#include "reftable-merged.h"
 #include "reftable-reader.h"
 #include "merged.h"
 #include "basics.h"
+#include "blockcache.h"
 #include "constants.h"
 #include "record.h"
 #include "test_framework.h"
@@ -116,6 +118,25 @@ static void test_names_equal(void)
 	EXPECT(!names_equal(a, c));
 }
 
+static void test_stack_replace_compacted(void)
+{
+	char *names[] = { "a", "b", "c", "d", "e", NULL };
+	char *run[] = { "b", "c", NULL };
+	char *gone[] = { "c", "b", NULL };
+	char *tail[] = { "d", "e", "f", NULL };
+	struct strbuf out = STRBUF_INIT;
+
+	EXPECT(!stack_replace_compacted(&out, names, run, "bc"));
+	EXPECT(!strcmp(out.buf, "a\nbc\nd\ne\n"));
+
+	EXPECT(!stack_replace_compacted(&out, names, run, NULL));
+	EXPECT(!strcmp(out.buf, "a\nd\ne\n"));
+
+	EXPECT(stack_replace_compacted(&out, names, gone, "cb") == 1);
+	EXPECT(stack_replace_compacted(&out, names, tail, "def") == 1);
+	strbuf_release(&out);
+}
+
 static int write_test_ref(struct reftable_writer *wr, void *arg)
 {
 	struct reftable_ref_record *ref = arg;
@@ -268,7 +289,7 @@ static void test_reftable_stack_transaction_api(void)
 
 	reftable_addition_destroy(add);
 
-	err = reftable_stack_new_addition(&add, st);
+	err = reftable_stack_new_addition(&add, st, 0);
 	EXPECT_ERR(err);
 
 	err = reftable_addition_add(add, &write_test_ref, &ref);
@@ -383,6 +404,44 @@ static void test_reftable_stack_lock_failure(void)
 	clear_dir(dir);
 }
 
+static void test_reftable_stack_lock_timeout(void)
+{
+	char *dir = get_tmp_dir(__LINE__);
+	struct strbuf lock = STRBUF_INIT;
+	struct reftable_write_options cfg = { 0 };
+	struct reftable_stack *st = NULL;
+	struct reftable_addition *add = NULL;
+	int err, fd;
+
+	err = reftable_new_stack(&st, dir, cfg);
+	EXPECT_ERR(err);
+
+	strbuf_addf(&lock, "%s/tables.list.lock", dir);
+	fd = open(lock.buf, O_CREAT | O_EXCL | O_WRONLY, 0666);
+	EXPECT(fd >= 0);
+	close(fd);
+
+	err = reftable_stack_new_addition(&add, st, 0);
+	EXPECT(err == REFTABLE_LOCK_ERROR);
+	EXPECT(!add);
+
+	st->config.lock_timeout_ms = 10;
+	err = reftable_stack_new_addition(&add, st, 0);
+	EXPECT(err == REFTABLE_LOCK_ERROR);
+
+	/* the lock belongs to somebody else, and must be left alone. */
+	EXPECT(!access(lock.buf, F_OK));
+
+	unlink(lock.buf);
+	err = reftable_stack_new_addition(&add, st, 0);
+	EXPECT_ERR(err);
+	reftable_addition_destroy(add);
+
+	strbuf_release(&lock);
+	reftable_stack_destroy(st);
+	clear_dir(dir);
+}
+
 static void test_reftable_stack_add(void)
 {
 	int i = 0;
@@ -949,6 +1008,109 @@ static void test_reftable_stack_compaction_concurrent_clean(void)
 	clear_dir(dir);
 }
 
+struct write_refs_arg {
+	struct reftable_ref_record *refs;
+	int n;
+};
+
+static int write_test_refs(struct reftable_writer *wr, void *arg)
+{
+	struct write_refs_arg *wra = arg;
+	int i, err = 0;
+
+	reftable_writer_set_limits(wr, 1, 1);
+	for (i = 0; !err && i < wra->n; i++)
+		err = reftable_writer_add_ref(wr, &wra->refs[i]);
+	return err;
+}
+
+static void test_reftable_stack_block_cache(void)
+{
+	struct reftable_write_options cfg = {
+		.block_size = 256,
+		.block_cache_size = 1024,
+	};
+	struct reftable_stack *st = NULL;
+	struct reftable_ref_record refs[200] = { { NULL } };
+	struct write_refs_arg arg = { .refs = refs, .n = ARRAY_SIZE(refs) };
+	struct block_cache_stats stats;
+	struct reftable_iterator it = { NULL };
+	struct reftable_ref_record ref = { NULL };
+	char *dir = get_tmp_dir(__LINE__);
+	int i, round, err, seen = 0;
+
+	for (i = 0; i < arg.n; i++) {
+		char buf[256];
+		snprintf(buf, sizeof(buf), "refs/heads/branch%03d", i);
+		refs[i].refname = xstrdup(buf);
+		refs[i].update_index = 1;
+		refs[i].value_type = REFTABLE_REF_VAL1;
+		refs[i].value.val1 = reftable_malloc(GIT_SHA1_RAWSZ);
+		set_test_hash(refs[i].value.val1, i);
+	}
+
+	err = reftable_new_stack(&st, dir, cfg);
+	EXPECT_ERR(err);
+	err = reftable_stack_add(st, &write_test_refs, &arg);
+	EXPECT_ERR(err);
+
+	for (round = 0; round < 2; round++) {
+		for (i = 0; i < arg.n; i++) {
+			struct reftable_ref_record dest = { NULL };
+			err = reftable_stack_read_ref(st, refs[i].refname,
+						      &dest);
+			EXPECT_ERR(err);
+			EXPECT(reftable_ref_record_equal(&dest, refs + i,
+							 GIT_SHA1_RAWSZ));
+			reftable_ref_record_release(&dest);
+		}
+	}
+
+	block_cache_get_stats(st->block_cache, &stats);
+	EXPECT(stats.hits > 0);
+	EXPECT(stats.evictions > 0);
+	EXPECT(stats.bytes <= cfg.block_cache_size);
+
+	/* Blocks evicted while an iterator still uses them stay valid. */
+	err = reftable_merged_table_seek_ref(st->merged, &it, "");
+	EXPECT_ERR(err);
+	while (!(err = reftable_iterator_next_ref(&it, &ref))) {
+		struct reftable_ref_record dest = { NULL };
+		EXPECT(reftable_ref_record_equal(&ref, refs + seen,
+						 GIT_SHA1_RAWSZ));
+		err = reftable_stack_read_ref(st, refs[arg.n - seen - 1].refname,
+					      &dest);
+		EXPECT_ERR(err);
+		reftable_ref_record_release(&dest);
+		seen++;
+	}
+	EXPECT(err > 0);
+	EXPECT(seen == arg.n);
+	reftable_iterator_destroy(&it);
+	reftable_ref_record_release(&ref);
+
+	/* Compaction replaces the reader, dropping its cached blocks. */
+	ref = refs[0];
+	ref.update_index = reftable_stack_next_update_index(st);
+	err = reftable_stack_add(st, &write_test_ref, &ref);
+	EXPECT_ERR(err);
+	err = reftable_stack_compact_all(st, NULL);
+	EXPECT_ERR(err);
+	for (i = 0; i < arg.n; i++) {
+		struct reftable_ref_record dest = { NULL };
+		err = reftable_stack_read_ref(st, refs[i].refname, &dest);
+		EXPECT_ERR(err);
+		EXPECT(!memcmp(dest.value.val1, refs[i].value.val1,
+			       GIT_SHA1_RAWSZ));
+		reftable_ref_record_release(&dest);
+	}
+
+	reftable_stack_destroy(st);
+	for (i = 0; i < arg.n; i++)
+		reftable_ref_record_release(&refs[i]);
+	clear_dir(dir);
+}
+
 int stack_test_main(int argc, const char *argv[])
 {
 	RUN_TEST(test_empty_add);
@@ -960,10 +1122,12 @@ int stack_test_main(int argc, const char *argv[])
 	RUN_TEST(test_reftable_stack_add);
 	RUN_TEST(test_reftable_stack_add_one);
 	RUN_TEST(test_reftable_stack_auto_compaction);
+	RUN_TEST(test_reftable_stack_block_cache);
 	RUN_TEST(test_reftable_stack_compaction_concurrent);
 	RUN_TEST(test_reftable_stack_compaction_concurrent_clean);
 	RUN_TEST(test_reftable_stack_hash_id);
 	RUN_TEST(test_reftable_stack_lock_failure);
+	RUN_TEST(test_reftable_stack_lock_timeout);
 	RUN_TEST(test_reftable_stack_log_normalize);
 	RUN_TEST(test_reftable_stack_tombstone);
 	RUN_TEST(test_reftable_stack_transaction_api);
@@ -973,6 +1137,7 @@ int stack_test_main(int argc, const char *argv[])
 	RUN_TEST(test_sizes_to_segments);
 	RUN_TEST(test_sizes_to_segments_all_equal);
 	RUN_TEST(test_sizes_to_segments_empty);
+	RUN_TEST(test_stack_replace_compacted);
 	RUN_TEST(test_suggest_compaction_segment);
 	RUN_TEST(test_suggest_compaction_segment_nothing);
 	return 0;
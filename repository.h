@@ -19,6 +19,12 @@ enum untracked_cache_setting {
 	UNTRACKED_CACHE_WRITE,
 };
 
+enum ref_storage_format {
+	REF_STORAGE_FORMAT_UNKNOWN,
+	REF_STORAGE_FORMAT_FILES,
+	REF_STORAGE_FORMAT_REFTABLE,
+};
+
 enum fetch_negotiation_setting {
 	FETCH_NEGOTIATION_CONSECUTIVE,
 	FETCH_NEGOTIATION_SKIPPING,
@@ -134,6 +140,15 @@ struct repository {
 	/* Repository's current hash algorithm, as serialized on disk. */
 	const struct git_hash_algo *hash_algo;
 
+	/* Repository's reference storage format, as serialized on disk. */
+	enum ref_storage_format ref_storage_format;
+
+	/*
+	 * Are changes to packed references recorded in a
+	 * `packed-refs.delta` file (extensions.packedRefsDelta)?
+	 */
+	int packed_refs_delta;
+
 	/* A unique-id for tracing purposes. */
 	int trace2_repo_id;
 
@@ -169,6 +184,8 @@ void repo_set_gitdir(struct repository *repo, const char *root,
 		     const struct set_gitdir_args *extra_args);
 void repo_set_worktree(struct repository *repo, const char *path);
 void repo_set_hash_algo(struct repository *repo, int algo);
+void repo_set_ref_storage_format(struct repository *repo,
+				 enum ref_storage_format format);
 void initialize_the_repository(void);
 int repo_init(struct repository *r, const char *gitdir, const char *worktree);
 
@@ -657,25 +657,54 @@ static void trace2_bloom_filter_statistics_atexit(void)
 
 static int forbid_bloom_filters(struct pathspec *spec)
 {
-	if (spec->has_wildcard)
-		return 1;
-	if (spec->nr > 1)
-		return 1;
-	if (spec->magic & ~PATHSPEC_LITERAL)
-		return 1;
-	if (spec->nr && (spec->items[0].magic & ~PATHSPEC_LITERAL))
+	unsigned int allowed_magic = PATHSPEC_LITERAL | PATHSPEC_GLOB;
+	int i;
+
+	if (spec->magic & ~allowed_magic)
 		return 1;
+	for (i = 0; i < spec->nr; i++)
+		if (spec->items[i].magic & ~allowed_magic)
+			return 1;
 
 	return 0;
 }
 
+/*
+ * Build the Bloom keys for a single pathspec item. For a wildcard
+ * pattern we can only use the literal leading directories, as every
+ * path it matches lives below them. Returns NULL if there is no such
+ * prefix, in which case any commit may touch a matching path.
+ */
+static struct bloom_keyvec *pathspec_item_to_bloom_keyvec(const struct pathspec_item *pi,
+							  const struct bloom_filter_settings *settings)
+{
+	size_t len = pi->len;
+
+	if (pi->nowildcard_len < pi->len) {
+		len = pi->nowildcard_len;
+		while (len && pi->match[len - 1] != '/')
+			len--;
+	}
+
+	/* remove single trailing slash from path, if needed */
+	if (len && pi->match[len - 1] == '/')
+		len--;
+
+	if (!len)
+		return NULL;
+
+	/*
+	 * At this point, the path is normalized to use Unix-style
+	 * path separators. This is required due to how the
+	 * changed-path Bloom filters store the paths.
+	 */
+	return bloom_keyvec_new(pi->match, len, settings);
+}
+
 static void prepare_to_use_bloom_filter(struct rev_info *revs)
 {
-	struct pathspec_item *pi;
-	char *path_alloc = NULL;
-	const char *path, *p;
-	size_t len;
-	int path_component_nr = 1;
+	struct pathspec *spec = &revs->pruning.pathspec;
+	int i;
 
 	if (!revs->commits)
 		return;
@@ -689,66 +718,41 @@ static void prepare_to_use_bloom_filter(struct rev_info *revs)
 	if (!revs->bloom_filter_settings)
 		return;
 
-	if (!revs->pruning.pathspec.nr)
+	if (!spec->nr)
 		return;
 
-	pi = &revs->pruning.pathspec.items[0];
-
-	/* remove single trailing slash from path, if needed */
-	if (pi->len > 0 && pi->match[pi->len - 1] == '/') {
-		path_alloc = xmemdupz(pi->match, pi->len - 1);
-		path = path_alloc;
-	} else
-		path = pi->match;
-
-	len = strlen(path);
-	if (!len) {
-		revs->bloom_filter_settings = NULL;
-		free(path_alloc);
-		return;
-	}
-
-	p = path;
-	while (*p) {
-		/*
-		 * At this point, the path is normalized to use Unix-style
-		 * path separators. This is required due to how the
-		 * changed-path Bloom filters store the paths.
-		 */
-		if (*p == '/')
-			path_component_nr++;
-		p++;
-	}
-
-	revs->bloom_keys_nr = path_component_nr;
-	ALLOC_ARRAY(revs->bloom_keys, revs->bloom_keys_nr);
-
-	fill_bloom_key(path, len, &revs->bloom_keys[0],
-		       revs->bloom_filter_settings);
-	path_component_nr = 1;
-
-	p = path + len - 1;
-	while (p > path) {
-		if (*p == '/')
-			fill_bloom_key(path, p - path,
-				       &revs->bloom_keys[path_component_nr++],
-				       revs->bloom_filter_settings);
-		p--;
+	/*
+	 * A commit is interesting if it may touch any of the paths, so
+	 * keep one set of keys per pathspec item and give up on the
+	 * filters entirely if any item cannot be turned into keys.
+	 */
+	ALLOC_ARRAY(revs->bloom_keyvecs, spec->nr);
+	for (i = 0; i < spec->nr; i++) {
+		struct bloom_keyvec *vec;
+
+		vec = pathspec_item_to_bloom_keyvec(&spec->items[i],
+						    revs->bloom_filter_settings);
+		if (!vec) {
+			while (revs->bloom_keyvecs_nr)
+				bloom_keyvec_free(revs->bloom_keyvecs[--revs->bloom_keyvecs_nr]);
+			FREE_AND_NULL(revs->bloom_keyvecs);
+			revs->bloom_filter_settings = NULL;
+			return;
+		}
+		revs->bloom_keyvecs[revs->bloom_keyvecs_nr++] = vec;
 	}
 
 	if (trace2_is_enabled() && !bloom_filter_atexit_registered) {
 		atexit(trace2_bloom_filter_statistics_atexit);
 		bloom_filter_atexit_registered = 1;
 	}
-
-	free(path_alloc);
 }
 
 static int check_maybe_different_in_bloom_filter(struct rev_info *revs,
 						 struct commit *commit)
 {
 	struct bloom_filter *filter;
-	int result = 1, j;
+	int result = 0, j;
 
 	if (!revs->repo->objects->commit_graph)
 		return -1;
@@ -763,10 +767,10 @@ static int check_maybe_different_in_bloom_filter(struct rev_info *revs,
 		return -1;
 	}
 
-	for (j = 0; result && j < revs->bloom_keys_nr; j++) {
-		result = bloom_filter_contains(filter,
-					       &revs->bloom_keys[j],
-					       revs->bloom_filter_settings);
+	for (j = 0; !result && j < revs->bloom_keyvecs_nr; j++) {
+		result = bloom_filter_contains_vec(filter,
+						   revs->bloom_keyvecs[j],
+						   revs->bloom_filter_settings);
 	}
 
 	if (result)
@@ -807,7 +811,7 @@ static int rev_compare_tree(struct rev_info *revs,
 			return REV_TREE_SAME;
 	}
 
-	if (revs->bloom_keys_nr && !nth_parent) {
+	if (revs->bloom_keyvecs_nr && !nth_parent) {
 		bloom_ret = check_maybe_different_in_bloom_filter(revs, commit);
 
 		if (bloom_ret == 0)
@@ -3660,7 +3664,18 @@ static void merge_queue_into_list(struct prio_queue *q, struct commit_list **lis
 static enum rewrite_result rewrite_one(struct rev_info *revs, struct commit **pp)
 {
 	struct prio_queue queue = { compare_commits_by_commit_date };
-	enum rewrite_result ret = rewrite_one_1(revs, pp, &queue);
+	enum rewrite_result ret;
+
+	/*
+	 * The incremental topo-order walk discovers parents through its
+	 * own queues, and never looks at revs->commits again.  Feeding
+	 * the parents we simplify away into that list would only make it
+	 * grow, and make every rewrite quadratic in the commits shown.
+	 */
+	if (revs->topo_walk_info)
+		return rewrite_one_1(revs, pp, NULL);
+
+	ret = rewrite_one_1(revs, pp, &queue);
 	merge_queue_into_list(&queue, &revs->commits);
 	clear_prio_queue(&queue);
 	return ret;
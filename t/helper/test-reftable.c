@@ -1,5 +1,16 @@
+#include "reftable/system.h"
+#include "reftable/blockcache.h"
+#include "reftable/reftable-error.h"
+#include "reftable/reftable-iterator.h"
+#include "reftable/reftable-merged.h"
+#include "reftable/reftable-record.h"
+#include "reftable/reftable-stack.h"
 #include "reftable/reftable-tests.h"
+#include "reftable/stack.h"
+#include "parse-options.h"
+#include "string-list.h"
 #include "test-tool.h"
+#include "trace.h"
 
 int cmd__reftable(int argc, const char **argv)
 {
@@ -20,3 +31,95 @@ int cmd__dump_reftable(int argc, const char **argv)
 {
 	return reftable_dump_main(argc, (char *const *)argv);
 }
+
+static int open_bench_stack(struct reftable_stack **st, const char *dir,
+			    struct reftable_write_options opts)
+{
+	int err;
+
+	opts.hash_id = GIT_SHA1_FORMAT_ID;
+	err = reftable_new_stack(st, dir, opts);
+	if (err == REFTABLE_FORMAT_ERROR) {
+		opts.hash_id = GIT_SHA256_FORMAT_ID;
+		err = reftable_new_stack(st, dir, opts);
+	}
+	return err;
+}
+
+/*
+ * Look up the refs of the stack in "dir" in a scattered order, and report
+ * the number of point lookups per second.
+ */
+int cmd__reftable_bench(int argc, const char **argv)
+{
+	int iterations = 100000, no_cache = 0;
+	struct option options[] = {
+		OPT_INTEGER(0, "iterations", &iterations,
+			    "number of lookups to perform"),
+		OPT_BOOL(0, "no-cache", &no_cache,
+			 "do not cache decoded blocks across lookups"),
+		OPT_END()
+	};
+	const char * const bench_usage[] = {
+		"test-tool reftable-bench [--iterations=<n>] [--no-cache] <reftable-dir>",
+		NULL
+	};
+	struct reftable_write_options opts = { 0 };
+	struct reftable_stack *st = NULL;
+	struct reftable_iterator it = { NULL };
+	struct reftable_ref_record ref = { NULL };
+	struct string_list names = STRING_LIST_INIT_DUP;
+	uint64_t start, elapsed, idx = 0;
+	int i, err;
+
+	argc = parse_options(argc, argv, NULL, options, bench_usage, 0);
+	if (argc != 1)
+		usage_with_options(bench_usage, options);
+
+	opts.skip_block_cache = no_cache;
+	err = open_bench_stack(&st, argv[0], opts);
+	if (err < 0)
+		die("cannot open reftable stack '%s': %s", argv[0],
+		    reftable_error_str(err));
+
+	err = reftable_merged_table_seek_ref(reftable_stack_merged_table(st),
+					     &it, "");
+	while (!err && !(err = reftable_iterator_next_ref(&it, &ref)))
+		string_list_append(&names, ref.refname);
+	reftable_iterator_destroy(&it);
+	reftable_ref_record_release(&ref);
+	if (err < 0)
+		die("cannot list refs: %s", reftable_error_str(err));
+	if (!names.nr)
+		die("no refs in '%s'", argv[0]);
+
+	start = getnanotime();
+	for (i = 0; i < iterations; i++) {
+		/* a full-period LCG scatters the lookups over the names */
+		idx = (idx * 6364136223846793005ULL + 1442695040888963407ULL);
+		err = reftable_stack_read_ref(st,
+					      names.items[(idx >> 33) % names.nr].string,
+					      &ref);
+		if (err)
+			die("lookup failed: %s", reftable_error_str(err));
+		reftable_ref_record_release(&ref);
+	}
+	elapsed = getnanotime() - start;
+
+	printf("refs: %"PRIuMAX"\n", (uintmax_t)names.nr);
+	printf("lookups: %d\n", iterations);
+	printf("lookups/sec: %.0f\n",
+	       elapsed ? iterations / (elapsed / 1e9) : 0.0);
+	if (st->block_cache) {
+		struct block_cache_stats stats;
+		block_cache_get_stats(st->block_cache, &stats);
+		printf("cache hits: %"PRIuMAX"\n", (uintmax_t)stats.hits);
+		printf("cache misses: %"PRIuMAX"\n", (uintmax_t)stats.misses);
+		printf("cache evictions: %"PRIuMAX"\n",
+		       (uintmax_t)stats.evictions);
+	}
+
+	string_list_clear(&names, 0);
+	reftable_stack_destroy(st);
+	return 0;
+}
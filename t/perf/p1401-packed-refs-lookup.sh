@@ -0,0 +1,45 @@
+#!/bin/sh
+
+test_description="Tests performance of reading a large packed-refs file"
+
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+test_expect_success "setup" '
+	test_commit PRE &&
+	oid=$(git rev-parse HEAD) &&
+	for i in $(test_seq 200000)
+	do
+		echo "$oid refs/pull/$i/head" || return 1
+	done >refs &&
+	test_seq 100 | sed "s,^,$oid refs/heads/team/," >>refs &&
+	git pack-refs --all &&
+	{
+		echo "# pack-refs with: peeled fully-peeled sorted " &&
+		grep -v "^#" .git/packed-refs &&
+		sort -k 2 refs
+	} >sorted &&
+	{
+		echo "# pack-refs with: peeled fully-peeled " &&
+		grep -v "^#" .git/packed-refs &&
+		cat refs
+	} >unsorted
+'
+
+for kind in sorted unsorted
+do
+	test_expect_success "use $kind packed-refs" "
+		cp $kind .git/packed-refs
+	"
+
+	test_perf "prefix iteration ($kind)" '
+		git for-each-ref refs/heads/team/ >/dev/null
+	'
+
+	test_perf "lookup ($kind)" '
+		git rev-parse --verify refs/heads/team/50
+	'
+done
+
+test_done
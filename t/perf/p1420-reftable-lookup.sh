@@ -0,0 +1,30 @@
+#!/bin/sh
+
+test_description="Tests performance of point lookups in a reftable stack"
+
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+test_expect_success "setup" '
+	git init --ref-format=reftable lookup &&
+	(
+		cd lookup &&
+		test_commit PRE &&
+		for i in $(test_seq 100000)
+		do
+			echo "create refs/heads/branch-$i PRE" || return 1
+		done | git update-ref --stdin &&
+		git pack-refs
+	)
+'
+
+test_perf "point lookups" '
+	test-tool reftable-bench --iterations=200000 lookup/.git/reftable
+'
+
+test_perf "point lookups without block cache" '
+	test-tool reftable-bench --iterations=200000 --no-cache lookup/.git/reftable
+'
+
+test_done
@@ -0,0 +1,32 @@
+#!/bin/sh
+
+test_description='Tests log --graph performance'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+test_expect_success 'setup commit-graph' '
+	git commit-graph write --reachable
+'
+
+test_perf 'git log --graph --oneline (first screen)' '
+	git log --graph --oneline -50 --all >/dev/null
+'
+
+test_perf 'git log --graph --oneline' '
+	git log --graph --oneline --all >/dev/null
+'
+
+test_expect_success 'select a file' '
+	git ls-tree HEAD | grep ^100644 |
+	sort -k 3 | head -1 | cut -f 2 >filelist
+'
+
+file=$(cat filelist)
+export file
+
+test_perf 'git log --graph --oneline -- <file>' '
+	git log --graph --oneline -- "$file" >/dev/null
+'
+
+test_done
@@ -0,0 +1,323 @@
+#!/bin/sh
+#
+# Copyright (c) 2020 Google LLC
+#
+
+test_description='reftable basics'
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+GIT_TEST_DEFAULT_REF_FORMAT=reftable
+export GIT_TEST_DEFAULT_REF_FORMAT
+
+. ./test-lib.sh
+
+INVALID_OID=$(test_oid 001)
+
+test_expect_success 'init: creates basic reftable structures' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=reftable repo &&
+	test_path_is_dir repo/.git/reftable &&
+	test_path_is_file repo/.git/reftable/tables.list &&
+	echo reftable >expect &&
+	git -C repo config extensions.refstorage >actual &&
+	test_cmp expect actual &&
+	echo 1 >expect &&
+	git -C repo config core.repositoryformatversion >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'init: stubs keep the files backend away' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=reftable repo &&
+	echo "ref: refs/heads/.invalid" >expect &&
+	test_cmp expect repo/.git/HEAD &&
+	test_path_is_file repo/.git/refs/heads
+'
+
+test_expect_success 'init: honors GIT_DEFAULT_REF_FORMAT' '
+	test_when_finished "rm -rf repo" &&
+	GIT_DEFAULT_REF_FORMAT=reftable git init repo &&
+	echo reftable >expect &&
+	git -C repo config extensions.refstorage >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'init: --ref-format overrides the environment' '
+	test_when_finished "rm -rf repo" &&
+	GIT_DEFAULT_REF_FORMAT=reftable git init --ref-format=files repo &&
+	test_must_fail git -C repo config extensions.refstorage
+'
+
+test_expect_success 'init: unknown format is rejected' '
+	test_must_fail git init --ref-format=garbage repo 2>err &&
+	test_i18ngrep "unknown ref storage format ${SQ}garbage${SQ}" err
+'
+
+test_expect_success 'init: reinit with a different format fails' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=reftable repo &&
+	test_must_fail git init --ref-format=files repo 2>err &&
+	test_i18ngrep "different reference storage format" err &&
+	git init repo &&
+	git init --ref-format=reftable repo
+'
+
+test_expect_success 'unknown extensions.refstorage is rejected' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=reftable repo &&
+	git -C repo config extensions.refstorage garbage &&
+	test_must_fail git -C repo rev-parse --git-dir 2>err &&
+	test_i18ngrep "invalid value for ${SQ}extensions.refstorage${SQ}" err
+'
+
+test_expect_success 'setup' '
+	test_commit file &&
+	COMMIT=$(git rev-parse HEAD)
+'
+
+test_expect_success 'update-ref: create, update and delete' '
+	git update-ref refs/heads/topic HEAD &&
+	test_cmp_rev HEAD refs/heads/topic &&
+	git update-ref refs/heads/topic HEAD~0 HEAD &&
+	git update-ref -d refs/heads/topic &&
+	test_must_fail git rev-parse --verify -q refs/heads/topic
+'
+
+test_expect_success 'update-ref: compare-and-swap' '
+	git update-ref refs/heads/cas HEAD &&
+	test_must_fail git update-ref refs/heads/cas HEAD $INVALID_OID &&
+	test_must_fail git update-ref --create-reflog refs/heads/new HEAD $INVALID_OID &&
+	test_must_fail git rev-parse --verify -q refs/heads/new &&
+	git update-ref -d refs/heads/cas $COMMIT
+'
+
+test_expect_success 'update-ref --stdin: transaction is atomic' '
+	cat >in <<-EOF &&
+	create refs/heads/one $COMMIT
+	create refs/heads/two $COMMIT
+	EOF
+	git update-ref --stdin <in &&
+	cat >in <<-EOF &&
+	create refs/heads/three $COMMIT
+	create refs/heads/one $COMMIT
+	EOF
+	test_must_fail git update-ref --stdin <in &&
+	test_must_fail git rev-parse --verify -q refs/heads/three &&
+	git for-each-ref --format="%(refname)" refs/heads/one refs/heads/two >actual &&
+	cat >expect <<-\EOF &&
+	refs/heads/one
+	refs/heads/two
+	EOF
+	test_cmp expect actual
+'
+
+test_expect_success 'refnames conflicting with existing ones are refused' '
+	test_must_fail git update-ref refs/heads/one/sub HEAD &&
+	test_must_fail git update-ref refs/heads HEAD
+'
+
+test_expect_success 'symbolic-ref: create and resolve' '
+	git symbolic-ref refs/heads/sym refs/heads/one &&
+	echo refs/heads/one >expect &&
+	git symbolic-ref refs/heads/sym >actual &&
+	test_cmp expect actual &&
+	test_cmp_rev refs/heads/one refs/heads/sym &&
+	git symbolic-ref -d refs/heads/sym
+'
+
+test_expect_success 'for-each-ref: peels annotated tags' '
+	git tag -a -m annotated annotated &&
+	git rev-parse annotated >expect &&
+	git rev-parse HEAD >>expect &&
+	git for-each-ref --format="%(objectname)%0a%(*objectname)" \
+		refs/tags/annotated >actual &&
+	test_cmp expect actual &&
+	git show-ref -d annotated >actual &&
+	test_line_count = 2 actual
+'
+
+test_expect_success 'reflog: records updates to branches and HEAD' '
+	test_commit second &&
+	git reflog show --format="%gs" main >actual &&
+	cat >expect <<-\EOF &&
+	commit: second
+	commit (initial): file
+	EOF
+	test_cmp expect actual &&
+	git reflog exists HEAD &&
+	git reflog show --format="%gs" -1 HEAD >actual &&
+	echo "commit: second" >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'reflog: expire and delete' '
+	git update-ref -m first refs/heads/logged HEAD~ &&
+	git update-ref -m second refs/heads/logged HEAD &&
+	git reflog delete refs/heads/logged@{0} &&
+	git reflog show --format="%gs" refs/heads/logged >actual &&
+	echo first >expect &&
+	test_cmp expect actual &&
+	git reflog expire --expire=all refs/heads/logged &&
+	git reflog show refs/heads/logged >actual &&
+	test_must_be_empty actual &&
+	git reflog exists refs/heads/logged
+'
+
+test_expect_success 'reflog: delete --rewrite fixes up the old value' '
+	git update-ref -m one refs/heads/rewritten HEAD~ &&
+	git update-ref -m two refs/heads/rewritten HEAD &&
+	git update-ref -m three refs/heads/rewritten HEAD~ &&
+	git reflog delete --rewrite refs/heads/rewritten@{1} &&
+	test-tool ref-store main for-each-reflog-ent refs/heads/rewritten >log &&
+	cut -d" " -f1,2 log >actual &&
+	cat >expect <<-EOF &&
+	$ZERO_OID $(git rev-parse HEAD~)
+	$(git rev-parse HEAD~) $(git rev-parse HEAD~)
+	EOF
+	test_cmp expect actual
+'
+
+test_expect_success 'branch: rename carries the reflog' '
+	git branch -f old HEAD &&
+	git branch -m old new &&
+	test_must_fail git rev-parse --verify -q refs/heads/old &&
+	test_must_fail git reflog exists refs/heads/old &&
+	git reflog show --format="%gs" -1 refs/heads/new >actual &&
+	echo "Branch: renamed refs/heads/old to refs/heads/new" >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'branch: copy keeps the original' '
+	git branch -c new copy &&
+	test_cmp_rev new copy &&
+	git reflog exists refs/heads/new &&
+	git reflog exists refs/heads/copy
+'
+
+test_expect_success 'branch: renaming the current branch updates HEAD' '
+	git checkout -b current &&
+	git branch -m current renamed &&
+	echo refs/heads/renamed >expect &&
+	git symbolic-ref HEAD >actual &&
+	test_cmp expect actual &&
+	git checkout main
+'
+
+test_expect_success 'branch: delete removes ref and reflog' '
+	git branch -D copy &&
+	test_must_fail git rev-parse --verify -q refs/heads/copy &&
+	test_must_fail git reflog exists refs/heads/copy
+'
+
+test_expect_success 'pack-refs: compacts the stack into one table' '
+	git update-ref refs/heads/before-pack HEAD &&
+	git pack-refs &&
+	test_line_count = 1 .git/reftable/tables.list &&
+	test_cmp_rev HEAD refs/heads/before-pack &&
+	git reflog exists refs/heads/before-pack
+'
+
+test_expect_success 'tables honor core.sharedRepository' '
+	test_when_finished "rm -rf shared" &&
+	git init --ref-format=reftable --shared=group shared &&
+	test_commit -C shared file &&
+	for table in $(cat shared/.git/reftable/tables.list)
+	do
+		test_modebits shared/.git/reftable/$table >actual &&
+		echo "-rw-rw-r--" >expect &&
+		test_cmp expect actual || return 1
+	done &&
+	test_commit -C shared second &&
+	git -C shared pack-refs &&
+	table=$(cat shared/.git/reftable/tables.list) &&
+	test_modebits shared/.git/reftable/$table >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'writers fail on a held lock without a timeout' '
+	test_when_finished "rm -f .git/reftable/tables.list.lock" &&
+	>.git/reftable/tables.list.lock &&
+	test_must_fail git -c reftable.lockTimeout=0 \
+		update-ref refs/heads/locked HEAD 2>err &&
+	test_i18ngrep "unable to lock reference database" err &&
+	test_path_is_file .git/reftable/tables.list.lock
+'
+
+test_expect_success 'writers wait for a held lock to be released' '
+	test_when_finished "rm -f .git/reftable/tables.list.lock" &&
+	>.git/reftable/tables.list.lock &&
+	{
+		( sleep 1 && rm -f .git/reftable/tables.list.lock ) &
+	} &&
+	git -c reftable.lockTimeout=10000 update-ref refs/heads/waited HEAD &&
+	wait &&
+	test_cmp_rev HEAD refs/heads/waited
+'
+
+test_expect_success 'compaction keeps tables added concurrently' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=reftable repo &&
+	test_commit -C repo first &&
+	for i in 1 2 3 4 5
+	do
+		git -C repo update-ref refs/heads/b$i HEAD || return 1
+	done &&
+	{
+		for i in 1 2 3 4 5 6 7 8 9 10
+		do
+			git -C repo -c reftable.lockTimeout=-1 \
+				update-ref refs/heads/c$i HEAD || exit 1
+		done &
+	} &&
+	for i in 1 2 3
+	do
+		git -C repo -c reftable.lockTimeout=-1 pack-refs || return 1
+	done &&
+	wait &&
+	for i in 1 2 3 4 5 6 7 8 9 10
+	do
+		git -C repo rev-parse --verify refs/heads/c$i || return 1
+	done
+'
+
+test_expect_success 'worktree: HEAD is per worktree' '
+	test_when_finished "git worktree remove -f wt" &&
+	git worktree add -b wt-branch wt &&
+	echo refs/heads/wt-branch >expect &&
+	git -C wt symbolic-ref HEAD >actual &&
+	test_cmp expect actual &&
+	echo refs/heads/main >expect &&
+	git symbolic-ref HEAD >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir .git/worktrees/wt/reftable
+'
+
+test_expect_success 'worktree: per-worktree refs are isolated' '
+	test_when_finished "git worktree remove -f wt" &&
+	git worktree add wt &&
+	git -C wt update-ref refs/bisect/wt-only HEAD &&
+	test_must_fail git rev-parse --verify -q refs/bisect/wt-only &&
+	git -C wt rev-parse --verify refs/bisect/wt-only &&
+	git -C wt update-ref refs/heads/shared HEAD &&
+	git rev-parse --verify refs/heads/shared &&
+	git -C wt rev-parse --verify main-worktree/HEAD
+'
+
+test_expect_success 'clone: honors GIT_DEFAULT_REF_FORMAT' '
+	test_when_finished "rm -rf clone" &&
+	GIT_DEFAULT_REF_FORMAT=reftable git clone . clone &&
+	echo reftable >expect &&
+	git -C clone config extensions.refstorage >actual &&
+	test_cmp expect actual &&
+	git rev-parse main >expect &&
+	git -C clone rev-parse refs/remotes/origin/main >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'fsck and gc are happy' '
+	git fsck &&
+	git gc &&
+	test_cmp_rev HEAD refs/heads/main
+'
+
+test_done
@@ -103,6 +103,25 @@ test_expect_success 'git-add in subdir does not invalidate sibling cache-tree' '
 	cmp_cache_tree expect
 '
 
+test_expect_success 'diff-index --cached trusts a valid cache-tree' '
+	git read-tree HEAD &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git diff-index --cached HEAD >actual &&
+	test_must_be_empty actual &&
+	! grep "region_enter.*unpack_trees" trace.perf &&
+	echo changed >foo.t &&
+	git add foo.t &&
+	rm trace.perf &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git diff-index --cached --name-only HEAD >actual &&
+	echo foo.t >expect &&
+	test_cmp expect actual &&
+	grep "region_enter.*unpack_trees" trace.perf &&
+	rm trace.perf &&
+	git read-tree HEAD &&
+	git checkout foo.t
+'
+
 test_expect_success 'update-index invalidates cache-tree' '
 	test_when_finished "git reset --hard; git read-tree HEAD" &&
 	echo "I changed this file" >foo &&
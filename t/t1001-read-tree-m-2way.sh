@@ -416,4 +416,23 @@ test_expect_success '-m references the correct modified tree' '
 	test_cmp expect actual
 '
 
+test_expect_success 'two-way merge with threaded preload of the index' '
+	git reset --hard initial-mod &&
+	git checkout -B preload-test &&
+	echo side >file-b &&
+	git commit -m side file-b &&
+	git checkout initial-mod &&
+	echo dirty >file-b &&
+	test_must_fail env GIT_TEST_PRELOAD_INDEX=1 \
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git read-tree -m -u HEAD preload-test &&
+	grep "region_enter.*unpack_trees.*preload" trace.perf &&
+	echo dirty >expect &&
+	test_cmp expect file-b &&
+	git checkout file-b &&
+	GIT_TEST_PRELOAD_INDEX=1 git read-tree -m -u HEAD preload-test &&
+	echo side >expect &&
+	test_cmp expect file-b
+'
+
 test_done
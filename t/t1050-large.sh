@@ -80,6 +80,29 @@ test_expect_success 'add a large file or two' '
 	test $count = 1
 '
 
+test_expect_success 'add small files with core.bulkCheckin' '
+	test_when_finished "rm -rf bulk" &&
+	git init bulk &&
+	for i in 1 2 3 4 5
+	do
+		echo "small $i" >bulk/small$i || return 1
+	done &&
+	cp bulk/small1 bulk/same-as-small1 &&
+	cp large1 bulk/large1 &&
+	git -C bulk -c core.bulkCheckin=true add . &&
+	for l in bulk/.git/objects/$OIDPATH_REGEX
+	do
+		test_path_is_missing "$l" || return 1
+	done &&
+	ls bulk/.git/objects/pack/pack-*.idx >idx &&
+	test_line_count = 1 idx &&
+	git show-index <$(cat idx) >objs &&
+	test_line_count = 6 objs &&
+	git -C bulk cat-file blob :small3 >actual &&
+	test_cmp bulk/small3 actual &&
+	git -C bulk fsck
+'
+
 test_expect_success 'checkout a large file' '
 	large1=$(git rev-parse :large1) &&
 	git update-index --add --cacheinfo 100644 $large1 another &&
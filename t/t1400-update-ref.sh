@@ -1641,4 +1641,105 @@ test_expect_success 'directory not created deleting packed ref' '
 	test_path_is_missing .git/refs/heads/d1
 '
 
+test_expect_success REFFILES 'large transaction writes packed-refs' '
+	test_when_finished "rm -f .git/refs/heads/bulk-* .git/logs/refs/heads/bulk-*" &&
+	git update-ref refs/heads/bulk-loose $A &&
+	cp .git/packed-refs packed-refs.before &&
+	cat >stdin <<-EOF &&
+	create refs/heads/bulk-1 $A
+	create refs/heads/bulk-2 $B
+	update refs/heads/bulk-loose $B $A
+	EOF
+	git -c core.packedRefsUpdateThreshold=3 update-ref -m bulk --stdin <stdin &&
+	test_path_is_missing .git/refs/heads/bulk-1 &&
+	test_path_is_missing .git/refs/heads/bulk-loose &&
+	test_path_is_missing .git/refs/heads/bulk-1.lock &&
+	grep "^$A refs/heads/bulk-1$" .git/packed-refs &&
+	grep "^$B refs/heads/bulk-loose$" .git/packed-refs &&
+	test_cmp_rev $B refs/heads/bulk-2 &&
+	test_cmp_rev $B refs/heads/bulk-loose &&
+	git reflog show --format=%gs refs/heads/bulk-1 >actual &&
+	echo bulk >expect &&
+	test_cmp expect actual &&
+	git update-ref -d refs/heads/bulk-1 &&
+	git update-ref -d refs/heads/bulk-2 &&
+	git update-ref -d refs/heads/bulk-loose &&
+	test_cmp packed-refs.before .git/packed-refs
+'
+
+test_expect_success REFFILES 'large transaction is still atomic' '
+	cp .git/packed-refs packed-refs.before &&
+	cat >stdin <<-EOF &&
+	create refs/heads/bulk-1 $A
+	create refs/heads/bulk-2 $B
+	update $m $A $Z
+	EOF
+	test_must_fail git -c core.packedRefsUpdateThreshold=3 \
+		update-ref --stdin <stdin &&
+	test_must_fail git rev-parse --verify -q refs/heads/bulk-1 &&
+	test_cmp packed-refs.before .git/packed-refs
+'
+
+test_expect_success REFFILES 'large transaction is loose if packed-refs is much larger' '
+	test_when_finished "git for-each-ref --format=\"delete %(refname)\" \
+		refs/heads/bulk-* refs/packed/ | git update-ref --stdin" &&
+	test_seq 100 | sed "s,.*,create refs/packed/& $A," >stdin &&
+	git update-ref --stdin <stdin &&
+	git pack-refs --all &&
+	cat >stdin <<-EOF &&
+	create refs/heads/bulk-1 $A
+	create refs/heads/bulk-2 $B
+	create refs/heads/bulk-3 $B
+	EOF
+	git -c core.packedRefsUpdateThreshold=3 update-ref --stdin <stdin &&
+	test_path_is_file .git/refs/heads/bulk-1 &&
+	! grep refs/heads/bulk-1 .git/packed-refs
+'
+
+test_expect_success REFFILES 'large transaction keeps HEAD and symrefs loose' '
+	test_when_finished "git update-ref -d refs/heads/bulk-1 &&
+		git update-ref -d refs/heads/bulk-sym &&
+		git checkout -q main" &&
+	git checkout -q --detach &&
+	git symbolic-ref refs/heads/bulk-sym refs/heads/bulk-target &&
+	cat >stdin <<-EOF &&
+	update HEAD $B
+	create refs/heads/bulk-1 $A
+	option no-deref
+	update refs/heads/bulk-sym $A
+	EOF
+	git -c core.packedRefsUpdateThreshold=3 update-ref --stdin <stdin &&
+	test_path_is_file .git/refs/heads/bulk-sym &&
+	test_cmp_rev $A refs/heads/bulk-sym &&
+	echo $B >expect &&
+	test_cmp expect .git/HEAD &&
+	test_path_is_missing .git/refs/heads/bulk-1
+'
+
+test_expect_success REFFILES,PIPE 'remembered loose refs notice updates by others' '
+	test_when_finished "git update-ref -d refs/heads/remembered" &&
+	git update-ref refs/heads/remembered $A &&
+	test-tool chmtime =-60 .git/refs/heads/remembered &&
+	mkfifo remember-in remember-out &&
+	(git update-ref --stdin <remember-in >remember-out &) &&
+
+	exec 9>remember-in &&
+	exec 8<remember-out &&
+	test_when_finished "exec 9>&-" &&
+	test_when_finished "exec 8<&-" &&
+
+	for old in $A $B
+	do
+		echo start >&9 &&
+		read line <&8 &&
+		echo "verify refs/heads/remembered $old" >&9 &&
+		echo commit >&9 &&
+		read line <&8 &&
+		echo "$line" >actual &&
+		echo "commit: ok" >expected &&
+		test_cmp expected actual &&
+		git update-ref refs/heads/remembered $B || return 1
+	done
+'
+
 test_done
@@ -337,6 +337,17 @@ test_expect_success 'git branch --format option' '
 	test_cmp expect actual
 '
 
+test_expect_success 'git branch --format with ahead-behind' '
+	for b in branch-one branch-two
+	do
+		echo "$b $(git rev-list --count main..$b) $(git rev-list --count $b..main)" ||
+		return 1
+	done >expect &&
+	git branch --format="%(refname:short) %(ahead-behind:main)" \
+		--list "branch-*" >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'git branch with --format=%(rest) must fail' '
 	test_must_fail git branch --format="%(rest)" >actual
 '
@@ -114,6 +114,51 @@ test_expect_success \
 	 git update-ref refs/heads/q refs/heads/q &&
 	 ! test -f .git/refs/heads/q'
 
+test_expect_success 'refs are read from an unsorted packed-refs file' '
+	test_when_finished "rm -rf unsorted" &&
+	git init unsorted &&
+	test_commit -C unsorted base &&
+	oid=$(git -C unsorted rev-parse HEAD) &&
+	git -C unsorted pack-refs --all &&
+	{
+		echo "# pack-refs with: peeled fully-peeled " &&
+		for i in 9 3 7 1 5 8 2 6 4 0
+		do
+			echo "$oid refs/heads/b$i" &&
+			echo "$oid refs/remotes/r$i" || return 1
+		done &&
+		grep -v "^#" unsorted/.git/packed-refs
+	} >unsorted-refs &&
+	mv unsorted-refs unsorted/.git/packed-refs &&
+
+	# more lookups than get answered without sorting the file
+	for i in 0 1 2 3 4 5 6 7 8 9
+	do
+		echo $oid >expect &&
+		git -C unsorted rev-parse b$i r$i >actual &&
+		echo $oid >>expect &&
+		test_cmp expect actual || return 1
+	done &&
+	git -C unsorted rev-parse b0 b1 b2 b3 b4 b5 b6 b7 b8 b9 >actual &&
+	test_line_count = 10 actual &&
+
+	git -C unsorted for-each-ref --format="%(refname)" refs/remotes/ >actual &&
+	test_write_lines refs/remotes/r0 refs/remotes/r1 refs/remotes/r2 \
+		refs/remotes/r3 refs/remotes/r4 refs/remotes/r5 refs/remotes/r6 \
+		refs/remotes/r7 refs/remotes/r8 refs/remotes/r9 >expect &&
+	test_cmp expect actual &&
+
+	git -C unsorted for-each-ref --format="%(refname)" >actual &&
+	sort actual >expect &&
+	test_cmp expect actual &&
+	test_line_count = 22 actual &&
+
+	git -C unsorted update-ref -d refs/heads/b5 &&
+	head -n 1 unsorted/.git/packed-refs >header &&
+	grep " sorted" header &&
+	test_must_fail git -C unsorted rev-parse --verify -q b5
+'
+
 test_expect_success 'pack, prune and repack' '
 	git tag foo &&
 	git pack-refs --all --prune &&
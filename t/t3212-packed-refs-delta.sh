@@ -0,0 +1,163 @@
+#!/bin/sh
+
+test_description='recording changes to packed refs in packed-refs.delta'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+GIT_TEST_DEFAULT_REF_FORMAT=files
+export GIT_TEST_DEFAULT_REF_FORMAT
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_commit base &&
+	test_commit --annotate tagged &&
+	git config core.repositoryformatversion 1 &&
+	git config extensions.packedRefsDelta true &&
+	test_seq 100 |
+	sed "s,.*,create refs/heads/b-& HEAD," |
+	git update-ref --stdin &&
+	git pack-refs --all &&
+	test_path_is_missing .git/packed-refs.delta
+'
+
+test_expect_success 'deleting a packed ref only writes the delta file' '
+	cp .git/packed-refs packed-refs.orig &&
+	git branch -D b-1 &&
+	test_cmp packed-refs.orig .git/packed-refs &&
+	test_path_is_file .git/packed-refs.delta &&
+	grep "^$ZERO_OID refs/heads/b-1$" .git/packed-refs.delta
+'
+
+test_expect_success 'deleted ref is gone for readers' '
+	test_must_fail git rev-parse --verify -q refs/heads/b-1 &&
+	git for-each-ref --format="%(refname)" refs/heads/b-1 >actual &&
+	test_must_be_empty actual &&
+	git for-each-ref --format="%(refname)" "refs/heads/b-1*" >actual &&
+	test_line_count = 11 actual &&
+	git for-each-ref --format="%(refname)" refs/heads/ >actual &&
+	test_line_count = 100 actual &&
+	test_must_fail git show-ref --verify refs/heads/b-1
+'
+
+test_expect_success 'deletions check the old value against the delta file' '
+	test_must_fail git update-ref -d refs/heads/b-2 $(git rev-parse base^{tree}) &&
+	git rev-parse --verify refs/heads/b-2 &&
+	test_must_fail git update-ref -d refs/heads/b-1 HEAD &&
+	git update-ref -d refs/heads/b-2 HEAD &&
+	test_must_fail git rev-parse --verify -q refs/heads/b-2 &&
+	test_cmp packed-refs.orig .git/packed-refs &&
+	test_line_count = 5 .git/packed-refs.delta
+'
+
+test_expect_success 'later changes are appended to the delta file' '
+	cp .git/packed-refs.delta delta.orig &&
+	git update-ref -d refs/heads/b-3 &&
+	head -n 5 .git/packed-refs.delta >delta.head &&
+	test_cmp delta.orig delta.head &&
+	tail -n 2 .git/packed-refs.delta >actual &&
+	cat >expect <<-EOF &&
+	$ZERO_OID refs/heads/b-3
+	# end
+	EOF
+	test_cmp expect actual
+'
+
+test_expect_success 'an incomplete change in the delta file is ignored' '
+	cp .git/packed-refs.delta delta.orig &&
+	echo "$ZERO_OID refs/heads/b-4" >>.git/packed-refs.delta &&
+	git rev-parse --verify refs/heads/b-4 &&
+	git update-ref -d refs/heads/b-5 &&
+	test_must_fail git rev-parse --verify -q refs/heads/b-5 &&
+	git rev-parse --verify refs/heads/b-4 &&
+	! grep refs/heads/b-4 .git/packed-refs.delta
+'
+
+test_expect_success 'deleting a ref that is not packed leaves the delta alone' '
+	cp .git/packed-refs.delta delta.orig &&
+	git branch loose &&
+	git branch -D loose &&
+	test_cmp delta.orig .git/packed-refs.delta
+'
+
+test_expect_success 'a deleted ref can be recreated' '
+	git branch b-1 tagged &&
+	test_cmp_rev tagged^{commit} refs/heads/b-1 &&
+	git for-each-ref --format="%(refname)" refs/heads/b-1 >actual &&
+	echo refs/heads/b-1 >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'annotated tags are still peeled' '
+	git tag -d base &&
+	git rev-parse tagged^{commit} >expect &&
+	git for-each-ref --format="%(*objectname)" refs/tags/tagged >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'pack-refs folds the delta file into packed-refs' '
+	git pack-refs --all &&
+	test_path_is_missing .git/packed-refs.delta &&
+	! grep -e "refs/heads/b-2$" -e refs/tags/base .git/packed-refs &&
+	grep "^$(git rev-parse tagged^{commit}) refs/heads/b-1$" .git/packed-refs &&
+	test_must_fail git rev-parse --verify -q refs/heads/b-2
+'
+
+test_expect_success 'large deletions rewrite packed-refs' '
+	test_seq 3 60 |
+	sed "s,.*,delete refs/heads/b-&," |
+	git update-ref --stdin &&
+	test_path_is_missing .git/packed-refs.delta &&
+	! grep "refs/heads/b-3$" .git/packed-refs &&
+	git for-each-ref --format="%(refname)" "refs/heads/b-*" >actual &&
+	test_line_count = 41 actual
+'
+
+test_expect_success 'a delta file that has been folded is ignored' '
+	git branch -D b-70 &&
+	cp .git/packed-refs.delta delta.old &&
+	git pack-refs --all &&
+	git branch b-70 &&
+	git pack-refs --all &&
+	grep "refs/heads/b-70$" .git/packed-refs &&
+
+	# as seen by a reader between writing packed-refs and removing
+	# the delta file that was folded into it
+	cp delta.old .git/packed-refs.delta &&
+	git rev-parse --verify refs/heads/b-70 &&
+	git for-each-ref --format="%(refname)" refs/heads/b-70 >actual &&
+	echo refs/heads/b-70 >expect &&
+	test_cmp expect actual &&
+
+	git branch -D b-71 &&
+	test_must_fail git rev-parse --verify -q refs/heads/b-71 &&
+	git rev-parse --verify refs/heads/b-70 &&
+	! grep refs/heads/b-70 .git/packed-refs.delta
+'
+
+test_expect_success 'a delta record for a missing object hides the ref' '
+	broken=$(git commit-tree -p HEAD -m broken HEAD^{tree}) &&
+	git -c core.packedRefsUpdateThreshold=1 \
+		update-ref refs/heads/b-72 $broken &&
+	test_path_is_missing .git/refs/heads/b-72 &&
+	grep "^$broken refs/heads/b-72$" .git/packed-refs.delta &&
+	rm -f .git/objects/$(test_oid_to_path $broken) &&
+	GIT_REF_PARANOIA=0 git for-each-ref --format="%(refname)" \
+		"refs/heads/b-7*" >actual &&
+	grep refs/heads/b-73 actual &&
+	! grep refs/heads/b-72 actual &&
+	git update-ref -d refs/heads/b-72 &&
+	git pack-refs --all &&
+	test_path_is_missing .git/packed-refs.delta
+'
+
+test_expect_success 'packed-refs.delta is not used without the extension' '
+	test_when_finished "git config extensions.packedRefsDelta true" &&
+	git config extensions.packedRefsDelta false &&
+	cp .git/packed-refs packed-refs.orig &&
+	git branch -D b-61 &&
+	test_path_is_missing .git/packed-refs.delta &&
+	! test_cmp packed-refs.orig .git/packed-refs
+'
+
+test_done
@@ -30,6 +30,31 @@ test_expect_success \
     'Post-check that foo is in the index' \
     'git ls-files foo | grep foo'
 
+test_expect_success 'git add with core.fsyncMethod=batch' '
+	test_when_finished "git rm -rf --cached batch && rm -rf batch" &&
+	mkdir batch &&
+	for i in 1 2 3 4 5
+	do
+		echo "batch $i" >batch/file$i || return 1
+	done &&
+	GIT_TEST_FSYNC=1 git -c core.fsync=loose-object \
+		-c core.fsyncMethod=batch add batch &&
+	for i in 1 2 3 4 5
+	do
+		oid=$(git rev-parse :batch/file$i) &&
+		test_path_is_file .git/objects/$(test_oid_to_path $oid) || return 1
+	done &&
+	find .git/objects -name "tmp_objdir*" -o -name "bulk_fsync_*" >leftover &&
+	test_must_be_empty leftover
+'
+
+test_expect_success 'unknown core.fsync components are ignored' '
+	echo unknown >unknown-fsync &&
+	test_when_finished "git rm -f --cached unknown-fsync && rm -f unknown-fsync" &&
+	git -c core.fsync=loose-object,bogus add unknown-fsync 2>err &&
+	test_i18ngrep "unknown core.fsync component .bogus." err
+'
+
 test_expect_success \
     'Test that "git add -- -q" works' \
     'touch -- -q && git add -- -q'
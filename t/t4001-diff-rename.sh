@@ -286,4 +286,44 @@ test_expect_success 'basename similarity vs best similarity' '
 	test_cmp expected actual
 '
 
+test_expect_success 'diff.renameLSH finds renames beyond diff.renameLimit' '
+	test_when_finished "rm -rf lsh" &&
+	git init lsh &&
+	(
+		cd lsh &&
+		for i in $(test_seq 1 20)
+		do
+			test_seq $((i * 100)) $((i * 100 + 40)) >old$i || return 1
+		done &&
+		git add . &&
+		git commit -m old &&
+		for i in $(test_seq 1 20)
+		do
+			git mv old$i new$i &&
+			echo changed >>new$i || return 1
+		done &&
+		git commit -a -m new &&
+
+		git -c diff.renameLimit=1 diff-tree -r -M --name-status \
+			HEAD^ HEAD >actual &&
+		! grep ^R actual &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c diff.renameLimit=1 -c diff.renameLSH=true \
+			diff-tree -r -M --name-status HEAD^ HEAD >actual &&
+		for i in $(test_seq 1 20)
+		do
+			printf "old%d\tnew%d\n" $i $i || return 1
+		done | sort >expected &&
+		sed -n "s/^R[0-9]*	//p" actual | sort >renames &&
+		test_cmp expected renames &&
+
+		# far fewer pairs than the 400 an exhaustive search scores
+		sed -n "s/.*\"key\":\"rename lsh\/scored pairs\",\"value\":\"\([0-9]*\)\".*/\1/p" \
+			trace.event >scored &&
+		test_line_count = 1 scored &&
+		test $(cat scored) -le 60
+	)
+'
+
 test_done
@@ -120,8 +120,10 @@ test_expect_success 'git log with --walk-reflogs does not use Bloom filters' '
 	test_bloom_filters_not_used "--walk-reflogs -- A"
 '
 
-test_expect_success 'git log -- multiple path specs does not use Bloom filters' '
-	test_bloom_filters_not_used "-- file4 A/file1"
+test_expect_success 'git log -- multiple path specs uses Bloom filters' '
+	test_bloom_filters_used "-- file4 A/file1" &&
+	test_bloom_filters_used "-- A/B/C A/file1" &&
+	test_bloom_filters_used "-- file4 A/B/C/file3 file5_renamed"
 '
 
 test_expect_success 'git log -- "." pathspec at root does not use Bloom filters' '
@@ -133,9 +135,24 @@ test_expect_success 'git log with wildcard that resolves to a single path uses B
 	test_bloom_filters_used "-- *renamed"
 '
 
-test_expect_success 'git log with wildcard that resolves to a multiple paths does not uses Bloom filters' '
-	test_bloom_filters_not_used "-- *" &&
-	test_bloom_filters_not_used "-- file*"
+test_expect_success 'git log with wildcard that resolves to a multiple paths uses Bloom filters' '
+	test_bloom_filters_used "-- *" &&
+	test_bloom_filters_used "-- file*"
+'
+
+test_expect_success 'git log with wildcard pathspec uses Bloom filters for its leading directories' '
+	test_bloom_filters_used "-- :(glob)A/**/file3" &&
+	test_bloom_filters_used "-- :(glob)A/B/*2 file4"
+'
+
+test_expect_success 'git log with wildcard pathspec at the root does not use Bloom filters' '
+	test_bloom_filters_not_used "-- :(glob)*file3" &&
+	test_bloom_filters_not_used "-- A/file1 :(glob)*file3"
+'
+
+test_expect_success 'git log with unsupported pathspec magic does not use Bloom filters' '
+	test_bloom_filters_not_used "-- :(icase)a/file1" &&
+	test_bloom_filters_not_used "-- A :(exclude)A/B"
 '
 
 test_expect_success 'setup - add commit-graph to the chain without Bloom filters' '
@@ -403,4 +420,35 @@ test_expect_success 'Bloom generation backfills empty commits' '
 	)
 '
 
+test_expect_success 'blame skips commits ruled out by Bloom filters' '
+	git init blame-skip &&
+	test_when_finished "rm -fr blame-skip" &&
+	(
+		cd blame-skip &&
+		test_commit first file &&
+		for i in $(test_seq 1 5)
+		do
+			test_commit other-$i other || return 1
+		done &&
+		test_commit --append second file &&
+		for i in $(test_seq 6 10)
+		do
+			test_commit other-$i other || return 1
+		done &&
+		git commit-graph write --reachable --changed-paths &&
+
+		git -c core.commitGraph=false blame file >expect &&
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" git blame file >actual &&
+		test_cmp expect actual &&
+		grep "bloom/skipped-commits:10" trace.perf &&
+
+		git -c core.commitGraph=false blame other-5..HEAD -- file >expect &&
+		rm -f trace.perf &&
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+			git blame other-5..HEAD -- file >actual &&
+		test_cmp expect actual &&
+		grep "bloom/skipped-commits:0" trace.perf
+	)
+'
+
 test_done
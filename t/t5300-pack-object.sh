@@ -179,6 +179,24 @@ test_expect_success 'unpack without delta' '
 	check_unpack test-1-${packname_1}
 '
 
+test_expect_success 'unpack with core.fsyncMethod=batch' '
+	test_when_finished "rm -rf git2" &&
+	git init --bare git2 &&
+	GIT_TEST_FSYNC=1 git -C git2 -c core.fsync=loose-object \
+		-c core.fsyncMethod=batch \
+		unpack-objects <test-1-${packname_1}.pack &&
+	(cd .git && find objects -type f -print) |
+	while read path
+	do
+		cmp git2/$path .git/$path || {
+			echo $path differs.
+			return 1
+		}
+	done &&
+	find git2/objects -name "tmp_objdir*" -o -name "bulk_fsync_*" >leftover &&
+	test_must_be_empty leftover
+'
+
 test_expect_success 'pack with REF_DELTA' '
 	packname_2=$(git pack-objects --progress test-2 <obj-list 2>stderr) &&
 	check_deltas stderr -gt 0
@@ -332,6 +332,32 @@ test_expect_success 'build graph using --reachable' '
 graph_git_behavior 'append graph, commit 8 vs merge 1' full commits/8 merge/1
 graph_git_behavior 'append graph, commit 8 vs merge 2' full commits/8 merge/2
 
+test_expect_success 'write graph with a reachability index' '
+	cd "$TRASH_DIRECTORY/full" &&
+	git -c commitGraph.reachabilityRef=merge/1 \
+	    -c commitGraph.reachabilityRef=merge/3 \
+	    -c commitGraph.reachabilityRef=merge/1 \
+		commit-graph write --reachable &&
+	graph_read_expect "11" "generation_data extra_edges reachability" &&
+	for tip in merge/1 merge/3 commits/8
+	do
+		for commit in commits/1 commits/3 commits/6 commits/8 \
+			      merge/1 merge/2 merge/3
+		do
+			if git -c core.commitGraph=false \
+				merge-base --is-ancestor $commit $tip
+			then
+				git merge-base --is-ancestor $commit $tip
+			else
+				test_must_fail git merge-base --is-ancestor $commit $tip
+			fi || return 1
+		done
+	done
+'
+
+graph_git_behavior 'reachability index, commit 8 vs merge 1' full commits/8 merge/1
+graph_git_behavior 'reachability index, commit 8 vs merge 2' full commits/8 merge/2
+
 test_expect_success 'setup bare repo' '
 	cd "$TRASH_DIRECTORY" &&
 	git clone --bare --no-local full bare &&
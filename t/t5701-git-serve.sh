@@ -299,6 +299,136 @@ test_expect_success 'sending server-options' '
 	test_cmp expect actual
 '
 
+# Make the refs look as if they were last updated a while ago; ls-refs
+# does not cache responses for refs that may be updated again within
+# the granularity of file timestamps. Every call uses a later time, as
+# an update would.
+age_refs () {
+	test_tick &&
+	find .git -path .git/objects -prune -o -print |
+	xargs test-tool chmtime =$test_tick
+}
+
+# Send the ls-refs request in "in", unpack the response to "actual" and
+# check whether it came from the cache ("hit"), was computed and added
+# to the cache ("miss"), or the cache was not used at all ("none").
+ls_refs_cached () {
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		test-tool serve-v2 --stateless-rpc <in >out &&
+	test-tool pkt-line unpack <out >actual &&
+	if test "$1" = none
+	then
+		! grep "\"key\":\"cache\"" trace
+	else
+		grep "\"key\":\"cache\",\"value\":\"$1\"" trace
+	fi
+}
+
+test_expect_success 'ls-refs serves repeated requests from lsrefs.cache' '
+	test-tool pkt-line pack >in <<-EOF &&
+	command=ls-refs
+	object-format=$(test_oid algo)
+	0001
+	peel
+	symrefs
+	0000
+	EOF
+	cp in in.all &&
+	test-tool serve-v2 --stateless-rpc <in >out &&
+	test-tool pkt-line unpack <out >expect &&
+
+	test_config lsrefs.cache true &&
+	mkdir .git/ls-refs-cache &&
+	age_refs &&
+	ls_refs_cached miss &&
+	test_cmp expect actual &&
+	ls_refs_cached hit &&
+	test_cmp expect actual
+'
+
+test_expect_success REFFILES 'lsrefs.cache is bypassed right after an update' '
+	test_config lsrefs.cache true &&
+	test_when_finished "git update-ref -d refs/heads/cached" &&
+	git update-ref refs/heads/cached HEAD &&
+	ls_refs_cached none &&
+	grep "refs/heads/cached$" actual
+'
+
+test_expect_success 'lsrefs.cache notices updated refs' '
+	test_config lsrefs.cache true &&
+	git update-ref refs/heads/cached HEAD &&
+	age_refs &&
+	ls_refs_cached miss &&
+	grep "refs/heads/cached$" actual &&
+	ls_refs_cached hit &&
+	grep "refs/heads/cached$" actual &&
+	git update-ref -d refs/heads/cached &&
+	age_refs &&
+	ls_refs_cached miss &&
+	test_cmp expect actual
+'
+
+test_expect_success 'lsrefs.cache does not trace refs twice' '
+	test_config lsrefs.cache true &&
+	cp in.all in &&
+	git update-ref refs/heads/traced HEAD &&
+	test_when_finished "git update-ref -d refs/heads/traced" &&
+	age_refs &&
+	rm -f trace.packet &&
+	GIT_TRACE_PACKET="$(pwd)/trace.packet" GIT_TRACE2_EVENT="$(pwd)/trace" \
+		test-tool serve-v2 --stateless-rpc <in >out &&
+	grep "\"key\":\"cache\",\"value\":\"miss\"" trace &&
+	test-tool pkt-line unpack <out >actual &&
+	grep "refs/heads/traced$" actual &&
+	grep "refs/heads/traced" trace.packet >traced &&
+	test_line_count = 1 traced
+'
+
+test_expect_success 'lsrefs.cache depends on arguments and hidden refs' '
+	test_config lsrefs.cache true &&
+	test-tool pkt-line pack >in <<-EOF &&
+	command=ls-refs
+	object-format=$(test_oid algo)
+	0001
+	ref-prefix refs/tags/
+	0000
+	EOF
+	cat >expect <<-EOF &&
+	$(git rev-parse refs/tags/annotated-tag) refs/tags/annotated-tag
+	$(git rev-parse refs/tags/one) refs/tags/one
+	$(git rev-parse refs/tags/two) refs/tags/two
+	0000
+	EOF
+	age_refs &&
+	ls_refs_cached miss &&
+	test_cmp expect actual &&
+
+	test_config uploadpack.hideRefs refs/tags/one &&
+	grep -v refs/tags/one expect >expect.hidden &&
+	age_refs &&
+	ls_refs_cached miss &&
+	test_cmp expect.hidden actual &&
+	ls_refs_cached hit &&
+	test_cmp expect.hidden actual
+'
+
+test_expect_success 'lsrefs.cache drops stale responses' '
+	test_config lsrefs.cache true &&
+	git update-ref refs/heads/cached HEAD &&
+	age_refs &&
+	ls_refs_cached miss &&
+	cp in.all in &&
+	ls_refs_cached miss &&
+	ls .git/ls-refs-cache >entries &&
+	test_line_count = 2 entries &&
+	git update-ref -d refs/heads/cached &&
+	age_refs &&
+	ls_refs_cached miss &&
+	ls .git/ls-refs-cache >entries &&
+	test_line_count = 1 entries
+'
+
 test_expect_success 'unexpected lines are not allowed in fetch request' '
 	git init server &&
 
@@ -305,4 +305,41 @@ test_expect_success 'merge-base --octopus --all for complex tree' '
 	test_cmp expected actual
 '
 
+test_expect_success 'merge-base --octopus --all shows criss-cross bases once' '
+	# KP and KQ have the merge bases KX and KY, which both lead
+	# to K, the only common ancestor with KC.
+	#
+	#   KP   KQ
+	#   | \ / |
+	#   |  X  |
+	#   | / \ |
+	#   KX   KY
+	#   | \ / |
+	#   |  X  |    KC
+	#   | / \ |   /
+	#   KA   KB  /
+	#     \ |  /
+	#       K
+	git reset --hard J &&
+	test_commit K &&
+	test_commit KA &&
+	git reset --hard K &&
+	test_commit KB &&
+	git reset --hard KA &&
+	test_merge KX KB &&
+	git reset --hard KB &&
+	test_merge KY KA &&
+	git reset --hard KX &&
+	test_merge KP KY &&
+	git reset --hard KY &&
+	test_merge KQ KX &&
+	git reset --hard K &&
+	test_commit KC &&
+	git rev-parse K >expected &&
+	git merge-base --all --octopus KP KQ KC >actual &&
+	test_cmp expected actual &&
+	git show-branch --merge-base KP KQ KC >actual &&
+	test_cmp expected actual
+'
+
 test_done
@@ -283,4 +283,32 @@ test_expect_success 'log --graph --simplify-merges --show-pulls' '
 	test_cmp expect actual
 '
 
+test_expect_success 'path-limited topo-order with parents streams with generation numbers' '
+	git init streaming &&
+	(
+		cd streaming &&
+		for i in 1 2 3 4 5 6 7 8 9 10
+		do
+			echo $i >file &&
+			echo $i >other &&
+			git add file &&
+			test_tick &&
+			git commit -m "file $i" &&
+			git add other &&
+			test_tick &&
+			git commit -m "other $i" || return 1
+		done &&
+		git commit-graph write --reachable &&
+
+		git log --format=%s --parents --topo-order -- file >full &&
+		test_line_count = 10 full &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git log --format=%s --parents --topo-order -2 -- file >actual &&
+		head -n 2 full >expect &&
+		test_cmp expect actual &&
+		grep "\"count_topo_walked\":[1-5][,}]" trace.event
+	)
+'
+
 test_done
@@ -488,6 +488,28 @@ test_expect_success 'name-rev covers all conditions while looking at parents' '
 	)
 '
 
+test_expect_success 'name-rev uses generation numbers across clock skew' '
+	git init skew &&
+	(
+		cd skew &&
+		test_commit --no-tag base &&
+		test_commit --no-tag target &&
+		# A descendant whose committer date is more than a day
+		# older than the commit we ask about.
+		test_commit --no-tag --date "@1234 +0000" skewed &&
+		test_commit tip &&
+
+		git commit-graph write --reachable &&
+		echo "$(git rev-parse HEAD~2) tags/tip~2" >expect &&
+		git name-rev --tags $(git rev-parse HEAD~2) >actual &&
+		test_cmp expect actual &&
+
+		echo "tip~3" >expect &&
+		git describe --contains HEAD~3 >actual &&
+		test_cmp expect actual
+	)
+'
+
 #               B
 #               o
 #                \
@@ -1396,6 +1396,17 @@ test_expect_success 'for-each-ref --ignore-case works on multiple sort keys' '
 	test_cmp expect actual
 '
 
+test_expect_success 'objects read by several threads give the same values' '
+	format="%(refname) %(objectname) %(subject) %(authordate) %(*subject) %(contents:size)" &&
+	git for-each-ref --format="$format" >expect &&
+	GIT_TEST_REF_FILTER_THREADS=1 git for-each-ref --format="$format" >actual &&
+	test_cmp expect actual &&
+	git for-each-ref --sort=-creatordate --format="$format" >expect &&
+	GIT_TEST_REF_FILTER_THREADS=1 \
+		git for-each-ref --sort=-creatordate --format="$format" >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'for-each-ref reports broken tags' '
 	git tag -m "good tag" broken-tag-good HEAD &&
 	git cat-file tag broken-tag-good >good &&
@@ -1406,4 +1417,36 @@ test_expect_success 'for-each-ref reports broken tags' '
 		refs/tags/broken-tag-*
 '
 
+test_expect_success 'ahead-behind counts against several bases' '
+	test_when_finished "rm -rf ahead-behind" &&
+	git init --initial-branch=main ahead-behind &&
+	(
+		cd ahead-behind &&
+		test_commit base &&
+		git branch side &&
+		test_commit main-1 &&
+		test_commit main-2 &&
+		git checkout -b topic side &&
+		test_commit topic-1 &&
+		git merge -m merge main-1 &&
+		git checkout main &&
+		git tag -m annotated annotated topic &&
+		git tag blob-tag $(git rev-parse HEAD:base.t) &&
+		cat >expect <<-\EOF &&
+		refs/heads/main 0 0 1 2
+		refs/heads/side 0 2 0 3
+		refs/heads/topic 2 1 0 0
+		refs/tags/annotated 2 1 0 0
+		refs/tags/blob-tag
+		EOF
+		git for-each-ref \
+			--format="%(refname) %(ahead-behind:main) %(ahead-behind:topic)" \
+			refs/heads refs/tags/annotated refs/tags/blob-tag >actual &&
+		sed "s/ *$//" actual >actual.trimmed &&
+		test_cmp expect actual.trimmed &&
+		test_must_fail git for-each-ref --format="%(ahead-behind:missing)" 2>err &&
+		test_i18ngrep "failed to find" err
+	)
+'
+
 test_done
@@ -474,4 +474,38 @@ test_expect_success 'validate worktree atom' '
 	test_cmp expect actual
 '
 
+test_expect_success '--count keeps the first refs in sort order' '
+	test_seq 5000 |
+	awk "{ print \"create refs/many/\" \$1 \" main~\" \$1 % 3 }" |
+	git update-ref --stdin &&
+	for sort in refname -refname objectname -committerdate \
+		version:refname refname:short
+	do
+		git for-each-ref --sort=$sort >full &&
+		head -n 10 full >expect &&
+		git for-each-ref --sort=$sort --count=10 >actual &&
+		test_cmp expect actual &&
+		head -n 4500 full >expect &&
+		git for-each-ref --sort=$sort --count=4500 >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success '--count with patterns, filters and several sort keys' '
+	git for-each-ref --sort=-objecttype --sort=committerdate \
+		refs/many/1 refs/many/2 refs/tags/ >full &&
+	head -n 3 full >expect &&
+	git for-each-ref --sort=-objecttype --sort=committerdate --count=3 \
+		refs/many/1 refs/many/2 refs/tags/ >actual &&
+	test_cmp expect actual &&
+	git for-each-ref --merged=main~1 "refs/many/*" >full &&
+	head -n 5 full >expect &&
+	git for-each-ref --merged=main~1 --count=5 "refs/many/*" >actual &&
+	test_cmp expect actual &&
+	git for-each-ref --points-at=main~2 refs/many >full &&
+	head -n 5 full >expect &&
+	git for-each-ref --points-at=main~2 --count=5 refs/many >actual &&
+	test_cmp expect actual
+'
+
 test_done
@@ -58,6 +58,20 @@ test_expect_success 'setup' '
 	git -c commitGraph.generationVersion=1 commit-graph write --reachable &&
 	mv .git/objects/info/commit-graph commit-graph-no-gdat &&
 	chmod u+w commit-graph-no-gdat &&
+	for i in $(test_seq 1 10)
+	do
+		for j in $(test_seq 1 10)
+		do
+			echo "-c commitGraph.reachabilityRef=commit-$i-$j" || return 1
+		done
+	done >reach-config &&
+	git $(cat reach-config) commit-graph write --reachable &&
+	mv .git/objects/info/commit-graph commit-graph-reach &&
+	chmod u+w commit-graph-reach &&
+	git repack -adb &&
+	bitmap=$(ls .git/objects/pack/pack-*.bitmap) &&
+	echo "$bitmap" >bitmap-name &&
+	mv "$bitmap" bitmap-full &&
 	git config core.commitGraph true
 '
 
@@ -73,6 +87,14 @@ run_all_modes () {
 	test_cmp expect actual &&
 	cp commit-graph-no-gdat .git/objects/info/commit-graph &&
 	"$@" <input >actual &&
+	test_cmp expect actual &&
+	cp commit-graph-reach .git/objects/info/commit-graph &&
+	"$@" <input >actual &&
+	test_cmp expect actual &&
+	rm -f .git/objects/info/commit-graph &&
+	test_when_finished "rm -f $(cat bitmap-name)" &&
+	cp bitmap-full $(cat bitmap-name) &&
+	"$@" <input >actual &&
 	test_cmp expect actual
 }
 
@@ -183,6 +205,32 @@ test_expect_success 'get_merge_bases_many' '
 	test_all_modes get_merge_bases_many
 '
 
+test_expect_success 'get_octopus_merge_bases' '
+	cat >input <<-\EOF &&
+	X:commit-5-7
+	X:commit-4-8
+	X:commit-6-6
+	X:commit-8-3
+	X:commit-9-9
+	EOF
+	{
+		echo "get_octopus_merge_bases(X):" &&
+		git rev-parse commit-4-3
+	} >expect &&
+	test_all_modes get_octopus_merge_bases
+'
+
+test_expect_success 'get_octopus_merge_bases with a single head' '
+	cat >input <<-\EOF &&
+	X:commit-5-7
+	EOF
+	{
+		echo "get_octopus_merge_bases(X):" &&
+		git rev-parse commit-5-7
+	} >expect &&
+	test_all_modes get_octopus_merge_bases
+'
+
 test_expect_success 'reduce_heads' '
 	cat >input <<-\EOF &&
 	X:commit-1-10
@@ -307,6 +355,43 @@ test_expect_success 'commit_contains:miss' '
 	test_all_modes commit_contains --tag
 '
 
+test_expect_success 'commit_contains: bitmapped tips' '
+	test_when_finished "rm -f $(cat bitmap-name)" &&
+	cp bitmap-full $(cat bitmap-name) &&
+	for x in $(test_seq 5 10)
+	do
+		for y in $(test_seq 4 10)
+		do
+			echo "commit-$x-$y" || return 1
+		done
+	done | sort >expect &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git branch --format="%(refname:short)" \
+		--contains commit-5-4 "commit-*" >actual &&
+	test_region commit-reach load-bitmaps trace.txt &&
+	test_cmp expect actual &&
+	sed s/commit/tag/ expect >expect.tag &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git tag --contains commit-5-4 "tag-*" >actual &&
+	test_region commit-reach load-bitmaps trace.txt &&
+	test_cmp expect.tag actual
+'
+
+test_expect_success 'single queries do not load bitmaps' '
+	test_when_finished "rm -f $(cat bitmap-name)" &&
+	cp bitmap-full $(cat bitmap-name) &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git merge-base --is-ancestor commit-2-3 commit-5-7 &&
+	test_region ! commit-reach load-bitmaps trace.txt &&
+	rm -f trace.txt &&
+	test_must_fail env GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git merge-base --is-ancestor commit-6-8 commit-5-9 &&
+	test_region ! commit-reach load-bitmaps trace.txt
+'
+
 test_expect_success 'rev-list: basic topo-order' '
 	git rev-parse \
 		commit-6-6 commit-5-6 commit-4-6 commit-3-6 commit-2-6 commit-1-6 \
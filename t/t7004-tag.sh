@@ -2127,4 +2127,17 @@ test_expect_success 'Does --[no-]contains stop at commits? Yes!' '
 	test_cmp expected actual
 '
 
+test_expect_success '--format with ahead-behind' '
+	cat >expected <<-\EOF &&
+	v0.1 0 2
+	v0.2 0 1
+	v0.3 0 0
+	v0.4 1 0
+	v0.5 2 0
+	EOF
+	git tag --format="%(refname:short) %(ahead-behind:v0.3)" \
+		--list "v0.*" >actual &&
+	test_cmp expected actual
+'
+
 test_done
@@ -0,0 +1,204 @@
+#!/bin/sh
+
+test_description='git blame with blame.cache'
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+. ./test-lib.sh
+
+# Creates:
+#
+#	A--B--C--M--D--E
+#	    \   /
+#	     S-'
+#
+# where every commit but M touches "file", and S adds a line in the
+# middle that M brings in.
+test_expect_success setup '
+	test_write_lines 1 2 3 4 5 6 7 8 >file &&
+	git add file &&
+	test_tick &&
+	git commit -m A &&
+	git tag A &&
+
+	test_write_lines 1 2 3 four 5 6 7 8 >file &&
+	test_tick &&
+	git commit -a -m B &&
+	git tag B &&
+
+	git checkout -b side &&
+	test_write_lines 1 2 3 four 5 6 side 7 8 >file &&
+	test_tick &&
+	git commit -a -m S &&
+	git tag S &&
+
+	git checkout main &&
+	test_write_lines one 2 3 four 5 6 7 8 >file &&
+	test_tick &&
+	git commit -a -m C &&
+	git tag C &&
+	test_tick &&
+	git merge -m M side &&
+	git tag M &&
+
+	test_write_lines one 2 3 four 5 6 side 7 eight >file &&
+	test_tick &&
+	git commit -a -m D &&
+	git tag D &&
+
+	test_write_lines one two 3 four 5 6 side 7 eight 9 >file &&
+	test_tick &&
+	git commit -a -m E &&
+	git tag E
+'
+
+cache_depth () {
+	grep "cache/depth:" "$1" | sed -e "s/.*cache\/depth:\([-0-9]*\).*/\1/"
+}
+
+test_expect_success 'blame without a cache entry fills the cache' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git blame --porcelain M -- file >expect &&
+	rm -f trace.perf &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git -c blame.cache=true blame --porcelain M -- file >actual &&
+	test_cmp expect actual &&
+	echo -1 >expect &&
+	cache_depth trace.perf >actual &&
+	test_cmp expect actual &&
+	find .git/blame-cache -type f >files &&
+	test_line_count = 1 files
+'
+
+test_expect_success 'blame at a descendant starts from the cached result' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	for format in "" --porcelain --line-porcelain -c "-L 2,8"
+	do
+		rm -rf .git/blame-cache &&
+		git -c blame.cache=true blame M -- file >/dev/null &&
+		git blame $format E -- file >expect &&
+		rm -f trace.perf &&
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+			git -c blame.cache=true blame $format E -- file >actual &&
+		test_cmp expect actual &&
+		echo 2 >expect &&
+		cache_depth trace.perf >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'blame of a cached commit uses the cache directly' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame E -- file >/dev/null &&
+	git blame --line-porcelain E -- file >expect &&
+	rm -f trace.perf &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git -c blame.cache=true blame --line-porcelain E -- file >actual &&
+	test_cmp expect actual &&
+	echo 0 >expect &&
+	cache_depth trace.perf >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'blame -L does not fill the cache' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame -L 1,3 E -- file >/dev/null &&
+	test_path_is_missing .git/blame-cache
+'
+
+test_expect_success 'options that change the attribution are kept apart' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame --root M -- file >/dev/null &&
+	git blame E -- file >expect &&
+	rm -f trace.perf &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git -c blame.cache=true blame E -- file >actual &&
+	test_cmp expect actual &&
+	echo -1 >expect &&
+	cache_depth trace.perf >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'blame with unsupported options does not use the cache' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame M -- file >/dev/null &&
+	for opts in -M -C "--reverse A" "B..E" "--since=1.year.ago E"
+	do
+		rm -f trace.perf &&
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+			git -c blame.cache=true blame $opts -- file >/dev/null &&
+		! grep "cache/depth" trace.perf || return 1
+	done
+'
+
+test_expect_success 'a broken cache entry is ignored' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame M -- file >/dev/null &&
+	cache=$(find .git/blame-cache -type f) &&
+	sed -e "2s/^0 /1 /" "$cache" >broken &&
+	mv broken "$cache" &&
+	git blame E -- file >expect &&
+	rm -f trace.perf &&
+	GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+		git -c blame.cache=true blame E -- file >actual &&
+	test_cmp expect actual &&
+	echo -1 >expect &&
+	cache_depth trace.perf >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'shallow repositories do not use the cache' '
+	test_when_finished "rm -rf shallow" &&
+	git clone --depth 2 "file://$(pwd)" shallow &&
+	git -C shallow -c blame.cache=true blame HEAD -- file >shallow.out &&
+	test_path_is_missing shallow/.git/blame-cache &&
+	git -C shallow fetch --unshallow &&
+	git -C shallow blame HEAD -- file >expect &&
+	git -C shallow -c blame.cache=true blame HEAD -- file >actual &&
+	test_cmp expect actual &&
+	! test_cmp shallow.out actual
+'
+
+test_expect_success 'replaced commits do not use the cache' '
+	test_when_finished "rm -rf .git/blame-cache && git replace -d C" &&
+	git replace --graft C A &&
+	git -c blame.cache=true blame E -- file >/dev/null &&
+	test_path_is_missing .git/blame-cache
+'
+
+test_expect_success 'writing a result evicts the least recently used ones' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame E -- file >/dev/null &&
+	cache=$(find .git/blame-cache -type f) &&
+	dir=${cache%/*} &&
+	rm "$cache" &&
+	for i in 1 2 3
+	do
+		echo old >"$dir/old-$i" &&
+		test-tool chmtime =-$((100 * $i)) "$dir/old-$i" || return 1
+	done &&
+	git -c blame.cache=true -c blame.cacheLimit=512 \
+		blame E -- file >/dev/null &&
+	test_path_is_file "$cache" &&
+	test_path_is_file "$dir/old-1" &&
+	test_path_is_missing "$dir/old-2" &&
+	test_path_is_missing "$dir/old-3"
+'
+
+test_expect_success 'gc removes results that have not been used' '
+	test_when_finished "rm -rf .git/blame-cache" &&
+	git -c blame.cache=true blame M -- file >/dev/null &&
+	git -c blame.cache=true blame E -- file >/dev/null &&
+	find .git/blame-cache -type f >files &&
+	test_line_count = 2 files &&
+	test-tool chmtime =-5000000 $(cat files) &&
+	git -c blame.cache=true blame E -- file >/dev/null &&
+	git gc &&
+	find .git/blame-cache -type f >files &&
+	test_line_count = 1 files &&
+	test-tool chmtime =-10 $(cat files) &&
+	git -c gc.blameCacheExpire=now gc &&
+	test_path_is_missing .git/blame-cache
+'
+
+test_done
@@ -1784,6 +1784,21 @@ int unpack_trees(unsigned len, struct tree_desc *t, struct unpack_trees_options
 		dfc = xcalloc(1, cache_entry_size(0));
 	o->df_conflict_entry = dfc;
 
+	/*
+	 * verify_uptodate() lstat()s every index entry the merge touches,
+	 * one at a time and in traversal order.  The traversal itself has
+	 * to stay serial (it builds o->result in order), but the stat
+	 * checks do not: let the threaded preload mark the clean entries
+	 * CE_UPTODATE up front so that verify_uptodate() can skip them.
+	 * Entries that are already up-to-date are skipped by the preload,
+	 * so callers that have refreshed the index pay next to nothing.
+	 */
+	if (o->update && o->merge && !o->reset && !o->index_only) {
+		trace2_region_enter("unpack_trees", "preload", the_repository);
+		preload_index(o->src_index, o->pathspec, 0);
+		trace2_region_leave("unpack_trees", "preload", the_repository);
+	}
+
 	if (len) {
 		const char *prefix = o->prefix ? o->prefix : "";
 		struct traverse_info info;